@@ -0,0 +1,136 @@
+//
+//  bench-change-notify.cpp
+//  YAD
+//
+//  变化通知基准：模拟多个人脸的检测结果，关键点每帧有亚像素抖动，每隔一段时间整体移动一次，
+//  统计ChangeNotifier每帧的比较耗时、触发回调的帧比例，并与逐点标量比较的参考实现核对通知次数。
+//  用法: bench-change-notify [-f faces] [-n frames] [-j jitter_px] [-m move_interval]
+//  编译: g++ -O2 -std=c++14 -I../YADetector/Classes -I../YADetector/Classes/3rd/Log bench-change-notify.cpp
+//            ../YADetector/Classes/ChangeNotifier.cpp ../YADetector/Classes/LandmarkProfile.cpp
+//            ../YADetector/Classes/3rd/Log/Logger.cpp
+//
+
+#include "ChangeNotifier.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+// 与ChangeNotifier相同语义的标量实现，只比较106点和姿态，用于核对结果
+static int countReference(const std::vector<YADFaceInfo> &frames, int numFaces, int numFrames, float landmarkPx,
+                          float poseDeg)
+{
+    std::vector<YADFaceInfo> base(numFaces);
+    int notified = 0;
+    for (int n = 0; n < numFrames; n++) {
+        bool changed = false;
+        for (int i = 0; i < numFaces; i++) {
+            const YADFaceInfo &face = frames[(size_t)n * numFaces + i];
+            YADFaceInfo &last = base[i];
+            bool moved = n == 0;
+            moved = moved || fabsf(face.yaw - last.yaw) > poseDeg || fabsf(face.pitch - last.pitch) > poseDeg ||
+                    fabsf(face.roll - last.roll) > poseDeg;
+            for (int k = 0; !moved && k < YAD_FACE_LANDMARK_NUM; k++) {
+                float dx = face.landmarks[k].x - last.landmarks[k].x;
+                float dy = face.landmarks[k].y - last.landmarks[k].y;
+                moved = dx * dx + dy * dy > landmarkPx * landmarkPx;
+            }
+            float corners[2][2] = {
+                {face.rect.x - last.rect.x, face.rect.y - last.rect.y},
+                {face.rect.x + face.rect.w - last.rect.x - last.rect.w,
+                 face.rect.y + face.rect.h - last.rect.y - last.rect.h},
+            };
+            for (int k = 0; !moved && k < 2; k++) {
+                moved = corners[k][0] * corners[k][0] + corners[k][1] * corners[k][1] > landmarkPx * landmarkPx;
+            }
+            if (moved) {
+                last = face;
+                changed = true;
+            }
+        }
+        notified += changed ? 1 : 0;
+    }
+    return notified;
+}
+
+int main(int argc, char *argv[])
+{
+    int numFaces = 4;
+    int numFrames = 10000;
+    float jitter = 0.3f;
+    int moveInterval = 50;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:n:j:m:")) != -1) {
+        switch (opt) {
+            case 'f':
+                numFaces = std::max(1, atoi(optarg));
+                break;
+            case 'n':
+                numFrames = std::max(1, atoi(optarg));
+                break;
+            case 'j':
+                jitter = std::max(0.0f, (float)atof(optarg));
+                break;
+            case 'm':
+                moveInterval = std::max(1, atoi(optarg));
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-f faces] [-n frames] [-j jitter_px] [-m move_interval]\n", argv[0]);
+                return 1;
+        }
+    }
+    
+    // 预先生成所有帧，计时只包括比较
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> noise(-jitter, jitter);
+    std::vector<YADFaceInfo> faces(numFaces);
+    for (int i = 0; i < numFaces; i++) {
+        YADFaceInfo &face = faces[i];
+        face.track_id = i;
+        face.rect = {100.0f + i * 150.0f, 100.0f, 120.0f, 140.0f};
+        for (int k = 0; k < YAD_FACE_LANDMARK_NUM; k++) {
+            face.landmarks[k].x = face.rect.x + (k % 11) * 11.0f;
+            face.landmarks[k].y = face.rect.y + (k / 11) * 13.0f;
+            face.visibilites[k] = 1.0f;
+        }
+        face.yaw = face.pitch = face.roll = 0.0f;
+    }
+    std::vector<YADFaceInfo> frames((size_t)numFrames * numFaces);
+    for (int n = 0; n < numFrames; n++) {
+        float shift = (float)(n / moveInterval) * 5.0f;
+        for (int i = 0; i < numFaces; i++) {
+            YADFaceInfo face = faces[i];
+            face.rect.x += shift + noise(rng);
+            face.rect.y += noise(rng);
+            for (int k = 0; k < YAD_FACE_LANDMARK_NUM; k++) {
+                face.landmarks[k].x += shift + noise(rng);
+                face.landmarks[k].y += noise(rng);
+            }
+            face.yaw = noise(rng);
+            frames[(size_t)n * numFaces + i] = face;
+        }
+    }
+    
+    int callbacks = 0;
+    yad::ChangeNotifier notifier([&](const yad::FaceChange *changes, int numChanges, const YADFaceResults *results) {
+        callbacks++;
+    });
+    auto begin = std::chrono::steady_clock::now();
+    for (int n = 0; n < numFrames; n++) {
+        YADFaceResults results = {numFaces, numFaces, &frames[(size_t)n * numFaces]};
+        notifier.update(&results);
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+    
+    int reference = countReference(frames, numFaces, numFrames, YAD_CHANGE_DEFAULT_LANDMARK_PX,
+                                   YAD_CHANGE_DEFAULT_POSE_DEG);
+    printf("faces: %d frames: %d jitter: %.2fpx move every %d frames\n", numFaces, numFrames, jitter, moveInterval);
+    printf("update: %.3fus/frame notified: %d (%.1f%%) reference: %d %s\n", us / numFrames, callbacks,
+           100.0 * callbacks / numFrames, reference, callbacks == reference ? "match" : "MISMATCH");
+    return callbacks == reference ? 0 : 1;
+}
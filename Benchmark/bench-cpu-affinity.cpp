@@ -0,0 +1,215 @@
+//
+//  bench-cpu-affinity.cpp
+//  YAD
+//
+//  CPU绑定基准：后台有干扰负载时，对同一幅多人脸图像反复调用Detector::detect，比较不绑定和绑定到指定CPU(默认性能核)时的单帧耗时分位数。
+//  绑定时检测线程、WorkerPool和推理后端线程都绑定到这些CPU，kYADWorkerThreads为-t。干扰线程不绑定，按忙/闲交替模拟其它进程。
+//  用法: bench-cpu-affinity [-p plugin] [-m model_dir] [-c cpus] [-t threads] [-n noise_threads] [-f frames] image.ppm
+//        image.ppm为二进制PPM(P6)，按RGB888送入插件；model_dir下为NCNN插件的yadface/yadlandmark模型，默认使用插件自带的模型
+//  编译: g++ -O2 -std=c++14 -pthread -fopenmp -rdynamic -DWITH_YAD_NCNN -I<ncnn>/include/ncnn
+//            -I../YADetector/Classes -I../YADetector/Classes/3rd/Log -I../YADetector/Classes/Plugin
+//            -I../YADetector/Classes/Service bench-cpu-affinity.cpp $(find ../YADetector/Classes -name '*.cpp')
+//            -L<ncnn>/lib -lncnn -ldl
+//
+
+#include "YADetector.h"
+#include "CpuAffinity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define BENCH_WARMUP_FRAMES 3
+#define BENCH_FRAME_GAP_US  2000    // 帧间隔，给调度器迁移线程的机会
+#define BENCH_NOISE_BUSY_US 3000
+#define BENCH_NOISE_IDLE_US 1000
+
+static std::atomic<bool> s_stopped(false);
+
+static bool readPPM(const std::string &path, int *width, int *height, std::vector<uint8_t> &pixels)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    
+    int maxValue = 0;
+    bool ok = fscanf(file, "P6 %d %d %d", width, height, &maxValue) == 3 && maxValue == 255 &&
+        *width > 0 && *height > 0 && fgetc(file) != EOF;
+    if (ok) {
+        pixels.resize((size_t)*width * *height * 3);
+        ok = fread(pixels.data(), 1, pixels.size(), file) == pixels.size();
+    }
+    fclose(file);
+    return ok;
+}
+
+static void noiseLoop()
+{
+    volatile uint64_t counter = 0;
+    while (!s_stopped) {
+        auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(BENCH_NOISE_BUSY_US);
+        while (std::chrono::steady_clock::now() < end) {
+            counter++;
+        }
+        usleep(BENCH_NOISE_IDLE_US);
+    }
+}
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    size_t index = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+    return sorted[index];
+}
+
+// 在新线程中创建Detector并检测，避免上一轮的绑定影响下一轮。绑定时检测线程自己绑定，
+// 工作线程和推理后端线程由配置kYADCpuAffinity绑定
+static bool runFrames(YADConfig config, const std::vector<int> &cpus, YADDetectImage image, int frames,
+                      std::vector<double> *latencies, int *faces)
+{
+    bool ok = true;
+    std::thread runner([&] {
+        yad::setThreadAffinity(cpus);
+        if (!cpus.empty()) {
+            config[kYADCpuAffinity] = yad::formatCpuList(cpus);
+        }
+        std::unique_ptr<yad::Detector> detector(yad::Detector::Create(config));
+        if (!detector || detector->initCheck() != YAD_OK) {
+            fprintf(stderr, "create detector failed\n");
+            ok = false;
+            return;
+        }
+        
+        std::unique_ptr<YADFeatureInfo> featureInfo(new YADFeatureInfo);
+        for (int n = 0; n < BENCH_WARMUP_FRAMES + frames; n++) {
+            YADDetectInfo detectInfo;
+            memset(&detectInfo, 0, sizeof(detectInfo));
+            memset(featureInfo.get(), 0, sizeof(YADFeatureInfo));
+            auto begin = std::chrono::steady_clock::now();
+            int err = detector->detect(&image, &detectInfo, featureInfo.get());
+            auto end = std::chrono::steady_clock::now();
+            if (err != YAD_OK) {
+                fprintf(stderr, "detect failed, err: %d\n", err);
+                ok = false;
+                return;
+            }
+            if (n >= BENCH_WARMUP_FRAMES) {
+                latencies->push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+            }
+            *faces = featureInfo->num_faces;
+            usleep(BENCH_FRAME_GAP_US);
+        }
+    });
+    runner.join();
+    std::sort(latencies->begin(), latencies->end());
+    return ok && !latencies->empty();
+}
+
+int main(int argc, char *argv[])
+{
+    std::string affinity = YAD_CPU_AFFINITY_BIG;
+    std::string plugin;
+    std::string modelDir;
+    int threads = 2;
+    int noiseThreads = -1;
+    int frames = 300;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:m:c:t:n:f:")) != -1) {
+        switch (opt) {
+            case 'p':
+                plugin = optarg;
+                break;
+            case 'm':
+                modelDir = optarg;
+                break;
+            case 'c':
+                affinity = optarg;
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'n':
+                noiseThreads = atoi(optarg);
+                break;
+            case 'f':
+                frames = std::max(1, atoi(optarg));
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-p plugin] [-m model_dir] [-c cpus] [-t threads] [-n noise_threads] [-f frames] image.ppm\n",
+                argv[0]);
+        return 1;
+    }
+    
+    int width, height;
+    std::vector<uint8_t> pixels;
+    if (!readPPM(argv[optind], &width, &height, pixels)) {
+        fprintf(stderr, "read %s failed\n", argv[optind]);
+        return 1;
+    }
+    YADDetectImage image = {YAD_PIX_FMT_RGB888, YAD_DATA_TYPE_RAW, pixels.data(), width, height, width * 3};
+    
+    YADConfig config;
+    config[kYADCpuAffinity] = affinity;
+    std::vector<int> cpus;
+    if (yad::getConfigCpus(config, kYADCpuAffinity, &cpus) != YAD_OK || cpus.empty()) {
+        fprintf(stderr, "invalid cpus: %s\n", affinity.c_str());
+        return 1;
+    }
+    config.erase(kYADCpuAffinity);
+    config[kYADMaxFaceCount] = std::to_string(YAD_MAX_FACE_NUM);
+    config[kYADPixFormat] = std::to_string(YAD_PIX_FMT_RGB888);
+    config[kYADDataType] = std::to_string(YAD_DATA_TYPE_RAW);
+    config[kYADWorkerThreads] = std::to_string(threads);
+    if (!plugin.empty()) {
+        config[kYADPluginName] = plugin;
+    }
+    if (!modelDir.empty()) {
+        for (const char *name : {"yadface.param", "yadface.bin", "yadlandmark.param", "yadlandmark.bin"}) {
+            config[name] = modelDir + "/" + name;
+        }
+    }
+    if (noiseThreads < 0) {
+        noiseThreads = std::max(1, (int)yad::getOnlineCpus().size() / 2);
+    }
+    printf("image: %dx%d online: %s performance: %s pinned: %s threads: %d noise: %d\n", width, height,
+           yad::formatCpuList(yad::getOnlineCpus()).c_str(), yad::formatCpuList(yad::getPerformanceCpus()).c_str(),
+           yad::formatCpuList(cpus).c_str(), threads, noiseThreads);
+    
+    std::vector<std::thread> noise;
+    for (int i = 0; i < noiseThreads; i++) {
+        noise.emplace_back(noiseLoop);
+    }
+    
+    printf("mode\tfaces\tp50\tp99\tmax\n");
+    static const char *const modes[] = {"unpinned", "pinned"};
+    int result = 0;
+    for (int pinned = 0; pinned < 2; pinned++) {
+        std::vector<double> latencies;
+        int faces = 0;
+        if (!runFrames(config, pinned ? cpus : std::vector<int>(), image, frames, &latencies, &faces)) {
+            result = 1;
+            break;
+        }
+        printf("%s\t%d\t%.3fms\t%.3fms\t%.3fms\n", modes[pinned], faces,
+               percentile(latencies, 0.5), percentile(latencies, 0.99), latencies.back());
+    }
+    
+    s_stopped = true;
+    for (auto &thread : noise) {
+        thread.join();
+    }
+    return result;
+}
@@ -0,0 +1,195 @@
+//
+//  bench-create-concurrency.cpp
+//  YAD
+//
+//  并发创建基准：多个线程同时调用Detector::Create，每次创建模拟加载模型的耗时，
+//  比较全局串行(原来PluginManager持有全局锁时的行为)和并发创建的总耗时、单次创建耗时分位数，
+//  以及创建期间Detector::Exists(getPluginCount)的最大耗时。插件通过静态注册表登记，不需要插件动态库。
+//  用法: bench-create-concurrency [-t threads] [-n creates_per_thread] [-d load_ms]
+//  编译: g++ -O2 -std=c++14 -pthread -rdynamic -I../YADetector/Classes -I../YADetector/Classes/3rd/Log
+//            -I../YADetector/Classes/Plugin -I../YADetector/Classes/Service bench-create-concurrency.cpp
+//            $(find ../YADetector/Classes -name '*.cpp') -ldl
+//
+
+#include "YADetector.h"
+#include "PluginRegistry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static int s_load_ms = 50;
+
+class BenchDetector : public yad::Detector {
+public:
+    BenchDetector(YADConfig &config)
+    {
+        // 模拟每个实例加载模型和分配推理内存
+        std::this_thread::sleep_for(std::chrono::milliseconds(s_load_ms));
+    }
+    
+    int initCheck() const override
+    {
+        return YAD_OK;
+    }
+    
+    int detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo) override
+    {
+        featureInfo->num_faces = 0;
+        return YAD_OK;
+    }
+};
+
+static const char *getName()
+{
+    return "Bench";
+}
+
+static void setLog(yad::Log log)
+{
+}
+
+static int load(YADConfig &config)
+{
+    return YAD_OK;
+}
+
+static bool sniff(YADConfig &config, float *confidence)
+{
+    *confidence = 1.0f;
+    return true;
+}
+
+static yad::Detector *createDetector(YADConfig &config)
+{
+    return new BenchDetector(config);
+}
+
+static int getCaps(YADConfig &config, yad::PluginCaps *caps)
+{
+    caps->pix_formats = ~0u;
+    caps->data_types = YAD_PLUGIN_CAP_TYPE(YAD_DATA_TYPE_RAW) | YAD_PLUGIN_CAP_TYPE(YAD_DATA_TYPE_RAW_PLANES);
+    caps->rotations = YAD_PLUGIN_CAP_ROTATE_ALL;
+    caps->thread_safe = 0;
+    caps->detect_cost_ms = 1.0f;
+    caps->concurrent_create = 1;
+    return YAD_OK;
+}
+
+static yad::PluginV2 *createPlugin()
+{
+    static yad::PluginV2 plugin = {
+        YAD_PLUGIN_ABI_VERSION,
+        {getName, setLog, load, sniff, createDetector},
+        getCaps,
+        nullptr,
+    };
+    return &plugin;
+}
+
+YAD_REGISTER_STATIC_PLUGIN(Bench, createPlugin, 0);
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    size_t index = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+    return sorted[index];
+}
+
+static void run(const char *mode, bool serialized, int threads, int creates)
+{
+    static std::mutex s_serial_mutex;
+    std::vector<double> latencies;
+    std::mutex latenciesMutex;
+    std::atomic<bool> done(false);
+    double maxProbe = 0.0;
+    
+    // 创建期间不断查询插件个数，衡量读者是否被创建阻塞
+    std::thread probe([&] {
+        while (!done) {
+            auto begin = std::chrono::steady_clock::now();
+            if (serialized) {
+                std::lock_guard<std::mutex> lock(s_serial_mutex);
+                yad::Detector::Exists();
+            } else {
+                yad::Detector::Exists();
+            }
+            auto end = std::chrono::steady_clock::now();
+            maxProbe = std::max(maxProbe, std::chrono::duration<double, std::milli>(end - begin).count());
+            usleep(1000);
+        }
+    });
+    
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            YADConfig config;
+            config[kYADMaxFaceCount] = "1";
+            config[kYADPixFormat] = std::to_string(YAD_PIX_FMT_NV12);
+            config[kYADDataType] = std::to_string(YAD_DATA_TYPE_RAW);
+            for (int n = 0; n < creates; n++) {
+                auto start = std::chrono::steady_clock::now();
+                yad::Detector *detector;
+                if (serialized) {
+                    std::lock_guard<std::mutex> lock(s_serial_mutex);
+                    detector = yad::Detector::Create(config);
+                } else {
+                    detector = yad::Detector::Create(config);
+                }
+                auto end = std::chrono::steady_clock::now();
+                delete detector;
+                std::lock_guard<std::mutex> lock(latenciesMutex);
+                latencies.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    done = true;
+    probe.join();
+    
+    std::sort(latencies.begin(), latencies.end());
+    printf("%s\t%.1fms\t%.1fms\t%.1fms\t%.3fms\n", mode, total, percentile(latencies, 0.5), percentile(latencies, 0.99),
+           maxProbe);
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = 8;
+    int creates = 4;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:d:")) != -1) {
+        switch (opt) {
+            case 't':
+                threads = std::max(1, atoi(optarg));
+                break;
+            case 'n':
+                creates = std::max(1, atoi(optarg));
+                break;
+            case 'd':
+                s_load_ms = std::max(0, atoi(optarg));
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-t threads] [-n creates_per_thread] [-d load_ms]\n", argv[0]);
+                return 1;
+        }
+    }
+    
+    if (!yad::Detector::Exists()) {
+        fprintf(stderr, "no plugin\n");
+        return 1;
+    }
+    printf("threads: %d creates: %d load: %dms\n", threads, creates, s_load_ms);
+    printf("mode\ttotal\tp50\tp99\tprobe_max\n");
+    run("serialized", true, threads, creates);
+    run("concurrent", false, threads, creates);
+    return 0;
+}
@@ -0,0 +1,167 @@
+//
+//  bench-face-align.cpp
+//  YAD
+//
+//  人脸对齐裁剪基准：比较alignFaceChips(直接从源平面采样，SIMD坐标与插值)和先把整帧转换为RGB888、
+//  再逐像素浮点双线性采样的做法，输出各chip尺寸和源格式下每秒处理的chip数，以及两者的最大通道误差。
+//  YUV格式在YUV域插值后再转换为RGB，与先转换再插值相比有少量差别。
+//  用法: bench-face-align [-w width] [-h height] [-f faces] [-n rounds]
+//  编译: g++ -O2 -std=c++14 -I../YADetector/Classes -I../YADetector/Classes/3rd/Log
+//            bench-face-align.cpp ../YADetector/Classes/FaceAligner.cpp ../YADetector/Classes/ImageUtils.cpp
+//
+
+#include "FaceAligner.h"
+#include "ImageUtils.h"
+#include "LandmarkProfile.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// 旧做法：整帧转换为RGB888后用浮点坐标逐像素采样
+static void alignBaseline(const YADDetectImage &image, const YADFaceResults &faces, int chipSize,
+                          std::vector<uint8_t> *rgb, uint8_t *chips)
+{
+    yad::ImagePlanes planes;
+    yad::getImagePlanes(&image, &planes);
+    int rgbStride = planes.width * 3;
+    rgb->resize((size_t)rgbStride * planes.height);
+    yad::convertToRGB888(planes, rgb->data(), rgbStride);
+    
+    for (int i = 0; i < faces.num_faces; i++) {
+        float m[6];
+        uint8_t *chip = chips + yad::getFaceChipBytes(chipSize) * i;
+        yad::getFaceChipTransform(faces.faces[i], chipSize, m);
+        for (int v = 0; v < chipSize; v++) {
+            for (int u = 0; u < chipSize; u++) {
+                float x = m[0] * u + m[1] * v + m[2];
+                float y = m[3] * u + m[4] * v + m[5];
+                int x0 = (int)floorf(x);
+                int y0 = (int)floorf(y);
+                uint8_t *out = chip + ((size_t)v * chipSize + u) * 3;
+                if (x0 < -1 || y0 < -1 || x0 >= planes.width || y0 >= planes.height) {
+                    out[0] = out[1] = out[2] = 0;
+                    continue;
+                }
+                float fx = x - x0, fy = y - y0;
+                int x1 = std::min(x0 + 1, planes.width - 1), y1 = std::min(y0 + 1, planes.height - 1);
+                x0 = std::max(x0, 0);
+                y0 = std::max(y0, 0);
+                for (int c = 0; c < 3; c++) {
+                    const uint8_t *p = rgb->data() + c;
+                    float top = p[y0 * rgbStride + x0 * 3] * (1 - fx) + p[y0 * rgbStride + x1 * 3] * fx;
+                    float bottom = p[y1 * rgbStride + x0 * 3] * (1 - fx) + p[y1 * rgbStride + x1 * 3] * fx;
+                    out[c] = (uint8_t)(top * (1 - fy) + bottom * fy + 0.5f);
+                }
+            }
+        }
+    }
+}
+
+// 平滑渐变加噪声的图像，保证插值结果有意义
+static std::vector<uint8_t> makeImage(YADPixelFormat format, int width, int height, int *stride)
+{
+    *stride = width * std::max(1, yad::getPixelSize(format));
+    std::vector<uint8_t> data(yad::getImageSize(format, height, *stride));
+    size_t lumaSize = (size_t)height * *stride;
+    for (size_t i = 0; i < data.size(); i++) {
+        size_t row = i / *stride;
+        if (yad::isYUV420(format) && i >= lumaSize) {
+            // 色度接近中性，避免转换RGB时大量饱和，使误差只反映插值顺序的差别
+            data[i] = (uint8_t)(120 + rand() % 16);
+        } else {
+            data[i] = (uint8_t)((i % *stride) * 255 / *stride / 2 + row * 127 / height + rand() % 16);
+        }
+    }
+    return data;
+}
+
+// 在图像中均匀放置略微旋转的人脸，只填对齐需要的5个点
+static void makeFaces(int width, int height, int count, std::vector<YADFaceInfo> *faces)
+{
+    static const float shape[5][2] = {{-0.3f, -0.2f}, {0.3f, -0.2f}, {0.0f, 0.1f}, {-0.25f, 0.35f}, {0.25f, 0.35f}};
+    faces->assign(count, YADFaceInfo());
+    for (int i = 0; i < count; i++) {
+        float cx = width * (i + 0.5f) / count;
+        float cy = height * 0.5f;
+        float size = std::min((float)width / count, (float)height) * 0.6f;
+        float angle = 0.2f * (i - count / 2);
+        for (int k = 0; k < 5; k++) {
+            float x = shape[k][0] * size, y = shape[k][1] * size;
+            (*faces)[i].landmarks[yad::kLandmarkIndices5[k]].x = cx + x * cosf(angle) - y * sinf(angle);
+            (*faces)[i].landmarks[yad::kLandmarkIndices5[k]].y = cy + x * sinf(angle) + y * cosf(angle);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int width = 1280;
+    int height = 720;
+    int faceCount = 4;
+    int rounds = 50;
+    int opt;
+    while ((opt = getopt(argc, argv, "w:h:f:n:")) != -1) {
+        switch (opt) {
+            case 'w':
+                width = atoi(optarg) & ~1;
+                break;
+            case 'h':
+                height = atoi(optarg) & ~1;
+                break;
+            case 'f':
+                faceCount = std::max(1, atoi(optarg));
+                break;
+            case 'n':
+                rounds = std::max(1, atoi(optarg));
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-w width] [-h height] [-f faces] [-n rounds]\n", argv[0]);
+                return 1;
+        }
+    }
+    
+    std::vector<YADFaceInfo> faceInfos;
+    makeFaces(width, height, faceCount, &faceInfos);
+    YADFaceResults faces = {faceCount, faceCount, faceInfos.data()};
+    
+    static const YADPixelFormat formats[] = {YAD_PIX_FMT_RGB888, YAD_PIX_FMT_BGRA8888, YAD_PIX_FMT_NV12};
+    static const char *const formatNames[] = {"RGB888", "BGRA8888", "NV12"};
+    static const int sizes[] = {112, 224};
+    printf("format\tsize\tbaseline\taligned\tspeedup\tmaxdiff\n");
+    for (int f = 0; f < 3; f++) {
+        int stride;
+        std::vector<uint8_t> data = makeImage(formats[f], width, height, &stride);
+        YADDetectImage image = {formats[f], YAD_DATA_TYPE_RAW, data.data(), width, height, stride};
+        for (int size : sizes) {
+            std::vector<uint8_t> rgb;
+            std::vector<uint8_t> expected(yad::getFaceChipBytes(size) * faceCount);
+            std::vector<uint8_t> chips(expected.size());
+            
+            auto begin = std::chrono::steady_clock::now();
+            for (int n = 0; n < rounds; n++) {
+                alignBaseline(image, faces, size, &rgb, expected.data());
+            }
+            double baseline = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            
+            begin = std::chrono::steady_clock::now();
+            for (int n = 0; n < rounds; n++) {
+                yad::alignFaceChips(&image, &faces, size, YAD_PIX_FMT_RGB888, chips.data(), chips.size());
+            }
+            double aligned = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            
+            int maxDiff = 0;
+            for (size_t i = 0; i < chips.size(); i++) {
+                maxDiff = std::max(maxDiff, abs((int)chips[i] - (int)expected[i]));
+            }
+            double chipCount = (double)rounds * faceCount;
+            printf("%s\t%d\t%.0f/s\t%.0f/s\t%.2fx\t%d\n", formatNames[f], size, chipCount / baseline,
+                   chipCount / aligned, baseline / aligned, maxDiff);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+//
+//  bench-face-parallel.cpp
+//  YAD
+//
+//  多人脸并行基准：对同一幅多人脸图像反复调用Detector::detect，比较kYADWorkerThreads为1(串行)/2/4时的单帧耗时分位数。
+//  耗时包含插件的格式转换、检测和每个人脸的关键点与姿态，输出实际检测到的人脸数，图像中的人脸越多并行的收益越明显。
+//  用法: bench-face-parallel [-p plugin] [-m model_dir] [-n frames] image.ppm
+//        image.ppm为二进制PPM(P6)，按RGB888送入插件；model_dir下为NCNN插件的yadface/yadlandmark模型，默认使用插件自带的模型
+//  编译: g++ -O2 -std=c++14 -pthread -fopenmp -rdynamic -DWITH_YAD_NCNN -I<ncnn>/include/ncnn
+//            -I../YADetector/Classes -I../YADetector/Classes/3rd/Log -I../YADetector/Classes/Plugin
+//            -I../YADetector/Classes/Service bench-face-parallel.cpp $(find ../YADetector/Classes -name '*.cpp')
+//            -L<ncnn>/lib -lncnn -ldl
+//
+
+#include "YADetector.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define BENCH_WARMUP_FRAMES 3
+
+static bool readPPM(const std::string &path, int *width, int *height, std::vector<uint8_t> &pixels)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    
+    int maxValue = 0;
+    bool ok = fscanf(file, "P6 %d %d %d", width, height, &maxValue) == 3 && maxValue == 255 &&
+        *width > 0 && *height > 0 && fgetc(file) != EOF;
+    if (ok) {
+        pixels.resize((size_t)*width * *height * 3);
+        ok = fread(pixels.data(), 1, pixels.size(), file) == pixels.size();
+    }
+    fclose(file);
+    return ok;
+}
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    size_t index = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+    return sorted[index];
+}
+
+int main(int argc, char *argv[])
+{
+    std::string plugin;
+    std::string modelDir;
+    int frames = 50;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:m:n:")) != -1) {
+        switch (opt) {
+            case 'p':
+                plugin = optarg;
+                break;
+            case 'm':
+                modelDir = optarg;
+                break;
+            case 'n':
+                frames = std::max(1, atoi(optarg));
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-p plugin] [-m model_dir] [-n frames] image.ppm\n", argv[0]);
+        return 1;
+    }
+    
+    int width, height;
+    std::vector<uint8_t> pixels;
+    if (!readPPM(argv[optind], &width, &height, pixels)) {
+        fprintf(stderr, "read %s failed\n", argv[optind]);
+        return 1;
+    }
+    YADDetectImage image = {YAD_PIX_FMT_RGB888, YAD_DATA_TYPE_RAW, pixels.data(), width, height, width * 3};
+    
+    printf("image: %dx%d frames: %d\n", width, height, frames);
+    printf("workers\tfaces\tp50\tp90\tmax\n");
+    static const int workerCounts[] = {1, 2, 4};
+    for (int workers : workerCounts) {
+        YADConfig config;
+        config[kYADMaxFaceCount] = std::to_string(YAD_MAX_FACE_NUM);
+        config[kYADPixFormat] = std::to_string(YAD_PIX_FMT_RGB888);
+        config[kYADDataType] = std::to_string(YAD_DATA_TYPE_RAW);
+        config[kYADWorkerThreads] = std::to_string(workers);
+        if (!plugin.empty()) {
+            config[kYADPluginName] = plugin;
+        }
+        if (!modelDir.empty()) {
+            for (const char *name : {"yadface.param", "yadface.bin", "yadlandmark.param", "yadlandmark.bin"}) {
+                config[name] = modelDir + "/" + name;
+            }
+        }
+        std::unique_ptr<yad::Detector> detector(yad::Detector::Create(config));
+        if (!detector || detector->initCheck() != YAD_OK) {
+            fprintf(stderr, "create detector failed\n");
+            return 1;
+        }
+        
+        std::unique_ptr<YADFeatureInfo> featureInfo(new YADFeatureInfo);
+        std::vector<double> latencies;
+        int faces = 0;
+        for (int n = 0; n < BENCH_WARMUP_FRAMES + frames; n++) {
+            YADDetectInfo detectInfo;
+            memset(&detectInfo, 0, sizeof(detectInfo));
+            memset(featureInfo.get(), 0, sizeof(YADFeatureInfo));
+            auto begin = std::chrono::steady_clock::now();
+            int err = detector->detect(&image, &detectInfo, featureInfo.get());
+            auto end = std::chrono::steady_clock::now();
+            if (err != YAD_OK) {
+                fprintf(stderr, "detect failed, err: %d\n", err);
+                return 1;
+            }
+            if (n >= BENCH_WARMUP_FRAMES) {
+                latencies.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+            }
+            faces = featureInfo->num_faces;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        printf("%d\t%d\t%.3fms\t%.3fms\t%.3fms\n", workers, faces,
+               percentile(latencies, 0.5), percentile(latencies, 0.9), latencies.back());
+    }
+    return 0;
+}
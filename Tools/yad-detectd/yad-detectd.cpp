@@ -0,0 +1,86 @@
+//
+//  yad-detectd.cpp
+//  YAD
+//
+//  本机检测守护进程，多个进程共享同一份插件和模型。客户端在配置中指定 kYADServicePath 即可透明使用。
+//  用法: yad-detectd [-s socket_path] [-t threads] [-c cpus]
+//        -s socket路径，默认 YAD_SERVICE_DEFAULT_PATH
+//        -t 并行处理不同Detector的线程数，默认1
+//        -c 守护进程所有线程绑定的CPU，"big"为性能核，或CPU列表如"4-7"
+//  收到SIGHUP时重新扫描插件目录，新版本插件替换同名插件，客户端连接不中断
+//
+
+#include "DetectorService.h"
+#include "CpuAffinity.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+static yad::DetectorService *s_service = nullptr;
+
+static void onSignal(int sig)
+{
+    if (!s_service) {
+        return;
+    }
+    if (sig == SIGHUP) {
+        s_service->reload();
+    } else {
+        s_service->stop();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string path = YAD_SERVICE_DEFAULT_PATH;
+    int threads = 1;
+    std::string affinity;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:t:c:")) != -1) {
+        switch (opt) {
+            case 's':
+                path = optarg;
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'c':
+                affinity = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-s socket_path] [-t threads] [-c cpus]\n", argv[0]);
+                return 1;
+        }
+    }
+    
+    // 在创建任何线程之前绑定，之后创建的线程都继承这个绑定
+    if (!affinity.empty()) {
+        YADConfig config;
+        config[kYADCpuAffinity] = affinity;
+        std::vector<int> cpus;
+        if (yad::getConfigCpus(config, kYADCpuAffinity, &cpus) != YAD_OK || yad::setThreadAffinity(cpus) != YAD_OK) {
+            fprintf(stderr, "set cpu affinity %s failed\n", affinity.c_str());
+            return 1;
+        }
+    }
+    
+    yad::DetectorService service;
+    if (service.start(path, threads) != YAD_OK) {
+        fprintf(stderr, "start service on %s failed\n", path.c_str());
+        return 1;
+    }
+    
+    s_service = &service;
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGHUP, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+    
+    int err = service.run();
+    s_service = nullptr;
+    return err == YAD_OK ? 0 : 1;
+}
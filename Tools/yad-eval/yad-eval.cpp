@@ -0,0 +1,675 @@
+//
+//  yad-eval.cpp
+//  YAD
+//
+//  插件评测：在本地标注数据集上逐个运行已注册的插件，对比精度、稳定性、耗时和内存。
+//  用法: yad-eval [-p plugin] [-n max_face_count] [-w warmup] [-f rgb|bgra|nv12] [-b] [-j json_file] manifest
+//        -p 只评测指定名称的插件，默认评测所有插件
+//        -n 最多检测的人脸数，默认 YAD_MAX_FACE_NUM
+//        -w 每个Detector正式统计前预热的帧数，默认5。预热使用同尺寸的全黑帧，不产生跟踪状态
+//        -f 送入插件的像素格式，默认rgb(RGB888)，nv12按BT.601 video range转换
+//        -b 以CVPixelBuffer(YAD_DATA_TYPE_IOS_PIXEL_BUFFER)送入插件，只支持Apple平台的bgra和nv12，用于评测YADetectorTT
+//        -j 结果以JSON写入文件，"-"为标准输出
+//  manifest每行为 "序列名 图像路径 标注路径"，#开头为注释，路径相对manifest所在目录。
+//  图像为二进制PPM(P6)，先转换为-f指定的格式再送入插件，nv12时奇数的宽高去掉最后一列/行。标注文件每行一个人脸，为106个点的x y共212个数，
+//  同一序列内各帧的人脸顺序保持一致，用于计算抖动。序列名变化时重新创建Detector，清除跟踪状态。
+//  统计项:
+//    nme      关键点平均误差，按外眼角距离归一化
+//    jitter   相邻帧关键点位移与标注位移之差的平均值，同样归一化，只统计同一序列内连续匹配的人脸
+//    missed   没有匹配到检测结果(IoU < 0.3)的标注人脸数，extra为没有匹配到标注的检测结果数
+//    latency  单帧detect耗时的分位数
+//    peak_rss 检测期间常驻内存峰值相对创建Detector之前的增量(仅Linux)
+//
+
+#include "YADetector.h"
+#include "PluginManager.h"
+#ifdef __APPLE__
+#include <CoreVideo/CoreVideo.h>
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define EVAL_MATCH_IOU          0.3f
+#define EVAL_LEFT_EYE_OUTER     52  // 106点定义中的外眼角
+#define EVAL_RIGHT_EYE_OUTER    61
+#define EVAL_DEFAULT_WARMUP     5
+
+typedef std::vector<YADPoint2f> Landmarks;
+
+struct Sample {
+    std::string sequence;
+    std::string image_path;
+    std::string gt_path;
+};
+
+// 评测输入的格式
+struct InputFormat {
+    YADPixelFormat format;
+    YADDataType type;
+};
+
+// 送入插件的一帧，data为RAW格式的像素，pixel_buffer时由CVPixelBuffer持有一份拷贝
+struct EvalFrame {
+    std::vector<uint8_t> data;
+    YADDetectImage image;
+#ifdef __APPLE__
+    CVPixelBufferRef pixel_buffer = nullptr;
+    
+    ~EvalFrame()
+    {
+        if (pixel_buffer) {
+            CVPixelBufferRelease(pixel_buffer);
+        }
+    }
+#endif
+};
+
+struct EvalStats {
+    std::string plugin;
+    int err;                // 非0表示插件不可用
+    int frames;
+    int failures;
+    int gt_faces;
+    int missed;
+    int extra;
+    double nme_sum;
+    int nme_count;
+    double jitter_sum;
+    int jitter_count;
+    long peak_rss_kb;
+    std::vector<int64_t> latencies_us;
+};
+
+static int64_t percentile(std::vector<int64_t> &values, double p)
+{
+    if (values.empty()) {
+        return 0;
+    }
+    size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static int64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 读取/proc/self/status中的内存项，单位KB，不支持时返回0
+static long readStatusKb(const char *key)
+{
+    std::ifstream file("/proc/self/status");
+    std::string line;
+    size_t length = strlen(key);
+    while (std::getline(file, line)) {
+        if (line.compare(0, length, key) == 0 && line.size() > length && line[length] == ':') {
+            return atol(line.c_str() + length + 1);
+        }
+    }
+    return 0;
+}
+
+// 把VmHWM重置为当前的RSS，使每个插件的峰值单独统计
+static void resetPeakRss()
+{
+    FILE *file = fopen("/proc/self/clear_refs", "w");
+    if (file) {
+        fputs("5", file);
+        fclose(file);
+    }
+}
+
+static bool readManifest(const std::string &path, std::vector<Sample> &samples)
+{
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    
+    std::string base;
+    size_t pos = path.rfind('/');
+    if (pos != std::string::npos) {
+        base = path.substr(0, pos + 1);
+    }
+    
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream stream(line);
+        Sample sample;
+        if (!(stream >> sample.sequence >> sample.image_path >> sample.gt_path)) {
+            fprintf(stderr, "invalid manifest line: %s\n", line.c_str());
+            return false;
+        }
+        if (sample.image_path[0] != '/') {
+            sample.image_path = base + sample.image_path;
+        }
+        if (sample.gt_path[0] != '/') {
+            sample.gt_path = base + sample.gt_path;
+        }
+        samples.push_back(sample);
+    }
+    return true;
+}
+
+static bool readPPM(const std::string &path, int *width, int *height, std::vector<uint8_t> &pixels)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    
+    int maxValue = 0;
+    bool ok = fscanf(file, "P6 %d %d %d", width, height, &maxValue) == 3 && maxValue == 255 &&
+        *width > 0 && *height > 0 && fgetc(file) != EOF;
+    if (ok) {
+        pixels.resize((size_t)*width * *height * 3);
+        ok = fread(pixels.data(), 1, pixels.size(), file) == pixels.size();
+    }
+    fclose(file);
+    return ok;
+}
+
+// RGB888转换为format的紧凑RAW格式，NV12的色度取2x2像素的平均
+static void convertFromRGB(const std::vector<uint8_t> &rgb, int width, int height, YADPixelFormat format,
+                           std::vector<uint8_t> &dst)
+{
+    if (format == YAD_PIX_FMT_RGB888) {
+        dst = rgb;
+        return;
+    }
+    if (format == YAD_PIX_FMT_BGRA8888) {
+        dst.resize((size_t)width * height * 4);
+        for (size_t i = 0; i < (size_t)width * height; i++) {
+            dst[i * 4] = rgb[i * 3 + 2];
+            dst[i * 4 + 1] = rgb[i * 3 + 1];
+            dst[i * 4 + 2] = rgb[i * 3];
+            dst[i * 4 + 3] = 255;
+        }
+        return;
+    }
+    
+    // NV12，width和height为偶数，rgb的步长为width * 3
+    dst.resize((size_t)width * height * 3 / 2);
+    uint8_t *uv = dst.data() + (size_t)width * height;
+    for (int y = 0; y < height; y++) {
+        const uint8_t *src = rgb.data() + (size_t)y * width * 3;
+        for (int x = 0; x < width; x++) {
+            int r = src[x * 3], g = src[x * 3 + 1], b = src[x * 3 + 2];
+            dst[(size_t)y * width + x] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+    }
+    for (int y = 0; y < height; y += 2) {
+        for (int x = 0; x < width; x += 2) {
+            int r = 0, g = 0, b = 0;
+            for (int k = 0; k < 4; k++) {
+                const uint8_t *p = rgb.data() + ((size_t)(y + k / 2) * width + x + k % 2) * 3;
+                r += p[0];
+                g += p[1];
+                b += p[2];
+            }
+            r = (r + 2) / 4;
+            g = (g + 2) / 4;
+            b = (b + 2) / 4;
+            uv[(size_t)y / 2 * width + x] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            uv[(size_t)y / 2 * width + x + 1] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+}
+
+// 把PPM读到的RGB888帧转换为评测的输入格式
+static bool makeFrame(std::vector<uint8_t> &rgb, int width, int height, const InputFormat &input, EvalFrame *frame)
+{
+    if (input.format == YAD_PIX_FMT_NV12 && (width % 2 || height % 2)) {
+        // 去掉奇数的最后一列/行，标注坐标不变
+        int evenWidth = width & ~1;
+        int evenHeight = height & ~1;
+        if (evenWidth == 0 || evenHeight == 0) {
+            return false;
+        }
+        for (int y = 0; y < evenHeight; y++) {
+            memmove(rgb.data() + (size_t)y * evenWidth * 3, rgb.data() + (size_t)y * width * 3, (size_t)evenWidth * 3);
+        }
+        width = evenWidth;
+        height = evenHeight;
+        rgb.resize((size_t)width * height * 3);
+    }
+    convertFromRGB(rgb, width, height, input.format, frame->data);
+    
+    int stride = input.format == YAD_PIX_FMT_NV12 ? width : width * (input.format == YAD_PIX_FMT_RGB888 ? 3 : 4);
+    frame->image = {input.format, YAD_DATA_TYPE_RAW, frame->data.data(), width, height, stride};
+    if (input.type != YAD_DATA_TYPE_IOS_PIXEL_BUFFER) {
+        return true;
+    }
+    
+#ifdef __APPLE__
+    OSType pixelType = input.format == YAD_PIX_FMT_NV12 ? kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange :
+        kCVPixelFormatType_32BGRA;
+    if (CVPixelBufferCreate(kCFAllocatorDefault, width, height, pixelType, NULL, &frame->pixel_buffer) !=
+        kCVReturnSuccess) {
+        return false;
+    }
+    CVPixelBufferLockBaseAddress(frame->pixel_buffer, 0);
+    if (input.format == YAD_PIX_FMT_NV12) {
+        const uint8_t *src = frame->data.data();
+        for (int plane = 0; plane < 2; plane++) {
+            uint8_t *dst = (uint8_t *)CVPixelBufferGetBaseAddressOfPlane(frame->pixel_buffer, plane);
+            size_t dstStride = CVPixelBufferGetBytesPerRowOfPlane(frame->pixel_buffer, plane);
+            int rows = plane == 0 ? height : height / 2;
+            for (int y = 0; y < rows; y++) {
+                memcpy(dst + y * dstStride, src + (size_t)y * width, width);
+            }
+            src += (size_t)width * height;
+        }
+    } else {
+        uint8_t *dst = (uint8_t *)CVPixelBufferGetBaseAddress(frame->pixel_buffer);
+        size_t dstStride = CVPixelBufferGetBytesPerRow(frame->pixel_buffer);
+        for (int y = 0; y < height; y++) {
+            memcpy(dst + y * dstStride, frame->data.data() + (size_t)y * stride, (size_t)stride);
+        }
+    }
+    CVPixelBufferUnlockBaseAddress(frame->pixel_buffer, 0);
+    frame->image.type = YAD_DATA_TYPE_IOS_PIXEL_BUFFER;
+    frame->image.data = frame->pixel_buffer;
+    return true;
+#else
+    return false;
+#endif
+}
+
+// 用同尺寸的全黑帧预热，初始化后端而不留下人脸跟踪状态
+static void warmupDetector(yad::Detector *detector, int warmup, const InputFormat &input, int width, int height,
+                           YADFaceResults *results)
+{
+    if (warmup <= 0) {
+        return;
+    }
+    int evenWidth = input.format == YAD_PIX_FMT_NV12 ? width & ~1 : width;
+    int evenHeight = input.format == YAD_PIX_FMT_NV12 ? height & ~1 : height;
+    std::vector<uint8_t> black((size_t)evenWidth * evenHeight * 3, 0);
+    EvalFrame frame;
+    if (!makeFrame(black, evenWidth, evenHeight, input, &frame)) {
+        return;
+    }
+    for (int i = 0; i < warmup; i++) {
+        YADDetectInfo info;
+        memset(&info, 0, sizeof(info));
+        results->num_faces = 0;
+        detector->detectFaces(&frame.image, &info, results);
+    }
+    results->num_faces = 0;
+}
+
+static bool readLandmarks(const std::string &path, std::vector<Landmarks> &faces)
+{
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        Landmarks points(YAD_FACE_LANDMARK_NUM);
+        int count = 0;
+        while (count < YAD_FACE_LANDMARK_NUM && stream >> points[count].x >> points[count].y) {
+            count++;
+        }
+        if (count == 0) {
+            continue;
+        }
+        if (count != YAD_FACE_LANDMARK_NUM) {
+            fprintf(stderr, "%s: expect %d points, got %d\n", path.c_str(), YAD_FACE_LANDMARK_NUM, count);
+            return false;
+        }
+        faces.push_back(points);
+    }
+    return true;
+}
+
+static YADRectf boundingRect(const Landmarks &points)
+{
+    float x1 = points[0].x, y1 = points[0].y, x2 = x1, y2 = y1;
+    for (const YADPoint2f &point : points) {
+        x1 = std::min(x1, point.x);
+        y1 = std::min(y1, point.y);
+        x2 = std::max(x2, point.x);
+        y2 = std::max(y2, point.y);
+    }
+    return {x1, y1, x2 - x1, y2 - y1};
+}
+
+static float intersectionOverUnion(const YADRectf &a, const YADRectf &b)
+{
+    float w = std::min(a.x + a.w, b.x + b.w) - std::max(a.x, b.x);
+    float h = std::min(a.y + a.h, b.y + b.h) - std::max(a.y, b.y);
+    if (w <= 0.0f || h <= 0.0f) {
+        return 0.0f;
+    }
+    float inter = w * h;
+    return inter / (a.w * a.h + b.w * b.h - inter);
+}
+
+static float normalizeDistance(const Landmarks &gt)
+{
+    float dx = gt[EVAL_LEFT_EYE_OUTER].x - gt[EVAL_RIGHT_EYE_OUTER].x;
+    float dy = gt[EVAL_LEFT_EYE_OUTER].y - gt[EVAL_RIGHT_EYE_OUTER].y;
+    float distance = sqrtf(dx * dx + dy * dy);
+    if (distance < 1.0f) {
+        // 标注不是106点定义时退化为人脸框的尺度
+        YADRectf rect = boundingRect(gt);
+        distance = std::max(1.0f, sqrtf(rect.w * rect.h));
+    }
+    return distance;
+}
+
+// 每个标注人脸贪心匹配IoU最大的检测结果，返回检测结果下标，没有匹配时为-1
+static std::vector<int> matchFaces(const std::vector<Landmarks> &gt, const YADFaceResults &results)
+{
+    std::vector<int> matches(gt.size(), -1);
+    std::vector<bool> used(results.num_faces, false);
+    for (size_t i = 0; i < gt.size(); i++) {
+        YADRectf rect = boundingRect(gt[i]);
+        float best = EVAL_MATCH_IOU;
+        for (int j = 0; j < results.num_faces; j++) {
+            float iou = used[j] ? 0.0f : intersectionOverUnion(rect, results.faces[j].rect);
+            if (iou >= best) {
+                best = iou;
+                matches[i] = j;
+            }
+        }
+        if (matches[i] >= 0) {
+            used[matches[i]] = true;
+        }
+    }
+    return matches;
+}
+
+static void evaluatePlugin(const std::string &plugin, const std::vector<Sample> &samples, int maxFaceCount,
+                           int warmup, const InputFormat &input, EvalStats *stats)
+{
+    stats->plugin = plugin;
+    
+    YADConfig config;
+    config[kYADMaxFaceCount] = std::to_string(maxFaceCount);
+    config[kYADPixFormat] = std::to_string(input.format);
+    config[kYADDataType] = std::to_string(input.type);
+    config[kYADPluginName] = plugin;
+    
+    std::vector<YADFaceInfo> faces(maxFaceCount);
+    std::unique_ptr<yad::Detector> detector;
+    std::string sequence;
+    std::vector<Landmarks> prevGt;
+    std::vector<Landmarks> prevPred;
+    
+    resetPeakRss();
+    long baseRss = readStatusKb("VmRSS");
+    
+    for (size_t index = 0; index < samples.size(); index++) {
+        const Sample &sample = samples[index];
+        int width, height;
+        std::vector<uint8_t> pixels;
+        std::vector<Landmarks> gt;
+        EvalFrame frame;
+        if (!readPPM(sample.image_path, &width, &height, pixels) || !readLandmarks(sample.gt_path, gt) ||
+            !makeFrame(pixels, width, height, input, &frame)) {
+            fprintf(stderr, "read %s failed\n", sample.image_path.c_str());
+            stats->err = YAD_BAD_VALUE;
+            return;
+        }
+        YADFaceResults results = {0, maxFaceCount, faces.data()};
+        
+        // 新序列重新创建Detector，避免跟踪状态跨序列
+        if (!detector || sample.sequence != sequence) {
+            detector.reset(yad::Detector::Create(config));
+            if (!detector || detector->initCheck() != YAD_OK) {
+                stats->err = detector ? detector->initCheck() : YAD_NAME_NOT_FOUND;
+                return;
+            }
+            sequence = sample.sequence;
+            prevGt.clear();
+            prevPred.clear();
+            // 预热帧只用于初始化后端，不计入统计。预热不用被统计的帧，避免其跟踪结果影响统计
+            warmupDetector(detector.get(), warmup, input, width, height, &results);
+        }
+        
+        YADDetectInfo info;
+        memset(&info, 0, sizeof(info));
+        
+        int64_t start = nowUs();
+        int err = detector->detectFaces(&frame.image, &info, &results);
+        stats->latencies_us.push_back(nowUs() - start);
+        stats->frames++;
+        stats->gt_faces += (int)gt.size();
+        if (err != YAD_OK) {
+            stats->failures++;
+            stats->missed += (int)gt.size();
+            prevGt.clear();
+            prevPred.clear();
+            continue;
+        }
+        
+        std::vector<int> matches = matchFaces(gt, results);
+        std::vector<Landmarks> pred(gt.size());
+        int matched = 0;
+        for (size_t i = 0; i < gt.size(); i++) {
+            if (matches[i] < 0) {
+                stats->missed++;
+                continue;
+            }
+            matched++;
+            const YADFaceInfo &face = results.faces[matches[i]];
+            pred[i].assign(face.landmarks, face.landmarks + YAD_FACE_LANDMARK_NUM);
+            
+            float scale = normalizeDistance(gt[i]);
+            double error = 0.0;
+            for (int k = 0; k < YAD_FACE_LANDMARK_NUM; k++) {
+                error += hypotf(pred[i][k].x - gt[i][k].x, pred[i][k].y - gt[i][k].y);
+            }
+            stats->nme_sum += error / YAD_FACE_LANDMARK_NUM / scale;
+            stats->nme_count++;
+            
+            // 抖动只计入标注之外的位移，真实的运动不算抖动
+            if (i < prevGt.size() && !prevPred[i].empty()) {
+                double jitter = 0.0;
+                for (int k = 0; k < YAD_FACE_LANDMARK_NUM; k++) {
+                    float dx = (pred[i][k].x - prevPred[i][k].x) - (gt[i][k].x - prevGt[i][k].x);
+                    float dy = (pred[i][k].y - prevPred[i][k].y) - (gt[i][k].y - prevGt[i][k].y);
+                    jitter += hypotf(dx, dy);
+                }
+                stats->jitter_sum += jitter / YAD_FACE_LANDMARK_NUM / scale;
+                stats->jitter_count++;
+            }
+        }
+        stats->extra += results.num_faces - matched;
+        prevGt = gt;
+        prevPred = pred;
+    }
+    
+    detector.reset();
+    stats->peak_rss_kb = std::max(0L, readStatusKb("VmHWM") - baseRss);
+}
+
+static void printTable(std::vector<EvalStats> &results)
+{
+    printf("%-20s %7s %8s %8s %7s %6s %8s %8s %8s %10s\n", "plugin", "frames", "nme", "jitter", "missed", "extra",
+           "p50(us)", "p90(us)", "p99(us)", "peak(KB)");
+    for (EvalStats &stats : results) {
+        if (stats.err != YAD_OK) {
+            printf("%-20s unavailable, err: %d\n", stats.plugin.c_str(), stats.err);
+            continue;
+        }
+        printf("%-20s %7d %8.4f %8.4f %7d %6d %8lld %8lld %8lld %10ld\n", stats.plugin.c_str(), stats.frames,
+               stats.nme_count ? stats.nme_sum / stats.nme_count : 0.0,
+               stats.jitter_count ? stats.jitter_sum / stats.jitter_count : 0.0,
+               stats.missed, stats.extra,
+               (long long)percentile(stats.latencies_us, 0.5),
+               (long long)percentile(stats.latencies_us, 0.9),
+               (long long)percentile(stats.latencies_us, 0.99),
+               stats.peak_rss_kb);
+    }
+}
+
+// JSON字符串转义，插件名称来自动态库，不能保证不含引号或控制字符
+static std::string jsonEscape(const std::string &value)
+{
+    std::string escaped;
+    for (unsigned char c : value) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += (char)c;
+        } else if (c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            escaped += buf;
+        } else {
+            escaped += (char)c;
+        }
+    }
+    return escaped;
+}
+
+static void writeJson(FILE *file, std::vector<EvalStats> &results)
+{
+    fprintf(file, "[\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        EvalStats &stats = results[i];
+        fprintf(file, "  {\"plugin\": \"%s\", \"err\": %d, \"frames\": %d, \"failures\": %d, \"gt_faces\": %d, "
+                "\"missed\": %d, \"extra\": %d, \"nme\": %.6f, \"nme_samples\": %d, \"jitter\": %.6f, "
+                "\"jitter_samples\": %d, \"latency_p50_us\": %lld, \"latency_p90_us\": %lld, "
+                "\"latency_p99_us\": %lld, \"peak_rss_kb\": %ld}%s\n",
+                jsonEscape(stats.plugin).c_str(), stats.err, stats.frames, stats.failures, stats.gt_faces,
+                stats.missed, stats.extra, stats.nme_count ? stats.nme_sum / stats.nme_count : 0.0, stats.nme_count,
+                stats.jitter_count ? stats.jitter_sum / stats.jitter_count : 0.0, stats.jitter_count,
+                (long long)percentile(stats.latencies_us, 0.5),
+                (long long)percentile(stats.latencies_us, 0.9),
+                (long long)percentile(stats.latencies_us, 0.99),
+                stats.peak_rss_kb, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::string plugin;
+    std::string jsonPath;
+    int maxFaceCount = YAD_MAX_FACE_NUM;
+    int warmup = EVAL_DEFAULT_WARMUP;
+    InputFormat input = {YAD_PIX_FMT_RGB888, YAD_DATA_TYPE_RAW};
+    bool badFormat = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:n:w:f:bj:")) != -1) {
+        switch (opt) {
+            case 'p':
+                plugin = optarg;
+                break;
+            case 'n':
+                maxFaceCount = std::max(1, atoi(optarg));
+                break;
+            case 'w':
+                warmup = std::max(0, atoi(optarg));
+                break;
+            case 'f':
+                if (strcmp(optarg, "rgb") == 0) {
+                    input.format = YAD_PIX_FMT_RGB888;
+                } else if (strcmp(optarg, "bgra") == 0) {
+                    input.format = YAD_PIX_FMT_BGRA8888;
+                } else if (strcmp(optarg, "nv12") == 0) {
+                    input.format = YAD_PIX_FMT_NV12;
+                } else {
+                    badFormat = true;
+                }
+                break;
+            case 'b':
+                input.type = YAD_DATA_TYPE_IOS_PIXEL_BUFFER;
+                break;
+            case 'j':
+                jsonPath = optarg;
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if (optind >= argc || badFormat) {
+        fprintf(stderr, "usage: %s [-p plugin] [-n max_face_count] [-w warmup] [-f rgb|bgra|nv12] [-b] "
+                "[-j json_file] manifest\n", argv[0]);
+        return 1;
+    }
+    if (input.type == YAD_DATA_TYPE_IOS_PIXEL_BUFFER) {
+#ifdef __APPLE__
+        if (input.format == YAD_PIX_FMT_RGB888) {
+            fprintf(stderr, "pixel buffer input requires -f bgra or -f nv12\n");
+            return 1;
+        }
+#else
+        fprintf(stderr, "pixel buffer input is only supported on Apple platforms\n");
+        return 1;
+#endif
+    }
+    
+    std::vector<Sample> samples;
+    if (!readManifest(argv[optind], samples) || samples.empty()) {
+        fprintf(stderr, "read manifest %s failed\n", argv[optind]);
+        return 1;
+    }
+    
+    std::vector<std::string> plugins;
+    if (plugin.empty()) {
+        // 同名插件按名称选择时是同一个候选集，只评测一次
+        std::vector<std::string> names;
+        yad::PluginManager::getInstance().getPluginNames(names);
+        for (const std::string &name : names) {
+            if (std::find(plugins.begin(), plugins.end(), name) == plugins.end()) {
+                plugins.push_back(name);
+            }
+        }
+    } else {
+        plugins.push_back(plugin);
+    }
+    if (plugins.empty()) {
+        fprintf(stderr, "no plugin found\n");
+        return 1;
+    }
+    
+    // 插件依次运行，互不影响内存峰值的统计
+    std::vector<EvalStats> results;
+    for (const std::string &name : plugins) {
+        EvalStats stats;
+        stats.err = YAD_OK;
+        stats.frames = stats.failures = stats.gt_faces = stats.missed = stats.extra = 0;
+        stats.nme_sum = stats.jitter_sum = 0.0;
+        stats.nme_count = stats.jitter_count = 0;
+        stats.peak_rss_kb = 0;
+        evaluatePlugin(name, samples, maxFaceCount, warmup, input, &stats);
+        results.push_back(std::move(stats));
+    }
+    
+    printTable(results);
+    if (!jsonPath.empty()) {
+        FILE *file = jsonPath == "-" ? stdout : fopen(jsonPath.c_str(), "w");
+        if (!file) {
+            fprintf(stderr, "open %s failed\n", jsonPath.c_str());
+            return 1;
+        }
+        writeJson(file, results);
+        if (file != stdout) {
+            fclose(file);
+        }
+    }
+    return 0;
+}
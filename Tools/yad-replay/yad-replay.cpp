@@ -0,0 +1,89 @@
+//
+//  yad-replay.cpp
+//  YAD
+//
+//  回放录制文件，统计detect耗时。录制文件由配置 kYADRecordPath 生成。
+//  用法: yad-replay [-r] [-n max_face_count] record_file
+//        -r 按录制的时间间隔回放，默认尽可能快
+//
+
+#include "YADetector.h"
+#include "FrameRecorder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+
+static int64_t percentile(std::vector<int64_t> &values, double p)
+{
+    if (values.empty()) {
+        return 0;
+    }
+    size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+int main(int argc, char *argv[])
+{
+    bool realtime = false;
+    int maxFaceCount = YAD_MAX_FACE_NUM;
+    int opt;
+    while ((opt = getopt(argc, argv, "rn:")) != -1) {
+        switch (opt) {
+            case 'r':
+                realtime = true;
+                break;
+            case 'n':
+                maxFaceCount = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-r] [-n max_face_count] record_file\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s [-r] [-n max_face_count] record_file\n", argv[0]);
+        return 1;
+    }
+    
+    yad::FrameReplayer replayer;
+    if (replayer.open(argv[optind]) != YAD_OK) {
+        fprintf(stderr, "open %s failed\n", argv[optind]);
+        return 1;
+    }
+    
+    // 使用第一帧的格式选择插件
+    YADDetectImage detectImage;
+    YADDetectInfo detectInfo;
+    if (replayer.readFrame(&detectImage, &detectInfo, nullptr) != YAD_OK) {
+        fprintf(stderr, "empty record file\n");
+        return 1;
+    }
+    
+    YADConfig config;
+    config[kYADMaxFaceCount] = std::to_string(maxFaceCount);
+    config[kYADPixFormat] = std::to_string(detectImage.format);
+    config[kYADDataType] = std::to_string(YAD_DATA_TYPE_RAW);
+    std::unique_ptr<yad::Detector> detector(yad::Detector::Create(config));
+    if (!detector || detector->initCheck() != YAD_OK) {
+        fprintf(stderr, "create detector failed\n");
+        return 1;
+    }
+    
+    yad::ReplayStats stats;
+    int err = replayer.replay(detector.get(), realtime, &stats);
+    if (err != YAD_OK) {
+        fprintf(stderr, "replay failed, err: %d\n", err);
+        return 1;
+    }
+    
+    printf("frames: %d failures: %d p50: %lldus p90: %lldus p99: %lldus\n", stats.frames, stats.failures,
+           (long long)percentile(stats.latencies_us, 0.5),
+           (long long)percentile(stats.latencies_us, 0.9),
+           (long long)percentile(stats.latencies_us, 0.99));
+    return 0;
+}
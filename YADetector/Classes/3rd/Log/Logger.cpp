@@ -9,6 +9,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <mutex>
 #include <memory>
 #include <string>
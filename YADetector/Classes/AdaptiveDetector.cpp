@@ -0,0 +1,302 @@
+//
+//  AdaptiveDetector.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADBudget"
+#include "LogMacros.h"
+
+#include "AdaptiveDetector.h"
+#include "ImageUtils.h"
+#include "PluginModule.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#define YAD_BUDGET_ROI_MARGIN       0.5f    // ROI在人脸框外扩的比例
+#define YAD_BUDGET_ROI_MAX_AREA     0.6f    // ROI超过图像面积的该比例时直接全图检测
+
+namespace yad {
+
+typedef struct {
+    float detect_scale;
+    bool roi;
+    int max_faces;
+} BudgetLevel;
+
+static const BudgetLevel kBudgetLevels[YAD_BUDGET_LEVEL_COUNT] = {
+    {1.0f,  false,  0},
+    {1.0f,  true,   0},
+    {0.75f, true,   0},
+    {0.5f,  true,   4},
+    {0.5f,  true,   1},
+};
+
+static int64_t getNowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AdaptiveDetector::AdaptiveDetector(Detector *detector, YADConfig &config, ModuleDetector *module) :
+    detector_(detector),
+    module_(module),
+    budget_us_(0),
+    detect_scale_(1.0f),
+    level_(0),
+    quality_level_(-1),
+    settle_frames_(0),
+    headroom_frames_(0),
+    scan_frames_(0),
+    latency_valid_(false),
+    roi_valid_(false),
+    roi_supported_(true),
+    roi_({0, 0, 0, 0})
+{
+    memset(&stats_, 0, sizeof(stats_));
+    auto it = config.find(kYADFrameBudgetUs);
+    if (it != config.end() && !it->second.empty()) {
+        budget_us_ = std::max(0, std::stoi(it->second));
+    }
+    it = config.find(kYADDetectScale);
+    if (it != config.end() && !it->second.empty()) {
+        float scale = std::stof(it->second);
+        detect_scale_ = scale > 0.0f && scale < 1.0f ? scale : 1.0f;
+    }
+}
+
+AdaptiveDetector::~AdaptiveDetector()
+{
+    if (stats_.frames > 0) {
+        YLOGI("missed budget %llu of %llu frames", (unsigned long long)stats_.missed, (unsigned long long)stats_.frames);
+    }
+}
+
+int AdaptiveDetector::initCheck() const
+{
+    return detector_ ? detector_->initCheck() : YAD_NO_INIT;
+}
+
+YADLandmarkProfile AdaptiveDetector::getLandmarkProfile() const
+{
+    return detector_ ? detector_->getLandmarkProfile() : YAD_LANDMARK_PROFILE_106;
+}
+
+BudgetStats AdaptiveDetector::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+int AdaptiveDetector::detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo)
+{
+    if (!featureInfo) {
+        return YAD_BAD_VALUE;
+    }
+    
+    YADFaceResults faceResults = makeFaceResults(featureInfo);
+    int ret = detectFaces(detectImage, detectInfo, &faceResults);
+    featureInfo->num_faces = faceResults.num_faces;
+    return ret;
+}
+
+int AdaptiveDetector::detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults)
+{
+    if (!detector_) {
+        return YAD_NO_INIT;
+    }
+    if (!detectImage || !detectInfo || !faceResults) {
+        return YAD_BAD_VALUE;
+    }
+    if (budget_us_ <= 0) {
+        return detector_->detectFaces(detectImage, detectInfo, faceResults);
+    }
+    
+    // 等级变化后在两帧之间通知插件，调用者配置的分辨率更低时保留。插件不支持时只能靠ROI和裁剪人脸数
+    std::unique_lock<std::mutex> lock(mutex_);
+    const BudgetLevel &level = kBudgetLevels[level_];
+    if (module_ && quality_level_ != level_) {
+        YADDetectQuality quality = {std::min(detect_scale_, level.detect_scale), level.max_faces};
+        int err = module_->setQuality(&quality);
+        if (err != YAD_OK && err != YAD_INVALID_OPERATION) {
+            YLOGW("set quality failed, level: %d err: %d", level_, err);
+        }
+        quality_level_ = level_;
+    }
+    int maxFaces = level.max_faces;
+    bool useRoi = level.roi && roi_valid_ && roi_supported_ && scan_frames_ < YAD_BUDGET_FULL_SCAN_INTERVAL;
+    YADRecti roi = roi_;
+    lock.unlock();
+    
+    YADDetectImage roiImage;
+    YADRawPlanes rawPlanes;
+    if (useRoi) {
+        useRoi = makeRoiImage(detectImage, roi, &roiImage, &rawPlanes);
+    }
+    
+    int64_t start = getNowUs();
+    int err;
+    bool roiFailed = false;
+    if (useRoi) {
+        err = detector_->detectFaces(&roiImage, detectInfo, faceResults);
+        if (err == YAD_FORMAT_UNSUPPORTED || err == YAD_BAD_VALUE) {
+            // 插件不支持多平面裁剪，改为全图并不再使用ROI
+            roiFailed = true;
+            useRoi = false;
+            err = detector_->detectFaces(detectImage, detectInfo, faceResults);
+        }
+    } else {
+        err = detector_->detectFaces(detectImage, detectInfo, faceResults);
+    }
+    int64_t latency = getNowUs() - start;
+    // 插件可能没有按setQuality限制人脸数，由框架保证
+    if (err == YAD_OK && maxFaces > 0 && faceResults->num_faces > maxFaces) {
+        faceResults->num_faces = maxFaces;
+    }
+    
+    lock.lock();
+    if (roiFailed) {
+        YLOGW("roi unsupported by plugin, fall back to full scan");
+        roi_supported_ = false;
+    }
+    stats_.frames++;
+    if (useRoi) {
+        stats_.roi_frames++;
+        scan_frames_++;
+    } else {
+        scan_frames_ = 0;
+    }
+    if (latency > budget_us_) {
+        stats_.missed++;
+    }
+    updateLevel(latency);
+    if (err == YAD_OK) {
+        updateRoi(faceResults, detectImage->width, detectImage->height);
+    } else {
+        roi_valid_ = false;
+    }
+    return err;
+}
+
+#pragma mark Private
+
+void AdaptiveDetector::updateLevel(int64_t latencyUs)
+{
+    int budgetUs = budget_us_;
+    if (!latency_valid_) {
+        stats_.latency_avg_us = latencyUs;
+        latency_valid_ = true;
+    } else {
+        stats_.latency_avg_us += (latencyUs - stats_.latency_avg_us) / 8;
+    }
+    
+    if (settle_frames_ > 0) {
+        settle_frames_--;
+    }
+    
+    // 接近预算或者超出预算时降级，留出余量应对抖动
+    bool over = latencyUs > budgetUs || stats_.latency_avg_us > budgetUs * 85 / 100;
+    if (over) {
+        headroom_frames_ = 0;
+        if (settle_frames_ == 0 && level_ < YAD_BUDGET_LEVEL_COUNT - 1) {
+            level_++;
+            settle_frames_ = YAD_BUDGET_SETTLE_FRAMES;
+            latency_valid_ = false;
+            YLOGD("degrade to level %d, latency: %lld budget: %d", level_, (long long)latencyUs, budgetUs);
+        }
+    } else if (stats_.latency_avg_us < budgetUs / 2) {
+        headroom_frames_++;
+        if (headroom_frames_ >= YAD_BUDGET_RECOVER_FRAMES && level_ > 0) {
+            level_--;
+            headroom_frames_ = 0;
+            settle_frames_ = YAD_BUDGET_SETTLE_FRAMES;
+            latency_valid_ = false;
+            YLOGD("recover to level %d, latency: %lld budget: %d", level_, (long long)stats_.latency_avg_us, budgetUs);
+        }
+    } else {
+        headroom_frames_ = 0;
+    }
+    stats_.level = level_;
+}
+
+void AdaptiveDetector::updateRoi(const YADFaceResults *faceResults, int width, int height)
+{
+    if (faceResults->num_faces <= 0) {
+        // 没有人脸时下一帧全图检测
+        roi_valid_ = false;
+        return;
+    }
+    
+    float x1 = (float)width, y1 = (float)height, x2 = 0.0f, y2 = 0.0f;
+    for (int i = 0; i < faceResults->num_faces; i++) {
+        const YADRectf &rect = faceResults->faces[i].rect;
+        float margin = std::max(rect.w, rect.h) * YAD_BUDGET_ROI_MARGIN;
+        x1 = std::min(x1, rect.x - margin);
+        y1 = std::min(y1, rect.y - margin);
+        x2 = std::max(x2, rect.x + rect.w + margin);
+        y2 = std::max(y2, rect.y + rect.h + margin);
+    }
+    
+    int left = std::max(0, (int)floorf(x1));
+    int top = std::max(0, (int)floorf(y1));
+    int right = std::min(width, (int)ceilf(x2));
+    int bottom = std::min(height, (int)ceilf(y2));
+    roi_valid_ = right > left && bottom > top;
+    roi_ = {left, top, right - left, bottom - top};
+}
+
+bool AdaptiveDetector::makeRoiImage(const YADDetectImage *detectImage, const YADRecti &roi, YADDetectImage *roiImage,
+                                    YADRawPlanes *rawPlanes)
+{
+    ImagePlanes planes;
+    if (getImagePlanes(detectImage, &planes) != YAD_OK) {
+        return false;
+    }
+    
+    // ROI和调用者的crop都相对整幅图像，ROI限制在crop之内
+    int cropRight = planes.crop_x + planes.width;
+    int cropBottom = planes.crop_y + planes.height;
+    int left = std::max(roi.x, planes.crop_x);
+    int top = std::max(roi.y, planes.crop_y);
+    int right = std::min(roi.x + roi.w, cropRight);
+    int bottom = std::min(roi.y + roi.h, cropBottom);
+    if (isYUV420(planes.format)) {
+        // 色度平面要求偶数坐标，crop的起点已经是偶数
+        left &= ~1;
+        top &= ~1;
+        right = std::min(right + (right & 1), cropRight);
+        bottom = std::min(bottom + (bottom & 1), cropBottom);
+    }
+    if (right <= left || bottom <= top) {
+        return false;
+    }
+    if ((float)(right - left) * (bottom - top) > (float)planes.width * planes.height * YAD_BUDGET_ROI_MAX_AREA) {
+        return false;
+    }
+    
+    // 保留调用者的基地址和偏移，只把crop换成ROI，插件直接输出整幅图像的坐标，
+    // ROI帧和全图检测时跟踪看到的坐标一致
+    if (detectImage->type == YAD_DATA_TYPE_RAW_PLANES) {
+        *rawPlanes = *(const YADRawPlanes *)detectImage->data;
+    } else {
+        memset(rawPlanes, 0, sizeof(YADRawPlanes));
+        rawPlanes->num_planes = planes.num_planes;
+        for (int i = 0; i < planes.num_planes; i++) {
+            rawPlanes->planes[i] = (void *)planes.planes[i];
+            rawPlanes->strides[i] = planes.strides[i];
+        }
+    }
+    rawPlanes->crop = {left, top, right - left, bottom - top};
+    
+    roiImage->format = planes.format;
+    roiImage->type = YAD_DATA_TYPE_RAW_PLANES;
+    roiImage->data = rawPlanes;
+    roiImage->width = detectImage->width;
+    roiImage->height = detectImage->height;
+    roiImage->stride = planes.strides[0];
+    return true;
+}
+
+}; // namespace yad
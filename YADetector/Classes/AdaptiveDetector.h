@@ -0,0 +1,85 @@
+//
+//  AdaptiveDetector.h
+//  YAD
+//
+
+#ifndef YAD_ADAPTIVE_DETECTOR_H
+#define YAD_ADAPTIVE_DETECTOR_H
+
+#include "YADetector.h"
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+
+namespace yad {
+
+class ModuleDetector;
+
+#define YAD_BUDGET_LEVEL_COUNT          5
+#define YAD_BUDGET_SETTLE_FRAMES        3   // 降级后至少观察的帧数，避免一次抖动连续降级
+#define YAD_BUDGET_RECOVER_FRAMES       30  // 连续有余量的帧数达到该值时恢复一级
+#define YAD_BUDGET_FULL_SCAN_INTERVAL   10  // ROI模式下每隔多少帧做一次全图检测，发现新的人脸
+
+// 耗时预算统计
+typedef struct BudgetStats {
+    uint64_t frames;            // 检测的帧数
+    uint64_t missed;            // 超出预算的帧数
+    uint64_t roi_frames;        // 只检测ROI的帧数
+    int level;                  // 当前降级等级，0为最高质量
+    int64_t latency_avg_us;     // 检测耗时的滑动平均
+} BudgetStats;
+
+// 耗时预算Detector。kYADFrameBudgetUs大于0时创建，根据最近的检测耗时调整质量:
+//   等级  检测分辨率  检测区域                 最多人脸
+//   0     1.0        全图                     不限
+//   1     1.0        上一帧人脸附近(ROI)       不限
+//   2     0.75       ROI                      不限
+//   3     0.5        ROI                      4
+//   4     0.5        ROI                      1
+// 耗时的滑动平均接近预算或单帧超出预算时降一级，持续有余量时恢复一级。
+// ROI通过YAD_DATA_TYPE_RAW_PLANES的crop实现，插件不支持时自动改为全图。
+// 检测分辨率通过插件的setQuality(ABI v3)设置，不超过kYADDetectScale；人脸数由框架裁剪，不依赖插件支持
+class AdaptiveDetector : public Detector {
+public:
+    // module为detector链中插件的detector，用于设置检测质量，为空时只使用ROI和裁剪人脸数
+    AdaptiveDetector(Detector *detector, YADConfig &config, ModuleDetector *module);
+    virtual ~AdaptiveDetector();
+    
+    int initCheck() const override;
+    int detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo) override;
+    int detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults) override;
+    YADLandmarkProfile getLandmarkProfile() const override;
+    
+    BudgetStats getStats();
+    
+private:
+    AdaptiveDetector(const AdaptiveDetector &);
+    AdaptiveDetector &operator=(const AdaptiveDetector &);
+    
+    // 在调用者图像上裁剪出ROI，结果坐标仍相对整幅图像，ROI过大或格式不支持时返回false
+    bool makeRoiImage(const YADDetectImage *detectImage, const YADRecti &roi, YADDetectImage *roiImage,
+                      YADRawPlanes *rawPlanes);
+    void updateLevel(int64_t latencyUs);
+    void updateRoi(const YADFaceResults *faceResults, int width, int height);
+    
+    std::unique_ptr<Detector> detector_;
+    ModuleDetector *module_;    // 属于detector_，生命周期相同
+    int budget_us_;
+    float detect_scale_;        // 调用者配置的检测分辨率，各等级不超过它
+    std::mutex mutex_;
+    int level_;
+    int quality_level_;         // 已经设置给插件的等级，-1表示还没有设置
+    int settle_frames_;
+    int headroom_frames_;
+    int scan_frames_;       // 距离上次全图检测的帧数
+    bool latency_valid_;    // 等级变化后耗时重新统计
+    bool roi_valid_;
+    bool roi_supported_;
+    YADRecti roi_;          // 整幅图像坐标
+    BudgetStats stats_;
+};
+
+}; // namespace yad
+
+#endif /* YAD_ADAPTIVE_DETECTOR_H */
@@ -0,0 +1,242 @@
+//
+//  ChangeNotifier.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADChange"
+#include "LogMacros.h"
+
+#include "ChangeNotifier.h"
+#include "LandmarkProfile.h"
+#include "Simd.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace yad {
+
+// a、b为x、y交错的count个点，任一点的距离平方超过limit2时返回true
+static bool exceedsDistance(const float *a, const float *b, int count, float limit2)
+{
+    int i = 0;
+#if defined(YAD_SIMD_SSE2)
+    // 一次比较两个点，x、y的平方与交换后的自身相加得到每个点的距离平方，比较结果累计后最后判断一次
+    __m128 limit = _mm_set1_ps(limit2);
+    __m128 mask = _mm_setzero_ps();
+    for (; i + 2 <= count; i += 2) {
+        __m128 diff = _mm_sub_ps(_mm_loadu_ps(a + i * 2), _mm_loadu_ps(b + i * 2));
+        __m128 square = _mm_mul_ps(diff, diff);
+        __m128 dist2 = _mm_add_ps(square, _mm_shuffle_ps(square, square, _MM_SHUFFLE(2, 3, 0, 1)));
+        mask = _mm_or_ps(mask, _mm_cmpgt_ps(dist2, limit));
+    }
+    if (_mm_movemask_ps(mask)) {
+        return true;
+    }
+#elif defined(YAD_SIMD_NEON)
+    float32x4_t limit = vdupq_n_f32(limit2);
+    uint32x4_t mask = vdupq_n_u32(0);
+    for (; i + 2 <= count; i += 2) {
+        float32x4_t diff = vsubq_f32(vld1q_f32(a + i * 2), vld1q_f32(b + i * 2));
+        float32x4_t square = vmulq_f32(diff, diff);
+        float32x4_t dist2 = vaddq_f32(square, vrev64q_f32(square));
+        mask = vorrq_u32(mask, vcgtq_f32(dist2, limit));
+    }
+    uint32x2_t half = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+    if (vget_lane_u32(half, 0) | vget_lane_u32(half, 1)) {
+        return true;
+    }
+#endif
+    for (; i < count; i++) {
+        float dx = a[i * 2] - b[i * 2];
+        float dy = a[i * 2 + 1] - b[i * 2 + 1];
+        if (dx * dx + dy * dy > limit2) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ChangeNotifier::ChangeNotifier(const ChangeCallback &callback, YADLandmarkProfile profile) :
+    callback_(callback),
+    profile_(isValidLandmarkProfile(profile) ? profile : YAD_LANDMARK_PROFILE_106),
+    indices_(getLandmarkIndices(profile_)),
+    num_points_(profile_ + 2),
+    default_thresholds_({YAD_CHANGE_DEFAULT_LANDMARK_PX, YAD_CHANGE_DEFAULT_POSE_DEG}),
+    frame_(0)
+{
+    memset(&stats_, 0, sizeof(stats_));
+    YLOGV("ctor, profile: %d", profile_);
+}
+
+// 配置无效时Detector::Create会失败，这里退回106点
+static YADLandmarkProfile getNotifierProfile(YADConfig &config)
+{
+    YADLandmarkProfile profile;
+    if (getConfigLandmarkProfile(config, &profile) != YAD_OK) {
+        profile = YAD_LANDMARK_PROFILE_106;
+    }
+    return profile;
+}
+
+ChangeNotifier::ChangeNotifier(const ChangeCallback &callback, YADConfig &config) :
+    ChangeNotifier(callback, getNotifierProfile(config))
+{
+}
+
+ChangeNotifier::~ChangeNotifier()
+{
+    YLOGI("notified %llu of %llu frames", (unsigned long long)stats_.notified, (unsigned long long)stats_.frames);
+}
+
+void ChangeNotifier::setDefaultThresholds(const ChangeThresholds &thresholds)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    default_thresholds_ = thresholds;
+}
+
+void ChangeNotifier::setThresholds(int trackId, const ChangeThresholds &thresholds)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    thresholds_[trackId] = thresholds;
+}
+
+void ChangeNotifier::clearThresholds(int trackId)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    thresholds_.erase(trackId);
+}
+
+ChangeNotifierStats ChangeNotifier::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void ChangeNotifier::reset()
+{
+    tracks_.clear();
+}
+
+void ChangeNotifier::gatherPoints(const YADFaceInfo &face, YADPoint2f *points) const
+{
+    if (indices_) {
+        for (int i = 0; i < profile_; i++) {
+            points[i] = face.landmarks[indices_[i]];
+        }
+    } else {
+        memcpy(points, face.landmarks, sizeof(YADPoint2f) * YAD_FACE_LANDMARK_NUM);
+    }
+    points[profile_].x = face.rect.x;
+    points[profile_].y = face.rect.y;
+    points[profile_ + 1].x = face.rect.x + face.rect.w;
+    points[profile_ + 1].y = face.rect.y + face.rect.h;
+}
+
+void ChangeNotifier::saveTrack(const YADFaceInfo &face, const YADPoint2f *points, Track *track) const
+{
+    track->points.assign(points, points + num_points_);
+    track->yaw = face.yaw;
+    track->pitch = face.pitch;
+    track->roll = face.roll;
+}
+
+int ChangeNotifier::update(const YADFaceResults *results)
+{
+    if (!results || results->num_faces < 0 || (results->num_faces > 0 && !results->faces)) {
+        return YAD_BAD_VALUE;
+    }
+    
+    frame_++;
+    changes_.clear();
+    points_.resize(num_points_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int i = 0; i < results->num_faces; i++) {
+            const YADFaceInfo &face = results->faces[i];
+            gatherPoints(face, points_.data());
+            
+            auto it = tracks_.find(face.track_id);
+            if (it == tracks_.end()) {
+                Track &track = tracks_[face.track_id];
+                saveTrack(face, points_.data(), &track);
+                track.frame = frame_;
+                changes_.push_back({YAD_FACE_APPEARED, face.track_id, i});
+                continue;
+            }
+            
+            Track &track = it->second;
+            track.frame = frame_;
+            auto thresholdsIt = thresholds_.find(face.track_id);
+            const ChangeThresholds &thresholds =
+                thresholdsIt != thresholds_.end() ? thresholdsIt->second : default_thresholds_;
+            bool moved = false;
+            if (thresholds.pose_deg > 0.0f) {
+                moved = fabsf(face.yaw - track.yaw) > thresholds.pose_deg ||
+                        fabsf(face.pitch - track.pitch) > thresholds.pose_deg ||
+                        fabsf(face.roll - track.roll) > thresholds.pose_deg;
+            }
+            if (!moved && thresholds.landmark_px > 0.0f) {
+                moved = exceedsDistance((const float *)points_.data(), (const float *)track.points.data(), num_points_,
+                                        thresholds.landmark_px * thresholds.landmark_px);
+            }
+            // 只在通知时更新比较基准，低于阈值的变化累计起来
+            if (moved) {
+                saveTrack(face, points_.data(), &track);
+                changes_.push_back({YAD_FACE_MOVED, face.track_id, i});
+            }
+        }
+        
+        // 本帧没有出现的人脸已消失，单独设置的阈值随之清除
+        for (auto it = tracks_.begin(); it != tracks_.end();) {
+            if (it->second.frame != frame_) {
+                changes_.push_back({YAD_FACE_DISAPPEARED, it->first, -1});
+                thresholds_.erase(it->first);
+                it = tracks_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        
+        stats_.frames++;
+        if (!changes_.empty()) {
+            stats_.notified++;
+        }
+    }
+    
+    if (!changes_.empty() && callback_) {
+        callback_(changes_.data(), (int)changes_.size(), results);
+    }
+    return (int)changes_.size();
+}
+
+int ChangeNotifier::update(YADFeatureInfo *featureInfo)
+{
+    if (!featureInfo) {
+        return YAD_BAD_VALUE;
+    }
+    
+    YADFaceResults faceResults = makeFaceResults(featureInfo);
+    faceResults.num_faces = featureInfo->num_faces;
+    return update(&faceResults);
+}
+
+int ChangeNotifier::detect(Detector *detector, YADDetectImage *detectImage, YADDetectInfo *detectInfo,
+                           YADFaceResults *results)
+{
+    if (!detector) {
+        return YAD_BAD_VALUE;
+    }
+    if (profile_ > detector->getLandmarkProfile()) {
+        YLOGE("profile %d exceeds the detector's profile %d", profile_, detector->getLandmarkProfile());
+        return YAD_BAD_VALUE;
+    }
+    
+    int err = detector->detectFaces(detectImage, detectInfo, results);
+    if (err != YAD_OK) {
+        return err;
+    }
+    return update(results);
+}
+
+}; // namespace yad
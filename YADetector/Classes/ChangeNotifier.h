@@ -0,0 +1,110 @@
+//
+//  ChangeNotifier.h
+//  YAD
+//
+
+#ifndef YAD_CHANGE_NOTIFIER_H
+#define YAD_CHANGE_NOTIFIER_H
+
+#include "YADetector.h"
+
+#include <stdint.h>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace yad {
+
+#define YAD_CHANGE_DEFAULT_LANDMARK_PX  2.0f    // 默认关键点移动阈值(像素)
+#define YAD_CHANGE_DEFAULT_POSE_DEG     2.0f    // 默认姿态变化阈值(度)
+
+// 变化阈值，与上次通知时的结果比较，而不是与上一帧比较，缓慢的漂移累计超过阈值后也会通知
+typedef struct ChangeThresholds {
+    float landmark_px;  // 任一关键点或人脸框角点移动的距离超过时通知，小于等于0时不比较
+    float pose_deg;     // yaw、pitch、roll任一变化超过时通知，小于等于0时不比较
+} ChangeThresholds;
+
+typedef enum FaceChangeType {
+    YAD_FACE_APPEARED,      // 新出现的track_id
+    YAD_FACE_MOVED,         // 关键点或姿态变化超过阈值
+    YAD_FACE_DISAPPEARED,   // 上一帧存在、本帧没有的track_id
+} FaceChangeType;
+
+typedef struct FaceChange {
+    FaceChangeType type;
+    int track_id;
+    int index;          // 在本帧结果中的下标，消失时为-1
+} FaceChange;
+
+// 一帧中所有的变化，只在有变化的帧回调。changes和results只在回调内有效
+typedef std::function<void(const FaceChange *changes, int numChanges, const YADFaceResults *results)> ChangeCallback;
+
+// 变化通知统计
+typedef struct ChangeNotifierStats {
+    uint64_t frames;        // 比较的帧数
+    uint64_t notified;      // 有变化、调用了回调的帧数
+} ChangeNotifierStats;
+
+// 事件驱动的结果输出。每帧按track_id与上次通知时的结果比较，只在人脸出现、消失，
+// 或者关键点、姿态变化超过阈值时回调，画面平稳时下游的网格拟合、特效更新等可以不做任何工作。
+// 关键点比较用SIMD一次处理两个点，只比较profile指定的子集，其它点的值可能不确定。
+// update由检测线程调用，阈值可以在其它线程设置；回调在update的线程中、不持有内部锁时执行。
+class ChangeNotifier {
+public:
+    explicit ChangeNotifier(const ChangeCallback &callback, YADLandmarkProfile profile = YAD_LANDMARK_PROFILE_106);
+    // 子集取自创建Detector的配置(kYADLandmarkProfile)，与Detector一致
+    ChangeNotifier(const ChangeCallback &callback, YADConfig &config);
+    ~ChangeNotifier();
+    
+    // 没有单独设置阈值的人脸使用的阈值
+    void setDefaultThresholds(const ChangeThresholds &thresholds);
+    // 单个人脸的阈值，该人脸消失时自动清除
+    void setThresholds(int trackId, const ChangeThresholds &thresholds);
+    void clearThresholds(int trackId);
+    
+    // 比较一帧结果，有变化时回调，返回变化个数
+    int update(const YADFaceResults *results);
+    int update(YADFeatureInfo *featureInfo);
+    // 检测一帧再比较，成功时返回变化个数，检测失败时不比较也不回调。
+    // 子集多于detector创建时的kYADLandmarkProfile时返回YAD_BAD_VALUE，否则会比较插件没有计算的点
+    int detect(Detector *detector, YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *results);
+    // 清空比较状态，下一帧的所有人脸都作为新出现的人脸通知，与update在同一线程调用
+    void reset();
+    ChangeNotifierStats getStats();
+    
+private:
+    // 上次通知时的人脸，points为关键点子集加人脸框左上、右下两个角点
+    struct Track {
+        std::vector<YADPoint2f> points;
+        float yaw;
+        float pitch;
+        float roll;
+        uint64_t frame;     // 最近一次出现的帧号
+    };
+    
+    ChangeNotifier(const ChangeNotifier &);
+    ChangeNotifier &operator=(const ChangeNotifier &);
+    
+    // 把人脸的关键点子集和人脸框角点拷贝为连续的点
+    void gatherPoints(const YADFaceInfo &face, YADPoint2f *points) const;
+    void saveTrack(const YADFaceInfo &face, const YADPoint2f *points, Track *track) const;
+    
+    ChangeCallback callback_;
+    YADLandmarkProfile profile_;
+    const uint8_t *indices_;    // 子集在106点中的下标，nullptr表示全部
+    int num_points_;
+    std::mutex mutex_;          // 保护阈值和统计
+    ChangeThresholds default_thresholds_;
+    std::unordered_map<int, ChangeThresholds> thresholds_;
+    ChangeNotifierStats stats_;
+    // 以下只由update的线程访问
+    uint64_t frame_;
+    std::unordered_map<int, Track> tracks_;
+    std::vector<YADPoint2f> points_;
+    std::vector<FaceChange> changes_;
+};
+
+}; // namespace yad
+
+#endif /* YAD_CHANGE_NOTIFIER_H */
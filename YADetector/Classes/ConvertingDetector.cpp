@@ -0,0 +1,114 @@
+//
+//  ConvertingDetector.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADConvert"
+#include "LogMacros.h"
+
+#include "ConvertingDetector.h"
+#include "FramePool.h"
+#include "ImagePreprocess.h"
+#include "ImageUtils.h"
+#include "WorkerPool.h"
+
+namespace yad {
+
+ConvertingDetector::ConvertingDetector(Detector *detector, const ConversionPlan &plan,
+                                       const std::shared_ptr<WorkerPool> &pool) :
+    detector_(detector),
+    plan_(plan),
+    pool_(pool)
+{
+    YLOGV("ctor, format: %d types: 0x%x rotations: 0x%x threads: %d", plan_.format, plan_.data_types, plan_.rotations,
+          pool_ ? pool_->getThreadCount() : 1);
+}
+
+ConvertingDetector::~ConvertingDetector()
+{
+    YLOGV("dtor");
+}
+
+int ConvertingDetector::initCheck() const
+{
+    return detector_ ? detector_->initCheck() : YAD_NO_INIT;
+}
+
+YADLandmarkProfile ConvertingDetector::getLandmarkProfile() const
+{
+    return detector_ ? detector_->getLandmarkProfile() : YAD_LANDMARK_PROFILE_106;
+}
+
+int ConvertingDetector::detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo)
+{
+    if (!featureInfo) {
+        return YAD_BAD_VALUE;
+    }
+    
+    YADFaceResults faceResults = makeFaceResults(featureInfo);
+    int ret = detectFaces(detectImage, detectInfo, &faceResults);
+    featureInfo->num_faces = faceResults.num_faces;
+    return ret;
+}
+
+int ConvertingDetector::detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults)
+{
+    if (!detector_) {
+        return YAD_NO_INIT;
+    }
+    if (!detectImage || !detectInfo || !faceResults) {
+        return YAD_BAD_VALUE;
+    }
+    
+    YADRotateMode rotateMode = detectInfo->rotate_mode;
+    bool rotate = rotateMode != YAD_ROTATE_0 && (plan_.rotations & YAD_PLUGIN_CAP_ROTATE(rotateMode)) == 0;
+    bool convert = detectImage->format != plan_.format;
+    bool pack = (plan_.data_types & YAD_PLUGIN_CAP_TYPE(detectImage->type)) == 0;
+    if (!rotate && !convert && !pack) {
+        return detector_->detectFaces(detectImage, detectInfo, faceResults);
+    }
+    
+    ImagePlanes planes;
+    int err = getImagePlanes(detectImage, &planes);
+    if (err != YAD_OK) {
+        return err;
+    }
+    
+    // 转换、拼接和旋转在一次遍历中完成，不生成中间整帧。YUV的色度平面无法按像素旋转
+    if (convert && plan_.format != YAD_PIX_FMT_RGB888) {
+        return YAD_FORMAT_UNSUPPORTED;
+    }
+    if (rotate && isYUV420(plan_.format)) {
+        return YAD_ROTATE_UNSUPPORTED;
+    }
+    YADRotateMode uprightMode = rotate ? rotateMode : YAD_ROTATE_0;
+    bool swap = uprightMode == YAD_ROTATE_90 || uprightMode == YAD_ROTATE_270;
+    FrameBuffer converted;
+    err = FramePool::getDefault().acquire(plan_.format, swap ? planes.height : planes.width,
+                                          swap ? planes.width : planes.height, &converted);
+    if (err != YAD_OK) {
+        return err;
+    }
+    YADDetectImage image = converted.getImage();
+    err = convertToUpright(planes, plan_.format, uprightMode, converted.data(), image.stride, pool_.get());
+    if (err != YAD_OK) {
+        return err;
+    }
+    
+    YADDetectInfo info = *detectInfo;
+    if (rotate) {
+        info.rotate_mode = YAD_ROTATE_0;
+    }
+    
+    err = detector_->detectFaces(&image, &info, faceResults);
+    if (err == YAD_OK) {
+        if (rotate) {
+            mapFaceResultsToSource(faceResults, rotateMode, image.width, image.height);
+        }
+        offsetFaceResults(faceResults, planes.crop_x, planes.crop_y);
+    }
+    return err;
+}
+
+}; // namespace yad
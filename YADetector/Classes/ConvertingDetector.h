@@ -0,0 +1,50 @@
+//
+//  ConvertingDetector.h
+//  YAD
+//
+
+#ifndef YAD_CONVERTING_DETECTOR_H
+#define YAD_CONVERTING_DETECTOR_H
+
+#include "YADetector.h"
+
+#include <stdint.h>
+#include <memory>
+
+namespace yad {
+
+class WorkerPool;
+
+// 预处理方案，由PluginManager根据插件能力选出
+typedef struct ConversionPlan {
+    YADPixelFormat format;  // 送入插件的格式，与输入不同时转换，目前只支持转换为RGB888
+    uint32_t data_types;    // 插件原生支持的数据类型，其它类型拼接为连续内存(YAD_DATA_TYPE_RAW)
+    uint32_t rotations;     // 插件原生支持的旋转，其它旋转先把图像旋转为正向
+} ConversionPlan;
+
+// 按ConversionPlan把帧转换为插件原生支持的形式再检测，结果坐标映射回调用者的图像。
+// 已经是插件原生支持的帧直接透传。转换和旋转按行分块在一次遍历中完成，pool不为空时各块并行。
+// 输出缓冲区每帧从FramePool::getDefault()借出，检测完成后归还，多个Detector共享，转换路径上的调用不需要串行
+class ConvertingDetector : public Detector {
+public:
+    ConvertingDetector(Detector *detector, const ConversionPlan &plan,
+                       const std::shared_ptr<WorkerPool> &pool = std::shared_ptr<WorkerPool>());
+    virtual ~ConvertingDetector();
+    
+    int initCheck() const override;
+    int detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo) override;
+    int detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults) override;
+    YADLandmarkProfile getLandmarkProfile() const override;
+    
+private:
+    ConvertingDetector(const ConvertingDetector &);
+    ConvertingDetector &operator=(const ConvertingDetector &);
+    
+    std::unique_ptr<Detector> detector_;
+    ConversionPlan plan_;
+    std::shared_ptr<WorkerPool> pool_;
+};
+
+}; // namespace yad
+
+#endif /* YAD_CONVERTING_DETECTOR_H */
@@ -0,0 +1,226 @@
+//
+//  CpuAffinity.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADAffinity"
+#include "LogMacros.h"
+
+#include "CpuAffinity.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <sched.h>
+#define YAD_CPU_LIST_MAX            CPU_SETSIZE
+#else
+#define YAD_CPU_LIST_MAX            1024
+#endif
+
+#define YAD_CPU_SYSFS_PATH          "/sys/devices/system/cpu"
+#define YAD_CPU_PERFORMANCE_RATIO   0.75
+
+namespace yad {
+
+// 读取sysfs中的一行，失败返回空
+static std::string readLine(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "r");
+    if (!fp) {
+        return std::string();
+    }
+    char buf[256];
+    std::string line;
+    if (fgets(buf, sizeof(buf), fp)) {
+        line = buf;
+    }
+    fclose(fp);
+    while (!line.empty() && (line.back() == '\n' || line.back() == ' ')) {
+        line.pop_back();
+    }
+    return line;
+}
+
+static long readNumber(const std::string &path)
+{
+    std::string line = readLine(path);
+    return line.empty() ? 0 : strtol(line.c_str(), nullptr, 10);
+}
+
+int parseCpuList(const std::string &list, std::vector<int> *cpus)
+{
+    if (!cpus) {
+        return YAD_BAD_VALUE;
+    }
+    
+    cpus->clear();
+    const char *p = list.c_str();
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        // 编号不能超过cpu_set_t的范围，也避免超大的区间展开成海量元素
+        if (end == p || first < 0 || first >= YAD_CPU_LIST_MAX) {
+            return YAD_BAD_VALUE;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first || last >= YAD_CPU_LIST_MAX) {
+                return YAD_BAD_VALUE;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            cpus->push_back((int)cpu);
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p) {
+            return YAD_BAD_VALUE;
+        }
+    }
+    
+    std::sort(cpus->begin(), cpus->end());
+    cpus->erase(std::unique(cpus->begin(), cpus->end()), cpus->end());
+    return cpus->empty() ? YAD_BAD_VALUE : YAD_OK;
+}
+
+std::string formatCpuList(const std::vector<int> &cpus)
+{
+    std::string list;
+    size_t i = 0;
+    while (i < cpus.size()) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            j++;
+        }
+        if (!list.empty()) {
+            list += ",";
+        }
+        list += std::to_string(cpus[i]);
+        if (j > i) {
+            list += "-" + std::to_string(cpus[j]);
+        }
+        i = j + 1;
+    }
+    return list;
+}
+
+std::vector<int> getOnlineCpus()
+{
+    std::vector<int> cpus;
+    parseCpuList(readLine(YAD_CPU_SYSFS_PATH "/online"), &cpus);
+    return cpus;
+}
+
+std::vector<int> getPerformanceCpus()
+{
+    std::vector<int> cpus = getOnlineCpus();
+    
+    // cpu_capacity由设备树给出，已经考虑了微架构差异；老内核没有时退化为最高频率
+    std::vector<long> capacities;
+    static const char *const kCapacityFiles[] = {"/cpu_capacity", "/cpufreq/cpuinfo_max_freq"};
+    for (const char *file : kCapacityFiles) {
+        capacities.clear();
+        for (int cpu : cpus) {
+            long capacity = readNumber(YAD_CPU_SYSFS_PATH "/cpu" + std::to_string(cpu) + file);
+            if (capacity <= 0) {
+                break;
+            }
+            capacities.push_back(capacity);
+        }
+        if (!cpus.empty() && capacities.size() == cpus.size()) {
+            break;
+        }
+    }
+    if (cpus.empty() || capacities.size() != cpus.size()) {
+        return cpus;
+    }
+    
+    long maxCapacity = *std::max_element(capacities.begin(), capacities.end());
+    std::vector<int> performance;
+    for (size_t i = 0; i < cpus.size(); i++) {
+        if (capacities[i] >= maxCapacity * YAD_CPU_PERFORMANCE_RATIO) {
+            performance.push_back(cpus[i]);
+        }
+    }
+    YLOGV("performance cpus: %s", formatCpuList(performance).c_str());
+    return performance;
+}
+
+int getConfigCpus(YADConfig &config, const char *key, std::vector<int> *cpus)
+{
+    if (!cpus) {
+        return YAD_BAD_VALUE;
+    }
+    
+    cpus->clear();
+    auto it = config.find(key);
+    if (it == config.end() || it->second.empty()) {
+        return YAD_OK;
+    }
+    if (it->second == YAD_CPU_AFFINITY_BIG) {
+        *cpus = getPerformanceCpus();
+        return YAD_OK;
+    }
+    int err = parseCpuList(it->second, cpus);
+    if (err != YAD_OK) {
+        YLOGE("invalid cpu list, %s: %s", key, it->second.c_str());
+    }
+    return err;
+}
+
+int setThreadAffinity(const std::vector<int> &cpus)
+{
+    if (cpus.empty()) {
+        return YAD_OK;
+    }
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        YLOGE("sched_setaffinity() failed, cpus: %s errno: %d", formatCpuList(cpus).c_str(), errno);
+        return errno == EPERM ? YAD_PERMISSION_DENIED : YAD_BAD_VALUE;
+    }
+    return YAD_OK;
+#else
+    return YAD_INVALID_OPERATION;
+#endif
+}
+
+int getThreadAffinity(std::vector<int> *cpus)
+{
+    if (!cpus) {
+        return YAD_BAD_VALUE;
+    }
+    
+    cpus->clear();
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        YLOGE("sched_getaffinity() failed, errno: %d", errno);
+        return YAD_UNKNOWN_ERROR;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus->push_back(cpu);
+        }
+    }
+    return YAD_OK;
+#else
+    return YAD_INVALID_OPERATION;
+#endif
+}
+
+}; // namespace yad
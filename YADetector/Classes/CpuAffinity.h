@@ -0,0 +1,36 @@
+//
+//  CpuAffinity.h
+//  YAD
+//
+
+#ifndef YAD_CPU_AFFINITY_H
+#define YAD_CPU_AFFINITY_H
+
+#include "YADetector.h"
+
+#include <string>
+#include <vector>
+
+namespace yad {
+
+#define YAD_CPU_AFFINITY_BIG    "big"   // kYADCpuAffinity的取值，自动选择性能核
+
+// 解析CPU列表，格式同/sys/devices/system/cpu/online，如"0-3,6"，结果升序去重。编号超出cpu_set_t的范围(Linux上不小于CPU_SETSIZE)时返回YAD_BAD_VALUE
+int parseCpuList(const std::string &list, std::vector<int> *cpus);
+// 格式化为CPU列表字符串，用于日志和比较
+std::string formatCpuList(const std::vector<int> &cpus);
+// 在线的CPU，无法获取时返回空
+std::vector<int> getOnlineCpus();
+// 性能核(大核)。按/sys/devices/system/cpu/cpuN/cpu_capacity判断，没有时按cpufreq的最高频率，
+// 算力不低于最强核3/4的核都算作性能核。各核相同或无法获取时返回全部在线的CPU
+std::vector<int> getPerformanceCpus();
+// 解析配置中的CPU集合，值为YAD_CPU_AFFINITY_BIG或CPU列表，没有配置时cpus为空
+int getConfigCpus(YADConfig &config, const char *key, std::vector<int> *cpus);
+// 把调用线程绑定到cpus，cpus为空时不做任何事。新建的线程继承创建者的绑定。仅Linux支持
+int setThreadAffinity(const std::vector<int> &cpus);
+// 调用线程当前允许运行的CPU，用于临时修改绑定后恢复。仅Linux支持
+int getThreadAffinity(std::vector<int> *cpus);
+
+}; // namespace yad
+
+#endif /* YAD_CPU_AFFINITY_H */
@@ -0,0 +1,350 @@
+//
+//  FaceAligner.cpp
+//  YAD
+//
+
+#include "FaceAligner.h"
+#include "ImageUtils.h"
+#include "LandmarkProfile.h"
+#include "Simd.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#define YAD_ALIGN_FRAC_BITS     7                               // 采样坐标的小数位数，双线性权重之积不超过int16
+#define YAD_ALIGN_FRAC_ONE      (1 << YAD_ALIGN_FRAC_BITS)
+#define YAD_ALIGN_WEIGHT_SHIFT  (YAD_ALIGN_FRAC_BITS * 2)
+#define YAD_ALIGN_COORD_BIAS    4096.0f                         // 转换为整数前加上偏移，使截断等价于向下取整
+#define YAD_ALIGN_COORD_MAX     65536.0f
+
+namespace yad {
+
+// ArcFace的5点模板，112x112，顺序同kLandmarkIndices5
+static const YADPoint2f kAlignTemplate[5] = {
+    {38.2946f, 51.6963f},
+    {73.5318f, 51.5014f},
+    {56.0252f, 71.7366f},
+    {41.5493f, 92.3655f},
+    {70.7299f, 92.2041f},
+};
+
+size_t getFaceChipBytes(int chipSize)
+{
+    return (size_t)chipSize * chipSize * 3;
+}
+
+int getFaceChipTransform(const YADFaceInfo &face, int chipSize, float matrix[6])
+{
+    if (!matrix || chipSize < YAD_FACE_CHIP_MIN_SIZE || chipSize > YAD_FACE_CHIP_MAX_SIZE) {
+        return YAD_BAD_VALUE;
+    }
+    
+    // 最小二乘求原图到模板的相似变换 x' = a * x - b * y + tx，y' = b * x + a * y + ty
+    float scale = (float)chipSize / YAD_FACE_CHIP_BASE_SIZE;
+    float srcX = 0.0f, srcY = 0.0f, dstX = 0.0f, dstY = 0.0f;
+    for (int i = 0; i < 5; i++) {
+        srcX += face.landmarks[kLandmarkIndices5[i]].x;
+        srcY += face.landmarks[kLandmarkIndices5[i]].y;
+        dstX += kAlignTemplate[i].x * scale;
+        dstY += kAlignTemplate[i].y * scale;
+    }
+    srcX /= 5;
+    srcY /= 5;
+    dstX /= 5;
+    dstY /= 5;
+    
+    float dot = 0.0f, cross = 0.0f, norm = 0.0f;
+    for (int i = 0; i < 5; i++) {
+        float px = face.landmarks[kLandmarkIndices5[i]].x - srcX;
+        float py = face.landmarks[kLandmarkIndices5[i]].y - srcY;
+        float qx = kAlignTemplate[i].x * scale - dstX;
+        float qy = kAlignTemplate[i].y * scale - dstY;
+        dot += px * qx + py * qy;
+        cross += px * qy - py * qx;
+        norm += px * px + py * py;
+    }
+    if (norm < 1e-3f) {
+        return YAD_BAD_VALUE;
+    }
+    float a = dot / norm;
+    float b = cross / norm;
+    float tx = dstX - (a * srcX - b * srcY);
+    float ty = dstY - (b * srcX + a * srcY);
+    
+    // 采样需要chip到原图的反变换
+    float det = a * a + b * b;
+    if (det < 1e-8f) {
+        return YAD_BAD_VALUE;
+    }
+    matrix[0] = a / det;
+    matrix[1] = b / det;
+    matrix[2] = -(a * tx + b * ty) / det;
+    matrix[3] = -b / det;
+    matrix[4] = a / det;
+    matrix[5] = (b * tx - a * ty) / det;
+    return YAD_OK;
+}
+
+// 一行chip像素在原图中的定点坐标
+static void computeRowCoords(const float m[6], int v, int size, int *xs, int *ys)
+{
+    float rowX = m[1] * v + m[2];
+    float rowY = m[4] * v + m[5];
+    int u = 0;
+#if defined(YAD_SIMD_SSE2)
+    __m128 step = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 m0 = _mm_set1_ps(m[0]);
+    __m128 m3 = _mm_set1_ps(m[3]);
+    __m128 baseX = _mm_set1_ps(rowX + YAD_ALIGN_COORD_BIAS);
+    __m128 baseY = _mm_set1_ps(rowY + YAD_ALIGN_COORD_BIAS);
+    __m128 lower = _mm_setzero_ps();
+    __m128 upper = _mm_set1_ps(YAD_ALIGN_COORD_MAX);
+    __m128 one = _mm_set1_ps((float)YAD_ALIGN_FRAC_ONE);
+    __m128i bias = _mm_set1_epi32((int)YAD_ALIGN_COORD_BIAS * YAD_ALIGN_FRAC_ONE);
+    for (; u + 4 <= size; u += 4) {
+        __m128 index = _mm_add_ps(_mm_set1_ps((float)u), step);
+        __m128 x = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(index, m0), baseX), lower), upper);
+        __m128 y = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(index, m3), baseY), lower), upper);
+        _mm_storeu_si128((__m128i *)(xs + u), _mm_sub_epi32(_mm_cvttps_epi32(_mm_mul_ps(x, one)), bias));
+        _mm_storeu_si128((__m128i *)(ys + u), _mm_sub_epi32(_mm_cvttps_epi32(_mm_mul_ps(y, one)), bias));
+    }
+#elif defined(YAD_SIMD_NEON)
+    static const float kStep[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+    float32x4_t step = vld1q_f32(kStep);
+    float32x4_t baseX = vdupq_n_f32(rowX + YAD_ALIGN_COORD_BIAS);
+    float32x4_t baseY = vdupq_n_f32(rowY + YAD_ALIGN_COORD_BIAS);
+    float32x4_t lower = vdupq_n_f32(0.0f);
+    float32x4_t upper = vdupq_n_f32(YAD_ALIGN_COORD_MAX);
+    int32x4_t bias = vdupq_n_s32((int)YAD_ALIGN_COORD_BIAS * YAD_ALIGN_FRAC_ONE);
+    for (; u + 4 <= size; u += 4) {
+        float32x4_t index = vaddq_f32(vdupq_n_f32((float)u), step);
+        float32x4_t x = vminq_f32(vmaxq_f32(vmlaq_n_f32(baseX, index, m[0]), lower), upper);
+        float32x4_t y = vminq_f32(vmaxq_f32(vmlaq_n_f32(baseY, index, m[3]), lower), upper);
+        vst1q_s32(xs + u, vsubq_s32(vcvtq_s32_f32(vmulq_n_f32(x, (float)YAD_ALIGN_FRAC_ONE)), bias));
+        vst1q_s32(ys + u, vsubq_s32(vcvtq_s32_f32(vmulq_n_f32(y, (float)YAD_ALIGN_FRAC_ONE)), bias));
+    }
+#endif
+    for (; u < size; u++) {
+        float x = std::min(std::max(m[0] * u + rowX + YAD_ALIGN_COORD_BIAS, 0.0f), YAD_ALIGN_COORD_MAX);
+        float y = std::min(std::max(m[3] * u + rowY + YAD_ALIGN_COORD_BIAS, 0.0f), YAD_ALIGN_COORD_MAX);
+        xs[u] = (int)(x * YAD_ALIGN_FRAC_ONE) - (int)YAD_ALIGN_COORD_BIAS * YAD_ALIGN_FRAC_ONE;
+        ys[u] = (int)(y * YAD_ALIGN_FRAC_ONE) - (int)YAD_ALIGN_COORD_BIAS * YAD_ALIGN_FRAC_ONE;
+    }
+}
+
+// quad为左上、右上、左下、右下四个像素，每个4字节，按权重插值后写入out的前3个通道
+static inline void blendQuad(const uint8_t *quad, int fx, int fy, uint8_t *out)
+{
+    int w00 = (YAD_ALIGN_FRAC_ONE - fx) * (YAD_ALIGN_FRAC_ONE - fy);
+    int w01 = fx * (YAD_ALIGN_FRAC_ONE - fy);
+    int w10 = (YAD_ALIGN_FRAC_ONE - fx) * fy;
+    int w11 = fx * fy;
+#if defined(YAD_SIMD_SSE2)
+    // 左右两个像素按通道交错后用madd一次完成两项乘加
+    __m128i zero = _mm_setzero_si128();
+    __m128i pixels = _mm_loadu_si128((const __m128i *)quad);
+    __m128i top = _mm_unpacklo_epi8(pixels, zero);
+    __m128i bottom = _mm_unpackhi_epi8(pixels, zero);
+    top = _mm_unpacklo_epi16(top, _mm_srli_si128(top, 8));
+    bottom = _mm_unpacklo_epi16(bottom, _mm_srli_si128(bottom, 8));
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(top, _mm_set1_epi32((w01 << 16) | w00)),
+                                _mm_madd_epi16(bottom, _mm_set1_epi32((w11 << 16) | w10)));
+    sum = _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << (YAD_ALIGN_WEIGHT_SHIFT - 1))), YAD_ALIGN_WEIGHT_SHIFT);
+    sum = _mm_packs_epi32(sum, sum);
+    int packed = _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+    memcpy(out, &packed, 4);
+#elif defined(YAD_SIMD_NEON)
+    // 先水平插值到16位，再垂直插值到32位
+    static const uint8_t kLanes[8] = {0, 0, 0, 0, 1, 1, 1, 1};
+    uint8x8_t select = vld1_u8(kLanes);
+    uint8x8_t weights = vbsl_u8(vceq_u8(select, vdup_n_u8(0)), vdup_n_u8((uint8_t)(YAD_ALIGN_FRAC_ONE - fx)),
+                                vdup_n_u8((uint8_t)fx));
+    uint16x8_t top = vmull_u8(vld1_u8(quad), weights);
+    uint16x8_t bottom = vmull_u8(vld1_u8(quad + 8), weights);
+    uint16x4_t rowTop = vadd_u16(vget_low_u16(top), vget_high_u16(top));
+    uint16x4_t rowBottom = vadd_u16(vget_low_u16(bottom), vget_high_u16(bottom));
+    uint32x4_t sum = vmlal_n_u16(vmull_n_u16(rowTop, (uint16_t)(YAD_ALIGN_FRAC_ONE - fy)), rowBottom, (uint16_t)fy);
+    uint16x4_t narrow = vrshrn_n_u32(sum, YAD_ALIGN_WEIGHT_SHIFT);
+    uint8x8_t bytes = vmovn_u16(vcombine_u16(narrow, narrow));
+    uint32_t packed = vget_lane_u32(vreinterpret_u32_u8(bytes), 0);
+    memcpy(out, &packed, 4);
+#else
+    for (int c = 0; c < 3; c++) {
+        int sum = quad[c] * w00 + quad[4 + c] * w01 + quad[8 + c] * w10 + quad[12 + c] * w11;
+        out[c] = (uint8_t)((sum + (1 << (YAD_ALIGN_WEIGHT_SHIFT - 1))) >> YAD_ALIGN_WEIGHT_SHIFT);
+    }
+#endif
+}
+
+enum {
+    FETCH_PACKED3,      // RGB888/BGR888
+    FETCH_PACKED4,      // RGBA8888/BGRA8888
+    FETCH_YUV420SP,     // NV12/NV21
+    FETCH_I420,
+    FETCH_GENERIC,      // 其它格式逐像素转换为RGB
+};
+
+// 取出2x2的源像素，每个像素4字节。打包格式保持原通道顺序，YUV格式取Y、U、V在YUV域插值，最后只转换一次
+template <int Fetch>
+static inline void fetchQuad(const ImagePlanes &planes, int x0, int x1, int y0, int y1, uint8_t *quad)
+{
+    const uint8_t *row0 = planes.planes[0] + (size_t)y0 * planes.strides[0];
+    const uint8_t *row1 = planes.planes[0] + (size_t)y1 * planes.strides[0];
+    if (Fetch == FETCH_PACKED4) {
+        // 相邻两个像素一次读取，第4个通道不参与输出
+        if (x1 == x0 + 1) {
+            memcpy(quad, row0 + x0 * 4, 8);
+            memcpy(quad + 8, row1 + x0 * 4, 8);
+        } else {
+            memcpy(quad, row0 + x0 * 4, 4);
+            memcpy(quad + 4, row0 + x1 * 4, 4);
+            memcpy(quad + 8, row1 + x0 * 4, 4);
+            memcpy(quad + 12, row1 + x1 * 4, 4);
+        }
+    } else if (Fetch == FETCH_PACKED3) {
+        memcpy(quad, row0 + x0 * 3, 3);
+        memcpy(quad + 4, row0 + x1 * 3, 3);
+        memcpy(quad + 8, row1 + x0 * 3, 3);
+        memcpy(quad + 12, row1 + x1 * 3, 3);
+    } else if (Fetch == FETCH_YUV420SP || Fetch == FETCH_I420) {
+        const int xs[4] = {x0, x1, x0, x1};
+        const uint8_t *rows[4] = {row0, row0, row1, row1};
+        const int chromaRows[4] = {y0 / 2, y0 / 2, y1 / 2, y1 / 2};
+        int uIndex = planes.format == YAD_PIX_FMT_NV21 ? 1 : 0;
+        for (int i = 0; i < 4; i++) {
+            quad[i * 4] = rows[i][xs[i]];
+            if (Fetch == FETCH_YUV420SP) {
+                const uint8_t *chroma = planes.planes[1] + (size_t)chromaRows[i] * planes.strides[1] + (xs[i] / 2) * 2;
+                quad[i * 4 + 1] = chroma[uIndex];
+                quad[i * 4 + 2] = chroma[1 - uIndex];
+            } else {
+                quad[i * 4 + 1] = planes.planes[1][(size_t)chromaRows[i] * planes.strides[1] + xs[i] / 2];
+                quad[i * 4 + 2] = planes.planes[2][(size_t)chromaRows[i] * planes.strides[2] + xs[i] / 2];
+            }
+        }
+    } else {
+        getRGBAt(planes, x0, y0, quad);
+        getRGBAt(planes, x1, y0, quad + 4);
+        getRGBAt(planes, x0, y1, quad + 8);
+        getRGBAt(planes, x1, y1, quad + 12);
+    }
+}
+
+template <int Fetch>
+static void warpChip(const ImagePlanes &planes, const float m[6], int size, bool bgrOut, uint8_t *dst)
+{
+    bool yuv = Fetch == FETCH_YUV420SP || Fetch == FETCH_I420;
+    bool bgrSrc = planes.format == YAD_PIX_FMT_BGR888 || planes.format == YAD_PIX_FMT_BGRA8888;
+    bool swap = (Fetch == FETCH_PACKED3 || Fetch == FETCH_PACKED4 ? bgrSrc : false) != bgrOut;
+    int maxX = planes.width - 1;
+    int maxY = planes.height - 1;
+    
+    int xs[YAD_FACE_CHIP_MAX_SIZE];
+    int ys[YAD_FACE_CHIP_MAX_SIZE];
+    uint8_t quad[16] = {0};
+    uint8_t pixel[4];
+    uint8_t rgb[3];
+    for (int v = 0; v < size; v++) {
+        computeRowCoords(m, v, size, xs, ys);
+        uint8_t *out = dst + (size_t)v * size * 3;
+        for (int u = 0; u < size; u++, out += 3) {
+            int x0 = xs[u] >> YAD_ALIGN_FRAC_BITS;
+            int y0 = ys[u] >> YAD_ALIGN_FRAC_BITS;
+            if (x0 < -1 || y0 < -1 || x0 > maxX || y0 > maxY) {
+                out[0] = out[1] = out[2] = 0;
+                continue;
+            }
+            // 边缘上的采样复制最近的像素
+            int x1 = std::min(x0 + 1, maxX);
+            int y1 = std::min(y0 + 1, maxY);
+            x0 = std::max(x0, 0);
+            y0 = std::max(y0, 0);
+            fetchQuad<Fetch>(planes, x0, x1, y0, y1, quad);
+            blendQuad(quad, xs[u] & (YAD_ALIGN_FRAC_ONE - 1), ys[u] & (YAD_ALIGN_FRAC_ONE - 1), pixel);
+            const uint8_t *src = pixel;
+            if (yuv) {
+                convertYUVToRGB(pixel[0], pixel[1], pixel[2], rgb);
+                src = rgb;
+            }
+            out[0] = swap ? src[2] : src[0];
+            out[1] = src[1];
+            out[2] = swap ? src[0] : src[2];
+        }
+    }
+}
+
+static void warpChip(const ImagePlanes &planes, const float m[6], int size, bool bgrOut, uint8_t *dst)
+{
+    switch (planes.format) {
+        case YAD_PIX_FMT_RGB888:
+        case YAD_PIX_FMT_BGR888:
+            warpChip<FETCH_PACKED3>(planes, m, size, bgrOut, dst);
+            break;
+        case YAD_PIX_FMT_RGBA8888:
+        case YAD_PIX_FMT_BGRA8888:
+            warpChip<FETCH_PACKED4>(planes, m, size, bgrOut, dst);
+            break;
+        case YAD_PIX_FMT_NV12:
+        case YAD_PIX_FMT_NV21:
+            warpChip<FETCH_YUV420SP>(planes, m, size, bgrOut, dst);
+            break;
+        case YAD_PIX_FMT_I420:
+            warpChip<FETCH_I420>(planes, m, size, bgrOut, dst);
+            break;
+        default:
+            warpChip<FETCH_GENERIC>(planes, m, size, bgrOut, dst);
+            break;
+    }
+}
+
+int alignFaceChips(const YADDetectImage *detectImage, const YADFaceResults *faceResults, int chipSize,
+                   YADPixelFormat chipFormat, uint8_t *chips, size_t chipsBytes)
+{
+    if (!detectImage || !faceResults || !chips) {
+        return YAD_BAD_VALUE;
+    }
+    if (chipSize < YAD_FACE_CHIP_MIN_SIZE || chipSize > YAD_FACE_CHIP_MAX_SIZE) {
+        return YAD_BAD_VALUE;
+    }
+    if (chipFormat != YAD_PIX_FMT_RGB888 && chipFormat != YAD_PIX_FMT_BGR888) {
+        return YAD_FORMAT_UNSUPPORTED;
+    }
+    if (chipsBytes < getFaceChipBytes(chipSize) * faceResults->num_faces) {
+        return YAD_BAD_VALUE;
+    }
+    
+    ImagePlanes planes;
+    int err = getImagePlanes(detectImage, &planes);
+    if (err != YAD_OK) {
+        return err;
+    }
+    
+    for (int i = 0; i < faceResults->num_faces; i++) {
+        float matrix[6];
+        uint8_t *chip = chips + getFaceChipBytes(chipSize) * i;
+        if (getFaceChipTransform(faceResults->faces[i], chipSize, matrix) != YAD_OK) {
+            // 关键点退化时输出全黑，保持人脸与chip一一对应
+            memset(chip, 0, getFaceChipBytes(chipSize));
+            continue;
+        }
+        // 关键点相对整幅图像，平面视图已经应用了crop
+        matrix[2] -= planes.crop_x;
+        matrix[5] -= planes.crop_y;
+        warpChip(planes, matrix, chipSize, chipFormat == YAD_PIX_FMT_BGR888, chip);
+    }
+    return YAD_OK;
+}
+
+int alignFaceChips(const YADDetectImage *detectImage, const YADFeatureInfo *featureInfo, int chipSize,
+                   YADPixelFormat chipFormat, uint8_t *chips, size_t chipsBytes)
+{
+    if (!featureInfo) {
+        return YAD_BAD_VALUE;
+    }
+    YADFaceResults faceResults = makeFaceResults(const_cast<YADFeatureInfo *>(featureInfo));
+    faceResults.num_faces = std::min(featureInfo->num_faces, YAD_MAX_FACE_NUM);
+    return alignFaceChips(detectImage, &faceResults, chipSize, chipFormat, chips, chipsBytes);
+}
+
+}; // namespace yad
@@ -0,0 +1,35 @@
+//
+//  FaceAligner.h
+//  YAD
+//
+
+#ifndef YAD_FACE_ALIGNER_H
+#define YAD_FACE_ALIGNER_H
+
+#include "YADetector.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace yad {
+
+#define YAD_FACE_CHIP_MIN_SIZE  16
+#define YAD_FACE_CHIP_MAX_SIZE  512
+#define YAD_FACE_CHIP_BASE_SIZE 112     // 对齐模板的基准尺寸，其它尺寸等比缩放
+
+// 对齐后单个人脸图像(chip)的字节数，格式为RGB888或BGR888，行之间没有填充
+size_t getFaceChipBytes(int chipSize);
+// 由人脸的5个对齐点(kLandmarkIndices5：左右瞳孔、鼻尖、左右嘴角)和ArcFace模板(按chipSize/112缩放)最小二乘估计相似变换。
+// matrix为chip坐标到原图坐标的仿射矩阵{a, b, tx, c, d, ty}，x = a * u + b * v + tx，y = c * u + d * v + ty
+int getFaceChipTransform(const YADFaceInfo &face, int chipSize, float matrix[6]);
+// 把每个人脸按关键点对齐裁剪为chipSize x chipSize的图像，第i个人脸写入chips + i * getFaceChipBytes(chipSize)。
+// 直接从原图的各平面双线性采样，支持所有YADPixelFormat，不需要先转换整帧；超出原图的区域填0。
+// chipFormat为YAD_PIX_FMT_RGB888或YAD_PIX_FMT_BGR888，chipsBytes不足以容纳所有人脸时返回YAD_BAD_VALUE
+int alignFaceChips(const YADDetectImage *detectImage, const YADFaceResults *faceResults, int chipSize,
+                   YADPixelFormat chipFormat, uint8_t *chips, size_t chipsBytes);
+int alignFaceChips(const YADDetectImage *detectImage, const YADFeatureInfo *featureInfo, int chipSize,
+                   YADPixelFormat chipFormat, uint8_t *chips, size_t chipsBytes);
+
+}; // namespace yad
+
+#endif /* YAD_FACE_ALIGNER_H */
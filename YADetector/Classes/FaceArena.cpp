@@ -0,0 +1,98 @@
+//
+//  FaceArena.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADArena"
+#include "LogMacros.h"
+
+#include "FaceArena.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+
+#define YAD_FACE_ARENA_MAX_CACHED   8   // 每种容量最多缓存的内存块个数
+
+namespace yad {
+
+static std::mutex s_pool_mutex;
+// 不释放，避免进程退出时全局FaceArena晚于池析构
+static std::multimap<int, YADFaceInfo *> &s_pool = *new std::multimap<int, YADFaceInfo *>;
+
+FaceArena::FaceArena(int capacity) :
+    pooled_(false)
+{
+    allocate(capacity);
+}
+
+FaceArena::FaceArena(YADConfig &config) :
+    pooled_(false)
+{
+    int capacity = 1;
+    auto it = config.find(kYADMaxFaceCount);
+    if (it != config.end() && !it->second.empty()) {
+        capacity = std::stoi(it->second);
+    }
+    allocate(capacity);
+}
+
+FaceArena::FaceArena(YADFaceInfo *faces, int capacity) :
+    pooled_(false)
+{
+    results_.num_faces = 0;
+    results_.capacity = faces ? std::max(0, capacity) : 0;
+    results_.faces = faces;
+}
+
+FaceArena::~FaceArena()
+{
+    if (!pooled_ || !results_.faces) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(s_pool_mutex);
+    if (s_pool.count(results_.capacity) < YAD_FACE_ARENA_MAX_CACHED) {
+        s_pool.insert(std::make_pair(results_.capacity, results_.faces));
+    } else {
+        delete[] results_.faces;
+    }
+    results_.faces = nullptr;
+}
+
+void FaceArena::allocate(int capacity)
+{
+    capacity = std::max(1, capacity);
+    
+    results_.num_faces = 0;
+    results_.capacity = capacity;
+    results_.faces = nullptr;
+    pooled_ = true;
+    
+    {
+        std::lock_guard<std::mutex> lock(s_pool_mutex);
+        auto it = s_pool.find(capacity);
+        if (it != s_pool.end()) {
+            results_.faces = it->second;
+            s_pool.erase(it);
+        }
+    }
+    if (!results_.faces) {
+        YLOGV("allocate capacity: %d", capacity);
+        results_.faces = new YADFaceInfo[capacity];
+    }
+}
+
+YADFaceResults *FaceArena::get()
+{
+    return &results_;
+}
+
+int FaceArena::getCapacity() const
+{
+    return results_.capacity;
+}
+
+}; // namespace yad
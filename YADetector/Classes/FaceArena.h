@@ -0,0 +1,40 @@
+//
+//  FaceArena.h
+//  YAD
+//
+
+#ifndef YAD_FACE_ARENA_H
+#define YAD_FACE_ARENA_H
+
+#include "YADetector.h"
+
+namespace yad {
+
+// YADFaceResults的内存载体，容量按需分配，单人脸场景只占用一个YADFaceInfo的内存。
+// 自行分配的内存来自进程内共享的池，析构时归还，避免每帧分配；也可以使用调用者提供的内存。
+class FaceArena {
+public:
+    // 从共享池获取容量为capacity的内存
+    explicit FaceArena(int capacity);
+    // 容量由配置 kYADMaxFaceCount 决定
+    explicit FaceArena(YADConfig &config);
+    // 使用调用者提供的内存，不负责释放
+    FaceArena(YADFaceInfo *faces, int capacity);
+    ~FaceArena();
+    
+    YADFaceResults *get();
+    int getCapacity() const;
+    
+private:
+    FaceArena(const FaceArena &);
+    FaceArena &operator=(const FaceArena &);
+    
+    void allocate(int capacity);
+    
+    YADFaceResults results_;
+    bool pooled_;
+};
+
+}; // namespace yad
+
+#endif /* YAD_FACE_ARENA_H */
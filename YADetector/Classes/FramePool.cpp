@@ -0,0 +1,316 @@
+//
+//  FramePool.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADFramePool"
+#include "LogMacros.h"
+
+#include "FramePool.h"
+#include "ImageUtils.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <utility>
+#include <vector>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace yad {
+
+static inline size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+#pragma mark FrameBuffer
+
+FrameBuffer::FrameBuffer() :
+    pool_(nullptr),
+    data_(nullptr),
+    size_(0),
+    capacity_(0),
+    format_(YAD_PIX_FMT_NONE),
+    width_(0),
+    height_(0),
+    stride_(0)
+{
+}
+
+FrameBuffer::FrameBuffer(FrameBuffer &&other) :
+    FrameBuffer()
+{
+    *this = std::move(other);
+}
+
+FrameBuffer &FrameBuffer::operator=(FrameBuffer &&other)
+{
+    if (this != &other) {
+        release();
+        pool_ = other.pool_;
+        data_ = other.data_;
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        format_ = other.format_;
+        width_ = other.width_;
+        height_ = other.height_;
+        stride_ = other.stride_;
+        other.pool_ = nullptr;
+        other.data_ = nullptr;
+        other.size_ = 0;
+        other.capacity_ = 0;
+    }
+    return *this;
+}
+
+FrameBuffer::~FrameBuffer()
+{
+    release();
+}
+
+uint8_t *FrameBuffer::data() const
+{
+    return data_;
+}
+
+size_t FrameBuffer::size() const
+{
+    return size_;
+}
+
+size_t FrameBuffer::getCapacity() const
+{
+    return capacity_;
+}
+
+YADPixelFormat FrameBuffer::getFormat() const
+{
+    return format_;
+}
+
+int FrameBuffer::getWidth() const
+{
+    return width_;
+}
+
+int FrameBuffer::getHeight() const
+{
+    return height_;
+}
+
+int FrameBuffer::getStride() const
+{
+    return stride_;
+}
+
+YADDetectImage FrameBuffer::getImage() const
+{
+    YADDetectImage image = {format_, YAD_DATA_TYPE_RAW, data_, width_, height_, stride_};
+    return image;
+}
+
+void FrameBuffer::release()
+{
+    if (pool_ && data_) {
+        pool_->recycle(data_, capacity_);
+    }
+    pool_ = nullptr;
+    data_ = nullptr;
+    size_ = 0;
+    capacity_ = 0;
+    format_ = YAD_PIX_FMT_NONE;
+    width_ = 0;
+    height_ = 0;
+    stride_ = 0;
+}
+
+#pragma mark FramePool
+
+FramePool::FramePool(int64_t maxCachedBytes, bool hugePages) :
+    max_cached_bytes_(maxCachedBytes),
+    huge_pages_(hugePages)
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+FramePool::~FramePool()
+{
+    YLOGI("hits: %llu misses: %llu evictions: %llu", (unsigned long long)stats_.hits,
+          (unsigned long long)stats_.misses, (unsigned long long)stats_.evictions);
+    if (stats_.in_use_bytes > 0) {
+        YLOGW("destroyed with %lld bytes in use", (long long)stats_.in_use_bytes);
+    }
+    trim();
+}
+
+// static
+FramePool &FramePool::getDefault()
+{
+    // 不释放，避免进程退出时全局对象持有的缓冲区晚于池归还
+    static FramePool *pool = new FramePool(YAD_FRAME_POOL_DEFAULT_BYTES, true);
+    return *pool;
+}
+
+// static
+int FramePool::getAlignedStride(YADPixelFormat format, int width)
+{
+    int pixelSize = getPixelSize(format);
+    if (pixelSize <= 0 || width <= 0) {
+        return 0;
+    }
+    return (int)alignUp((size_t)width * pixelSize, YAD_FRAME_ALIGNMENT);
+}
+
+size_t FramePool::getAllocSize(size_t bytes) const
+{
+    size_t size = alignUp(bytes > 0 ? bytes : 1, YAD_FRAME_ALIGNMENT);
+    if (huge_pages_ && size >= YAD_FRAME_HUGE_PAGE_SIZE) {
+        return alignUp(size, YAD_FRAME_HUGE_PAGE_SIZE);
+    }
+    // 按最高位的1/16到1/8取整，尺寸略有变化(如ROI裁剪)的请求可以复用同一个缓冲区
+    size_t step = YAD_FRAME_ALIGNMENT;
+    while (step * 16 <= size) {
+        step <<= 1;
+    }
+    return alignUp(size, step);
+}
+
+uint8_t *FramePool::allocate(size_t capacity)
+{
+    bool huge = huge_pages_ && capacity >= YAD_FRAME_HUGE_PAGE_SIZE;
+    void *data = nullptr;
+    if (posix_memalign(&data, huge ? YAD_FRAME_HUGE_PAGE_SIZE : YAD_FRAME_ALIGNMENT, capacity) != 0) {
+        YLOGE("allocate %zu bytes failed", capacity);
+        return nullptr;
+    }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // 透明大页未开启或者为never时忽略失败，仍是普通页
+    if (huge) {
+        madvise(data, capacity, MADV_HUGEPAGE);
+    }
+#endif
+    YLOGV("allocate %zu bytes, huge: %d", capacity, huge);
+    return (uint8_t *)data;
+}
+
+// static
+void FramePool::deallocate(uint8_t *data)
+{
+    free(data);
+}
+
+int FramePool::acquire(size_t bytes, FrameBuffer *buffer)
+{
+    if (!buffer) {
+        return YAD_BAD_VALUE;
+    }
+    
+    // 已持有的缓冲区够用时不经过空闲表，也不计入命中。与空闲表一样只复用不超过两倍的容量，
+    // 请求变小后归还大的缓冲区，不会一直占着最大的一帧
+    size_t capacity = getAllocSize(bytes);
+    if (buffer->pool_ == this && buffer->data_ && buffer->capacity_ >= bytes && buffer->capacity_ <= capacity * 2) {
+        buffer->size_ = bytes;
+        buffer->format_ = YAD_PIX_FMT_NONE;
+        buffer->width_ = 0;
+        buffer->height_ = 0;
+        buffer->stride_ = 0;
+        return YAD_OK;
+    }
+    buffer->release();
+    
+    uint8_t *data = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = free_.lower_bound(capacity);
+        if (it != free_.end() && it->first <= capacity * 2) {
+            capacity = it->first;
+            data = it->second;
+            free_.erase(it);
+            stats_.hits++;
+            stats_.cached_bytes -= capacity;
+        } else {
+            stats_.misses++;
+        }
+    }
+    if (!data) {
+        data = allocate(capacity);
+        if (!data) {
+            return YAD_NO_MEMORY;
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.in_use_bytes += capacity;
+    }
+    buffer->pool_ = this;
+    buffer->data_ = data;
+    buffer->size_ = bytes;
+    buffer->capacity_ = capacity;
+    return YAD_OK;
+}
+
+int FramePool::acquire(YADPixelFormat format, int width, int height, FrameBuffer *buffer)
+{
+    int stride = getAlignedStride(format, width);
+    if (!buffer || stride <= 0 || height <= 0) {
+        return YAD_BAD_VALUE;
+    }
+    
+    int err = acquire(getImageSize(format, height, stride), buffer);
+    if (err != YAD_OK) {
+        return err;
+    }
+    buffer->format_ = format;
+    buffer->width_ = width;
+    buffer->height_ = height;
+    buffer->stride_ = stride;
+    return YAD_OK;
+}
+
+void FramePool::recycle(uint8_t *data, size_t capacity)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.in_use_bytes -= capacity;
+        if (stats_.cached_bytes + (int64_t)capacity <= max_cached_bytes_) {
+            free_.insert(std::make_pair(capacity, data));
+            stats_.cached_bytes += capacity;
+            return;
+        }
+        stats_.evictions++;
+    }
+    deallocate(data);
+}
+
+void FramePool::trim()
+{
+    std::vector<uint8_t *> buffers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &entry : free_) {
+            buffers.push_back(entry.second);
+        }
+        free_.clear();
+        stats_.cached_bytes = 0;
+    }
+    for (uint8_t *data : buffers) {
+        deallocate(data);
+    }
+}
+
+void FramePool::setMaxCachedBytes(int64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_cached_bytes_ = bytes;
+}
+
+FramePoolStats FramePool::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+}; // namespace yad
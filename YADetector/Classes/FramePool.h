@@ -0,0 +1,116 @@
+//
+//  FramePool.h
+//  YAD
+//
+
+#ifndef YAD_FRAME_POOL_H
+#define YAD_FRAME_POOL_H
+
+#include "YADetector.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <mutex>
+
+namespace yad {
+
+#define YAD_FRAME_ALIGNMENT             64              // 缓冲区地址和行步长的对齐字节数
+#define YAD_FRAME_HUGE_PAGE_SIZE        (2 << 20)       // 大页尺寸，不小于该尺寸的缓冲区才使用大页
+#define YAD_FRAME_POOL_DEFAULT_BYTES    (64ll << 20)    // 默认最多缓存的空闲内存
+
+// 帧缓冲池统计
+typedef struct FramePoolStats {
+    uint64_t hits;          // 由空闲缓冲区满足的请求数，已持有的缓冲区直接复用时不计入
+    uint64_t misses;        // 需要新分配内存的请求数
+    uint64_t evictions;     // 归还时超过缓存上限而释放的缓冲区数
+    int64_t cached_bytes;   // 空闲缓冲区占用的内存
+    int64_t in_use_bytes;   // 借出的缓冲区占用的内存
+} FramePoolStats;
+
+class FramePool;
+
+// 从FramePool借出的缓冲区，析构时归还。只能移动，不能拷贝
+class FrameBuffer {
+public:
+    FrameBuffer();
+    FrameBuffer(FrameBuffer &&other);
+    FrameBuffer &operator=(FrameBuffer &&other);
+    ~FrameBuffer();
+    
+    // 没有持有缓冲区时返回空
+    uint8_t *data() const;
+    // 请求的字节数，实际容量可能更大
+    size_t size() const;
+    size_t getCapacity() const;
+    // 按格式借出时的图像参数，按字节数借出时格式为YAD_PIX_FMT_NONE
+    YADPixelFormat getFormat() const;
+    int getWidth() const;
+    int getHeight() const;
+    int getStride() const;
+    // 指向该缓冲区的YAD_DATA_TYPE_RAW图像
+    YADDetectImage getImage() const;
+    void release();
+    
+private:
+    friend class FramePool;
+    
+    FrameBuffer(const FrameBuffer &) = delete;
+    FrameBuffer &operator=(const FrameBuffer &) = delete;
+    
+    FramePool *pool_;
+    uint8_t *data_;
+    size_t size_;
+    size_t capacity_;
+    YADPixelFormat format_;
+    int width_;
+    int height_;
+    int stride_;
+};
+
+// 帧缓冲池，用于格式转换、旋转、裁剪等需要整帧临时内存的地方，避免每帧分配和4K帧首次访问时的缺页。
+// 缓冲区地址按YAD_FRAME_ALIGNMENT对齐，按格式借出时行步长也对齐。空闲缓冲区按容量缓存，
+// 只复用容量不超过请求两倍的缓冲区，缓存总量超过上限时归还的缓冲区直接释放。
+// hugePages为true时不小于YAD_FRAME_HUGE_PAGE_SIZE的缓冲区按大页对齐并建议内核使用透明大页(仅Linux)。
+// 借出的缓冲区必须在池析构前归还
+class FramePool {
+public:
+    explicit FramePool(int64_t maxCachedBytes = YAD_FRAME_POOL_DEFAULT_BYTES, bool hugePages = false);
+    ~FramePool();
+    
+    // 框架内部预处理共用的池，启用大页，不释放
+    static FramePool &getDefault();
+    // 行步长按YAD_FRAME_ALIGNMENT对齐的格式和尺寸
+    static int getAlignedStride(YADPixelFormat format, int width);
+    
+    // 借出能容纳format、width x height图像的缓冲区，YUV的色度平面紧随亮度平面，步长见getPlaneStride。
+    // buffer已持有本池容量足够且不超过请求两倍的缓冲区时直接复用，否则先归还
+    int acquire(YADPixelFormat format, int width, int height, FrameBuffer *buffer);
+    // 借出至少bytes字节的连续缓冲区
+    int acquire(size_t bytes, FrameBuffer *buffer);
+    // 释放全部空闲缓冲区
+    void trim();
+    void setMaxCachedBytes(int64_t bytes);
+    FramePoolStats getStats();
+    
+private:
+    friend class FrameBuffer;
+    
+    FramePool(const FramePool &);
+    FramePool &operator=(const FramePool &);
+    
+    size_t getAllocSize(size_t bytes) const;
+    uint8_t *allocate(size_t capacity);
+    static void deallocate(uint8_t *data);
+    void recycle(uint8_t *data, size_t capacity);
+    
+    std::mutex mutex_;
+    int64_t max_cached_bytes_;
+    bool huge_pages_;
+    std::multimap<size_t, uint8_t *> free_;    // 容量 -> 空闲缓冲区
+    FramePoolStats stats_;
+};
+
+}; // namespace yad
+
+#endif /* YAD_FRAME_POOL_H */
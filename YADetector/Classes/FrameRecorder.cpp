@@ -0,0 +1,472 @@
+//
+//  FrameRecorder.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADRec"
+#include "LogMacros.h"
+
+#include "FrameRecorder.h"
+#include "ImageUtils.h"
+#ifdef __APPLE__
+#include <CoreVideo/CoreVideo.h>
+#endif
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace yad {
+
+static int64_t getNowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#pragma mark FrameRecorder
+
+FrameRecorder::FrameRecorder() :
+    file_(nullptr),
+    frame_count_(0)
+{
+    
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    close();
+}
+
+int FrameRecorder::open(const std::string &path)
+{
+    close();
+    
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_) {
+        YLOGE("fopen() failed, path: %s", path.c_str());
+        return YAD_NAME_NOT_FOUND;
+    }
+    
+    YADRecordFileHeader header = {YAD_RECORD_FILE_MAGIC, YAD_RECORD_VERSION};
+    if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+        YLOGE("write file header failed");
+        close();
+        return YAD_UNKNOWN_ERROR;
+    }
+    
+    frame_count_ = 0;
+    return YAD_OK;
+}
+
+void FrameRecorder::close()
+{
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+bool FrameRecorder::isOpen() const
+{
+    return file_ != nullptr;
+}
+
+size_t FrameRecorder::getFrameCount() const
+{
+    return frame_count_;
+}
+
+int FrameRecorder::write(const YADDetectImage *detectImage, const YADDetectInfo *detectInfo, int64_t timestampUs)
+{
+    if (!detectImage || !detectInfo || !detectImage->data) {
+        return YAD_BAD_VALUE;
+    }
+    if (!file_) {
+        return YAD_NO_INIT;
+    }
+    
+    const uint8_t *planes[YAD_MAX_PLANE_NUM] = {nullptr, nullptr, nullptr, nullptr};
+    int strides[YAD_MAX_PLANE_NUM] = {0, 0, 0, 0};
+    YADRecti crop = {0, 0, 0, 0};
+    
+    if (detectImage->type == YAD_DATA_TYPE_RAW || detectImage->type == YAD_DATA_TYPE_RAW_PLANES) {
+        // 多平面时录制整幅图像，crop单独记录，回放时原样还原
+        YADDetectImage fullImage = *detectImage;
+        YADRawPlanes rawPlanes;
+        if (detectImage->type == YAD_DATA_TYPE_RAW_PLANES) {
+            rawPlanes = *(const YADRawPlanes *)detectImage->data;
+            crop = rawPlanes.crop;
+            rawPlanes.crop = {0, 0, 0, 0};
+            fullImage.data = &rawPlanes;
+        }
+        ImagePlanes imagePlanes;
+        int err = getImagePlanes(&fullImage, &imagePlanes);
+        if (err != YAD_OK) {
+            return err;
+        }
+        for (int i = 0; i < imagePlanes.num_planes; i++) {
+            planes[i] = imagePlanes.planes[i];
+            strides[i] = imagePlanes.strides[i];
+        }
+        return writeFrame(detectImage, detectInfo->rotate_mode, timestampUs, planes, strides, crop);
+    }
+#ifdef __APPLE__
+    if (detectImage->type == YAD_DATA_TYPE_IOS_PIXEL_BUFFER) {
+        CVPixelBufferRef pixelBuffer = (CVPixelBufferRef)detectImage->data;
+        CVPixelBufferLockBaseAddress(pixelBuffer, kCVPixelBufferLock_ReadOnly);
+        if (CVPixelBufferIsPlanar(pixelBuffer)) {
+            size_t planeCount = std::min((size_t)YAD_MAX_PLANE_NUM, CVPixelBufferGetPlaneCount(pixelBuffer));
+            for (size_t i = 0; i < planeCount; i++) {
+                planes[i] = (const uint8_t *)CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, i);
+                strides[i] = (int)CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, i);
+            }
+        } else {
+            planes[0] = (const uint8_t *)CVPixelBufferGetBaseAddress(pixelBuffer);
+            strides[0] = (int)CVPixelBufferGetBytesPerRow(pixelBuffer);
+        }
+        int err = writeFrame(detectImage, detectInfo->rotate_mode, timestampUs, planes, strides, crop);
+        CVPixelBufferUnlockBaseAddress(pixelBuffer, kCVPixelBufferLock_ReadOnly);
+        return err;
+    }
+#endif
+    
+    YLOGW("data type %d unsupported", detectImage->type);
+    return YAD_FORMAT_UNSUPPORTED;
+}
+
+int FrameRecorder::writeFrame(const YADDetectImage *detectImage, int rotateMode, int64_t timestampUs,
+                              const uint8_t *planes[], const int strides[], const YADRecti &crop)
+{
+    YADPixelFormat format = detectImage->format;
+    int width = detectImage->width;
+    int height = detectImage->height;
+    int planeCount = getPlaneCount(format);
+    if (planeCount <= 0) {
+        return YAD_FORMAT_UNSUPPORTED;
+    }
+    
+    // 计算紧凑后的数据大小
+    uint32_t size = 0;
+    for (int i = 0; i < planeCount; i++) {
+        int rowBytes, rows;
+        if (!planes[i] || !getPlaneGeometry(format, width, height, i, &rowBytes, &rows) || rowBytes > strides[i]) {
+            return YAD_BAD_VALUE;
+        }
+        size += (uint32_t)rowBytes * rows;
+    }
+    
+    YADRecordFrameHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = YAD_RECORD_FRAME_MAGIC;
+    header.size = size;
+    header.timestamp_us = timestampUs;
+    header.format = format;
+    header.width = width;
+    header.height = height;
+    header.stride = strides[0];
+    header.rotate_mode = rotateMode;
+    header.type = detectImage->type == YAD_DATA_TYPE_RAW_PLANES ? YAD_DATA_TYPE_RAW_PLANES : YAD_DATA_TYPE_RAW;
+    header.crop = crop;
+    
+    if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+        return YAD_UNKNOWN_ERROR;
+    }
+    for (int i = 0; i < planeCount; i++) {
+        int rowBytes, rows;
+        getPlaneGeometry(format, width, height, i, &rowBytes, &rows);
+        const uint8_t *src = planes[i];
+        for (int y = 0; y < rows; y++, src += strides[i]) {
+            if (fwrite(src, rowBytes, 1, file_) != 1) {
+                return YAD_UNKNOWN_ERROR;
+            }
+        }
+    }
+    
+    frame_count_++;
+    return YAD_OK;
+}
+
+#pragma mark RecordingDetector
+
+RecordingDetector::RecordingDetector(Detector *detector, const std::string &path) :
+    detector_(detector),
+    start_us_(getNowUs())
+{
+    if (recorder_.open(path) == YAD_OK) {
+        YLOGI("recording to %s", path.c_str());
+    }
+}
+
+RecordingDetector::~RecordingDetector()
+{
+    YLOGI("recorded %zu frames", recorder_.getFrameCount());
+}
+
+int RecordingDetector::initCheck() const
+{
+    return detector_ ? detector_->initCheck() : YAD_NO_INIT;
+}
+
+YADLandmarkProfile RecordingDetector::getLandmarkProfile() const
+{
+    return detector_ ? detector_->getLandmarkProfile() : YAD_LANDMARK_PROFILE_106;
+}
+
+int RecordingDetector::detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo)
+{
+    if (!detector_) {
+        return YAD_NO_INIT;
+    }
+    
+    record(detectImage, detectInfo);
+    return detector_->detect(detectImage, detectInfo, featureInfo);
+}
+
+int RecordingDetector::detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults)
+{
+    if (!detector_) {
+        return YAD_NO_INIT;
+    }
+    
+    record(detectImage, detectInfo);
+    return detector_->detectFaces(detectImage, detectInfo, faceResults);
+}
+
+void RecordingDetector::record(YADDetectImage *detectImage, YADDetectInfo *detectInfo)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (recorder_.isOpen()) {
+        int err = recorder_.write(detectImage, detectInfo, getNowUs() - start_us_);
+        if (err != YAD_OK) {
+            YLOGW("record frame failed, err: %d", err);
+        }
+    }
+}
+
+#pragma mark FrameReplayer
+
+// 按文件头的格式、宽高和stride计算紧凑后的数据大小，每个平面的有效字节数不能超过其stride
+static bool getPackedFrameSize(const YADRecordFrameHeader &header, uint64_t *size)
+{
+    YADPixelFormat format = (YADPixelFormat)header.format;
+    if (header.width <= 0 || header.height <= 0 || header.stride <= 0 ||
+        header.width > YAD_RECORD_MAX_DIMENSION || header.height > YAD_RECORD_MAX_DIMENSION ||
+        header.stride > YAD_RECORD_MAX_DIMENSION * 4 ||
+        (int64_t)header.width * getPixelSize(format) > header.stride) {
+        return false;
+    }
+    
+    *size = 0;
+    for (int i = 0; i < getPlaneCount(format); i++) {
+        int rowBytes, rows;
+        if (!getPlaneGeometry(format, header.width, header.height, i, &rowBytes, &rows) ||
+            rowBytes > getPlaneStride(format, header.stride, i)) {
+            return false;
+        }
+        *size += (uint64_t)rowBytes * rows;
+    }
+    return true;
+}
+
+FrameReplayer::FrameReplayer() :
+    file_(nullptr)
+{
+    
+}
+
+FrameReplayer::~FrameReplayer()
+{
+    close();
+}
+
+int FrameReplayer::open(const std::string &path)
+{
+    close();
+    
+    file_ = fopen(path.c_str(), "rb");
+    if (!file_) {
+        YLOGE("fopen() failed, path: %s", path.c_str());
+        return YAD_NAME_NOT_FOUND;
+    }
+    
+    int err = rewind();
+    if (err != YAD_OK) {
+        close();
+    }
+    return err;
+}
+
+void FrameReplayer::close()
+{
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+int FrameReplayer::rewind()
+{
+    if (!file_) {
+        return YAD_NO_INIT;
+    }
+    
+    fseek(file_, 0, SEEK_SET);
+    
+    YADRecordFileHeader header;
+    if (fread(&header, sizeof(header), 1, file_) != 1 || header.magic != YAD_RECORD_FILE_MAGIC) {
+        YLOGE("invalid record file");
+        return YAD_BAD_TYPE;
+    }
+    if (header.version != YAD_RECORD_VERSION) {
+        YLOGE("record version %u unsupported", header.version);
+        return YAD_BAD_TYPE;
+    }
+    return YAD_OK;
+}
+
+int FrameReplayer::readFrame(YADDetectImage *detectImage, YADDetectInfo *detectInfo, int64_t *timestampUs)
+{
+    if (!detectImage || !detectInfo) {
+        return YAD_BAD_VALUE;
+    }
+    if (!file_) {
+        return YAD_NO_INIT;
+    }
+    
+    YADRecordFrameHeader header;
+    if (fread(&header, sizeof(header), 1, file_) != 1) {
+        return YAD_NOT_ENOUGH_DATA;
+    }
+    if (header.magic != YAD_RECORD_FRAME_MAGIC) {
+        YLOGE("invalid frame header");
+        return YAD_BAD_TYPE;
+    }
+    
+    YADPixelFormat format = (YADPixelFormat)header.format;
+    int planeCount = getPlaneCount(format);
+    if (planeCount <= 0) {
+        return YAD_FORMAT_UNSUPPORTED;
+    }
+    // 文件头不可信，先按宽高和stride核对数据大小，避免截断或损坏的文件导致越界读
+    uint64_t packedSize;
+    if (!getPackedFrameSize(header, &packedSize) || packedSize != header.size) {
+        YLOGE("invalid frame geometry, %dx%d stride: %d size: %u", header.width, header.height, header.stride,
+              header.size);
+        return YAD_BAD_VALUE;
+    }
+    
+    FramePool &pool = FramePool::getDefault();
+    int err = pool.acquire(header.size, &packed_);
+    if (err != YAD_OK) {
+        return err;
+    }
+    if (header.size > 0 && fread(packed_.data(), header.size, 1, file_) != 1) {
+        return YAD_NOT_ENOUGH_DATA;
+    }
+    
+    // 按录制时的stride还原
+    err = pool.acquire(getImageSize(format, header.height, header.stride), &buffer_);
+    if (err != YAD_OK) {
+        return err;
+    }
+    memset(&raw_planes_, 0, sizeof(raw_planes_));
+    raw_planes_.num_planes = planeCount;
+    raw_planes_.crop = header.crop;
+    const uint8_t *src = packed_.data();
+    uint8_t *plane = buffer_.data();
+    for (int i = 0; i < planeCount; i++) {
+        int rowBytes, rows;
+        int stride = getPlaneStride(format, header.stride, i);
+        getPlaneGeometry(format, header.width, header.height, i, &rowBytes, &rows);
+        for (int y = 0; y < rows; y++) {
+            memcpy(plane + (size_t)y * stride, src, rowBytes);
+            src += rowBytes;
+        }
+        raw_planes_.planes[i] = plane;
+        raw_planes_.strides[i] = stride;
+        plane += (size_t)stride * rows;
+    }
+    
+    detectImage->format = format;
+    detectImage->width = header.width;
+    detectImage->height = header.height;
+    detectImage->stride = header.stride;
+    if (header.type == YAD_DATA_TYPE_RAW_PLANES) {
+        detectImage->type = YAD_DATA_TYPE_RAW_PLANES;
+        detectImage->data = &raw_planes_;
+    } else {
+        detectImage->type = YAD_DATA_TYPE_RAW;
+        detectImage->data = buffer_.data();
+    }
+    memset(detectInfo, 0, sizeof(YADDetectInfo));
+    detectInfo->rotate_mode = (YADRotateMode)header.rotate_mode;
+    if (timestampUs) {
+        *timestampUs = header.timestamp_us;
+    }
+    return YAD_OK;
+}
+
+int FrameReplayer::replay(Detector *detector, bool realtime, ReplayStats *stats, ReplayCallback callback)
+{
+    if (!detector) {
+        return YAD_BAD_VALUE;
+    }
+    
+    int err = rewind();
+    if (err != YAD_OK) {
+        return err;
+    }
+    
+    if (stats) {
+        stats->frames = 0;
+        stats->failures = 0;
+        stats->latencies_us.clear();
+    }
+    
+    std::unique_ptr<YADFeatureInfo> featureInfo(new YADFeatureInfo);
+    int64_t firstTimestampUs = -1;
+    int64_t startUs = getNowUs();
+    for (int index = 0; ; index++) {
+        YADDetectImage detectImage;
+        YADDetectInfo detectInfo;
+        int64_t timestampUs;
+        err = readFrame(&detectImage, &detectInfo, &timestampUs);
+        if (err == YAD_NOT_ENOUGH_DATA) {
+            break;
+        } else if (err != YAD_OK) {
+            return err;
+        }
+        
+        if (firstTimestampUs < 0) {
+            firstTimestampUs = timestampUs;
+        }
+        if (realtime) {
+            int64_t waitUs = (timestampUs - firstTimestampUs) - (getNowUs() - startUs);
+            if (waitUs > 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(waitUs));
+            }
+        }
+        
+        memset(featureInfo.get(), 0, sizeof(YADFeatureInfo));
+        int64_t beginUs = getNowUs();
+        int ret = detector->detect(&detectImage, &detectInfo, featureInfo.get());
+        int64_t latencyUs = getNowUs() - beginUs;
+        
+        if (stats) {
+            stats->frames++;
+            if (ret != YAD_OK) {
+                stats->failures++;
+            }
+            stats->latencies_us.push_back(latencyUs);
+        }
+        if (callback) {
+            callback(index, ret, *featureInfo, latencyUs);
+        }
+    }
+    
+    return YAD_OK;
+}
+
+}; // namespace yad
@@ -0,0 +1,131 @@
+//
+//  FrameRecorder.h
+//  YAD
+//
+
+#ifndef YAD_FRAME_RECORDER_H
+#define YAD_FRAME_RECORDER_H
+
+#include "YADetector.h"
+#include "FramePool.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace yad {
+
+// 录制文件格式(小端，与本机一致):
+//   文件头: YADRecordFileHeader
+//   帧:     YADRecordFrameHeader + 像素数据
+// 像素数据按行紧凑存储(去掉stride填充)，回放时再按录制时的stride还原，平面依次存放。
+
+#define YAD_RECORD_FILE_MAGIC       0x52444159  // "YADR"
+#define YAD_RECORD_FRAME_MAGIC      0x46444159  // "YADF"
+#define YAD_RECORD_VERSION          1
+#define YAD_RECORD_MAX_DIMENSION    16384       // 回放时接受的最大宽高，超出视为文件损坏
+
+typedef struct YADRecordFileHeader {
+    uint32_t magic;
+    uint32_t version;
+} YADRecordFileHeader;
+
+typedef struct YADRecordFrameHeader {
+    uint32_t magic;
+    uint32_t size;          // 像素数据字节数
+    int64_t timestamp_us;   // 采集时间，单位微秒
+    int32_t format;         // YADPixelFormat
+    int32_t width;
+    int32_t height;
+    int32_t stride;         // 录制时的步长，单位为字节
+    int32_t rotate_mode;    // YADRotateMode
+    int32_t type;           // YADDataType，YAD_DATA_TYPE_RAW_PLANES时回放同样以多平面给出，并保留crop
+    YADRecti crop;
+} YADRecordFrameHeader;
+
+// 帧录制器，支持YAD_DATA_TYPE_RAW和YAD_DATA_TYPE_RAW_PLANES，Apple平台额外支持YAD_DATA_TYPE_IOS_PIXEL_BUFFER
+class FrameRecorder {
+public:
+    FrameRecorder();
+    ~FrameRecorder();
+    
+    int open(const std::string &path);
+    void close();
+    bool isOpen() const;
+    // 写入一帧，timestampUs为采集时间
+    int write(const YADDetectImage *detectImage, const YADDetectInfo *detectInfo, int64_t timestampUs);
+    size_t getFrameCount() const;
+    
+private:
+    FrameRecorder(const FrameRecorder &);
+    FrameRecorder &operator=(const FrameRecorder &);
+    
+    int writeFrame(const YADDetectImage *detectImage, int rotateMode, int64_t timestampUs,
+                   const uint8_t *planes[], const int strides[], const YADRecti &crop);
+    
+    FILE *file_;
+    size_t frame_count_;
+};
+
+// 录制Detector，检测透传给实际的Detector，同时录制输入帧
+class RecordingDetector : public Detector {
+public:
+    RecordingDetector(Detector *detector, const std::string &path);
+    virtual ~RecordingDetector();
+    
+    int initCheck() const override;
+    int detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo) override;
+    int detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults) override;
+    YADLandmarkProfile getLandmarkProfile() const override;
+    
+private:
+    void record(YADDetectImage *detectImage, YADDetectInfo *detectInfo);
+    
+    std::unique_ptr<Detector> detector_;
+    std::mutex mutex_;
+    FrameRecorder recorder_;
+    int64_t start_us_;
+};
+
+// 回放统计
+typedef struct ReplayStats {
+    int frames;                         // 回放帧数
+    int failures;                       // detect失败帧数
+    std::vector<int64_t> latencies_us;  // 每帧detect耗时
+} ReplayStats;
+
+// 每帧回放完成后的回调
+typedef std::function<void(int index, int err, const YADFeatureInfo &featureInfo, int64_t latencyUs)> ReplayCallback;
+
+// 帧回放器，读取录制文件并重新送入Detector::detect，回放的数据类型为YAD_DATA_TYPE_RAW或YAD_DATA_TYPE_RAW_PLANES
+class FrameReplayer {
+public:
+    FrameReplayer();
+    ~FrameReplayer();
+    
+    int open(const std::string &path);
+    void close();
+    // 回到第一帧
+    int rewind();
+    // 读取下一帧，数据在下一次调用前有效，读完返回YAD_NOT_ENOUGH_DATA
+    int readFrame(YADDetectImage *detectImage, YADDetectInfo *detectInfo, int64_t *timestampUs);
+    // 回放所有帧，realtime为true时按录制的时间间隔送帧，否则尽可能快
+    int replay(Detector *detector, bool realtime, ReplayStats *stats, ReplayCallback callback = nullptr);
+    
+private:
+    FrameReplayer(const FrameReplayer &);
+    FrameReplayer &operator=(const FrameReplayer &);
+    
+    FILE *file_;
+    FrameBuffer packed_;    // 来自FramePool::getDefault()，跨帧复用
+    FrameBuffer buffer_;
+    YADRawPlanes raw_planes_;
+};
+
+}; // namespace yad
+
+#endif /* YAD_FRAME_RECORDER_H */
@@ -0,0 +1,159 @@
+//
+//  ImagePreprocess.cpp
+//  YAD
+//
+
+#include "ImagePreprocess.h"
+#include "WorkerPool.h"
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+namespace yad {
+
+// 源图第y行[x0, x1)的像素，转换为dstFormat后写入dst
+static int convertSegment(const ImagePlanes &planes, YADPixelFormat dstFormat, int y, int x0, int x1, uint8_t *dst)
+{
+    if (dstFormat == planes.format) {
+        int pixelSize = getPixelSize(dstFormat);
+        memcpy(dst, planes.planes[0] + (size_t)y * planes.strides[0] + (size_t)x0 * pixelSize,
+               (size_t)(x1 - x0) * pixelSize);
+        return YAD_OK;
+    }
+    return convertRowToRGB888(planes, y, x0, x1, dst);
+}
+
+template <int PixelSize>
+static void reversePixels(uint8_t *row, int width)
+{
+    uint8_t *left = row;
+    uint8_t *right = row + (size_t)(width - 1) * PixelSize;
+    uint8_t pixel[PixelSize];
+    for (; left < right; left += PixelSize, right -= PixelSize) {
+        memcpy(pixel, left, PixelSize);
+        memcpy(left, right, PixelSize);
+        memcpy(right, pixel, PixelSize);
+    }
+}
+
+// 把连续的count个像素依次写入从row开始、每次向下(step为正)或向上(step为负)一行的同一列
+template <int PixelSize>
+static void scatterColumn(const uint8_t *pixels, int count, uint8_t *row, ptrdiff_t step)
+{
+    for (int k = 0; k < count; k++, row += step, pixels += PixelSize) {
+        memcpy(row, pixels, PixelSize);
+    }
+}
+
+template <int PixelSize>
+static int convertTile(const ImagePlanes &planes, YADPixelFormat dstFormat, YADRotateMode rotateMode, uint8_t *dst,
+                       int dstStride, int y0, int y1)
+{
+    int width = planes.width;
+    int height = planes.height;
+    int err = YAD_OK;
+    uint8_t segment[YAD_PREPROCESS_TRANSPOSE_ROWS * PixelSize];
+    switch (rotateMode) {
+        case YAD_ROTATE_0:
+            for (int y = y0; y < y1 && err == YAD_OK; y++) {
+                err = convertSegment(planes, dstFormat, y, 0, width, dst + (size_t)y * dstStride);
+            }
+            break;
+        case YAD_ROTATE_180:
+            // 源行转换后原地反转
+            for (int y = y0; y < y1 && err == YAD_OK; y++) {
+                uint8_t *row = dst + (size_t)y * dstStride;
+                err = convertSegment(planes, dstFormat, height - 1 - y, 0, width, row);
+                reversePixels<PixelSize>(row, width);
+            }
+            break;
+        case YAD_ROTATE_90:
+            // 正向(x, y)取源图(y, height - 1 - x)：输出行[y0, y1)对应源图列[y0, y1)，
+            // 逐个源行连续读取这一段，转换后写入各输出行的同一列
+            for (int sy = 0; sy < height && err == YAD_OK; sy++) {
+                err = convertSegment(planes, dstFormat, sy, y0, y1, segment);
+                uint8_t *row = dst + (size_t)y0 * dstStride + (size_t)(height - 1 - sy) * PixelSize;
+                scatterColumn<PixelSize>(segment, y1 - y0, row, dstStride);
+            }
+            break;
+        case YAD_ROTATE_270: {
+            // 正向(x, y)取源图(width - 1 - y, x)：输出行[y0, y1)对应源图列[width - y1, width - y0)，逆序写入
+            int x0 = width - y1;
+            int x1 = width - y0;
+            for (int sy = 0; sy < height && err == YAD_OK; sy++) {
+                err = convertSegment(planes, dstFormat, sy, x0, x1, segment);
+                uint8_t *row = dst + (size_t)(y1 - 1) * dstStride + (size_t)sy * PixelSize;
+                scatterColumn<PixelSize>(segment, x1 - x0, row, -(ptrdiff_t)dstStride);
+            }
+            break;
+        }
+        default:
+            return YAD_ROTATE_UNSUPPORTED;
+    }
+    return err;
+}
+
+int convertToUpright(const ImagePlanes &planes, YADPixelFormat dstFormat, YADRotateMode rotateMode, uint8_t *dst,
+                     int dstStride, WorkerPool *pool)
+{
+    if (!dst || planes.width <= 0 || planes.height <= 0) {
+        return YAD_BAD_VALUE;
+    }
+    if (dstFormat != planes.format && dstFormat != YAD_PIX_FMT_RGB888) {
+        return YAD_FORMAT_UNSUPPORTED;
+    }
+    
+    // YUV只拼接，色度平面无法按像素旋转
+    if (isYUV420(planes.format) && dstFormat == planes.format) {
+        if (rotateMode != YAD_ROTATE_0) {
+            return YAD_ROTATE_UNSUPPORTED;
+        }
+        copyToContiguous(planes, dst, dstStride);
+        return YAD_OK;
+    }
+    
+    int pixelSize = getPixelSize(dstFormat);
+    bool swap = rotateMode == YAD_ROTATE_90 || rotateMode == YAD_ROTATE_270;
+    int dstWidth = swap ? planes.height : planes.width;
+    int dstHeight = swap ? planes.width : planes.height;
+    int tileRows = YAD_PREPROCESS_TRANSPOSE_ROWS;
+    if (!swap) {
+        tileRows = std::max(1, YAD_PREPROCESS_TILE_BYTES / (dstWidth * pixelSize));
+    }
+    int numTiles = (dstHeight + tileRows - 1) / tileRows;
+    
+    std::atomic<int> result(YAD_OK);
+    auto processTile = [&](int i) {
+        int y0 = i * tileRows;
+        int y1 = std::min(dstHeight, y0 + tileRows);
+        int err;
+        switch (pixelSize) {
+            case 2:
+                err = convertTile<2>(planes, dstFormat, rotateMode, dst, dstStride, y0, y1);
+                break;
+            case 3:
+                err = convertTile<3>(planes, dstFormat, rotateMode, dst, dstStride, y0, y1);
+                break;
+            case 4:
+                err = convertTile<4>(planes, dstFormat, rotateMode, dst, dstStride, y0, y1);
+                break;
+            default:
+                err = YAD_FORMAT_UNSUPPORTED;
+                break;
+        }
+        if (err != YAD_OK) {
+            result = err;
+        }
+    };
+    if (pool) {
+        pool->parallelFor(numTiles, processTile);
+    } else {
+        for (int i = 0; i < numTiles; i++) {
+            processTile(i);
+        }
+    }
+    return result;
+}
+
+}; // namespace yad
@@ -0,0 +1,27 @@
+//
+//  ImagePreprocess.h
+//  YAD
+//
+
+#ifndef YAD_IMAGE_PREPROCESS_H
+#define YAD_IMAGE_PREPROCESS_H
+
+#include "YADetector.h"
+#include "ImageUtils.h"
+
+namespace yad {
+
+class WorkerPool;
+
+#define YAD_PREPROCESS_TILE_BYTES       (64 << 10)  // 不旋转或旋转180度时每块输出的字节数，按L2缓存选取
+#define YAD_PREPROCESS_TRANSPOSE_ROWS   64          // 旋转90/270度时每块的输出行数，即每个源行连续读取的像素数
+
+// 把图像转换为dstFormat并旋转为正向，结果一次写入dst，dst的宽高在90/270时互换。
+// dstFormat为RGB888或者与源格式相同(只拼接)，YUV格式只支持不旋转的拼接。
+// 输出按行分块，每块独立地读取源图、转换、旋转后写入，不生成中间整帧；pool不为空时各块在线程池中并行
+int convertToUpright(const ImagePlanes &planes, YADPixelFormat dstFormat, YADRotateMode rotateMode, uint8_t *dst,
+                     int dstStride, WorkerPool *pool);
+
+}; // namespace yad
+
+#endif /* YAD_IMAGE_PREPROCESS_H */
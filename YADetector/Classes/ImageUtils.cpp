@@ -0,0 +1,644 @@
+//
+//  ImageUtils.cpp
+//  YAD
+//
+
+#include "ImageUtils.h"
+#include "Simd.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace yad {
+
+int getPixelSize(YADPixelFormat format)
+{
+    switch (format) {
+        case YAD_PIX_FMT_NV21:
+        case YAD_PIX_FMT_NV12:
+        case YAD_PIX_FMT_I420:
+            return 1;
+        case YAD_PIX_FMT_BGR888:
+        case YAD_PIX_FMT_RGB888:
+            return 3;
+        case YAD_PIX_FMT_BGRA8888:
+        case YAD_PIX_FMT_RGBA8888:
+            return 4;
+        case YAD_PIX_FMT_BGR565:
+        case YAD_PIX_FMT_RGB565:
+            return 2;
+        default:
+            break;
+    }
+    return 0;
+}
+
+bool isYUV420SP(YADPixelFormat format)
+{
+    return format == YAD_PIX_FMT_NV21 || format == YAD_PIX_FMT_NV12;
+}
+
+bool isYUV420(YADPixelFormat format)
+{
+    return isYUV420SP(format) || format == YAD_PIX_FMT_I420;
+}
+
+int getPlaneCount(YADPixelFormat format)
+{
+    if (isYUV420SP(format)) {
+        return 2;
+    } else if (format == YAD_PIX_FMT_I420) {
+        return 3;
+    }
+    return getPixelSize(format) > 0 ? 1 : 0;
+}
+
+bool getPlaneGeometry(YADPixelFormat format, int width, int height, int plane, int *rowBytes, int *rows)
+{
+    if (!rowBytes || !rows || width <= 0 || height <= 0 || plane < 0 || plane >= getPlaneCount(format)) {
+        return false;
+    }
+    
+    if (plane == 0) {
+        *rowBytes = width * getPixelSize(format);
+        *rows = height;
+    } else if (isYUV420SP(format)) {
+        // UV交错平面，宽高都是亮度平面的一半
+        *rowBytes = (width + 1) / 2 * 2;
+        *rows = (height + 1) / 2;
+    } else {
+        *rowBytes = (width + 1) / 2;
+        *rows = (height + 1) / 2;
+    }
+    return true;
+}
+
+int getPlaneStride(YADPixelFormat format, int stride, int plane)
+{
+    if (plane > 0 && format == YAD_PIX_FMT_I420) {
+        return stride / 2;
+    }
+    return stride;
+}
+
+size_t getImageSize(YADPixelFormat format, int height, int stride)
+{
+    if (height <= 0 || stride <= 0) {
+        return 0;
+    }
+    
+    size_t size = (size_t)stride * height;
+    int chromaRows = (height + 1) / 2;
+    if (isYUV420SP(format)) {
+        size += (size_t)stride * chromaRows;
+    } else if (format == YAD_PIX_FMT_I420) {
+        size += (size_t)getPlaneStride(format, stride, 1) * chromaRows * 2;
+    }
+    return size;
+}
+
+int getCompactStride(YADPixelFormat format, int width)
+{
+    int pixelSize = getPixelSize(format);
+    if (pixelSize <= 0 || width <= 0) {
+        return 0;
+    }
+    return isYUV420(format) ? (width + 1) / 2 * 2 : width * pixelSize;
+}
+
+bool checkImageStride(YADPixelFormat format, int width, int height, int stride)
+{
+    int pixelSize = getPixelSize(format);
+    if (pixelSize <= 0 || width <= 0 || height <= 0 || stride <= 0 || width > stride / pixelSize) {
+        return false;
+    }
+    
+    for (int i = 1; i < getPlaneCount(format); i++) {
+        int rowBytes, rows;
+        getPlaneGeometry(format, width, height, i, &rowBytes, &rows);
+        if (rowBytes > getPlaneStride(format, stride, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int getImagePlanes(const YADDetectImage *detectImage, ImagePlanes *planes)
+{
+    if (!detectImage || !planes || !detectImage->data) {
+        return YAD_BAD_VALUE;
+    }
+    
+    YADPixelFormat format = detectImage->format;
+    int planeCount = getPlaneCount(format);
+    if (planeCount <= 0) {
+        return YAD_FORMAT_UNSUPPORTED;
+    }
+    
+    memset(planes, 0, sizeof(ImagePlanes));
+    planes->format = format;
+    planes->width = detectImage->width;
+    planes->height = detectImage->height;
+    planes->num_planes = planeCount;
+    
+    if (detectImage->type == YAD_DATA_TYPE_RAW) {
+        // 平面连续存放，宽高和stride先检查，否则无法计算各平面的位置
+        if (!checkImageStride(format, planes->width, planes->height, detectImage->stride)) {
+            return YAD_BAD_VALUE;
+        }
+        const uint8_t *data = (const uint8_t *)detectImage->data;
+        for (int i = 0; i < planeCount; i++) {
+            int rowBytes, rows;
+            getPlaneGeometry(format, planes->width, planes->height, i, &rowBytes, &rows);
+            planes->planes[i] = data;
+            planes->strides[i] = getPlaneStride(format, detectImage->stride, i);
+            data += (size_t)planes->strides[i] * rows;
+        }
+        return YAD_OK;
+    }
+    
+    if (detectImage->type != YAD_DATA_TYPE_RAW_PLANES) {
+        return YAD_FORMAT_UNSUPPORTED;
+    }
+    
+    const YADRawPlanes *rawPlanes = (const YADRawPlanes *)detectImage->data;
+    if (rawPlanes->num_planes < planeCount) {
+        return YAD_BAD_VALUE;
+    }
+    
+    YADRecti crop = rawPlanes->crop;
+    if (crop.w <= 0 || crop.h <= 0) {
+        crop = {0, 0, detectImage->width, detectImage->height};
+    }
+    if (crop.x < 0 || crop.y < 0 || crop.x + crop.w > detectImage->width || crop.y + crop.h > detectImage->height) {
+        return YAD_BAD_VALUE;
+    }
+    if (isYUV420(format) && ((crop.x | crop.y) & 1)) {
+        return YAD_BAD_VALUE;
+    }
+    
+    planes->width = crop.w;
+    planes->height = crop.h;
+    planes->crop_x = crop.x;
+    planes->crop_y = crop.y;
+    for (int i = 0; i < planeCount; i++) {
+        if (!rawPlanes->planes[i]) {
+            return YAD_BAD_VALUE;
+        }
+        // 色度平面按采样比例换算偏移
+        int x = crop.x, y = crop.y;
+        int bytesPerPixel = getPixelSize(format);
+        if (i > 0) {
+            x /= 2;
+            y /= 2;
+            bytesPerPixel = isYUV420SP(format) ? 2 : 1;
+        }
+        planes->strides[i] = rawPlanes->strides[i];
+        planes->planes[i] = (const uint8_t *)rawPlanes->planes[i] + rawPlanes->offsets[i] +
+                            (size_t)y * rawPlanes->strides[i] + (size_t)x * bytesPerPixel;
+    }
+    return YAD_OK;
+}
+
+bool isContiguous(const ImagePlanes &planes)
+{
+    const uint8_t *expected = planes.planes[0];
+    for (int i = 0; i < planes.num_planes; i++) {
+        int rowBytes, rows;
+        getPlaneGeometry(planes.format, planes.width, planes.height, i, &rowBytes, &rows);
+        if (planes.planes[i] != expected || planes.strides[i] != getPlaneStride(planes.format, planes.strides[0], i)) {
+            return false;
+        }
+        expected += (size_t)planes.strides[i] * rows;
+    }
+    return true;
+}
+
+void copyToContiguous(const ImagePlanes &planes, uint8_t *dst, int dstStride)
+{
+    for (int i = 0; i < planes.num_planes; i++) {
+        int rowBytes, rows;
+        getPlaneGeometry(planes.format, planes.width, planes.height, i, &rowBytes, &rows);
+        int stride = getPlaneStride(planes.format, dstStride, i);
+        const uint8_t *src = planes.planes[i];
+        for (int y = 0; y < rows; y++) {
+            memcpy(dst + (size_t)y * stride, src + (size_t)y * planes.strides[i], rowBytes);
+        }
+        dst += (size_t)stride * rows;
+    }
+}
+
+static inline uint8_t clampToByte(int value)
+{
+    return (uint8_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// BT.601 video range
+static inline void yuvToRGB(int y, int u, int v, uint8_t *rgb)
+{
+    int c = 298 * (y - 16) + 128;
+    int d = u - 128;
+    int e = v - 128;
+    rgb[0] = clampToByte((c + 409 * e) >> 8);
+    rgb[1] = clampToByte((c - 100 * d - 208 * e) >> 8);
+    rgb[2] = clampToByte((c + 516 * d) >> 8);
+}
+
+void convertYUVToRGB(int y, int u, int v, uint8_t *rgb)
+{
+    yuvToRGB(y, u, v, rgb);
+}
+
+int convertRowToRGB888(const ImagePlanes &planes, int y, int x0, int x1, uint8_t *rgb)
+{
+    YADPixelFormat format = planes.format;
+    uint8_t *dst = rgb;
+    const uint8_t *src = planes.planes[0] + (size_t)y * planes.strides[0];
+    switch (format) {
+        case YAD_PIX_FMT_NV12:
+        case YAD_PIX_FMT_NV21: {
+            const uint8_t *uv = planes.planes[1] + (size_t)(y / 2) * planes.strides[1];
+            int uIndex = format == YAD_PIX_FMT_NV12 ? 0 : 1;
+            for (int x = x0; x < x1; x++, dst += 3) {
+                const uint8_t *chroma = uv + (x / 2) * 2;
+                yuvToRGB(src[x], chroma[uIndex], chroma[1 - uIndex], dst);
+            }
+            break;
+        }
+        case YAD_PIX_FMT_I420: {
+            const uint8_t *u = planes.planes[1] + (size_t)(y / 2) * planes.strides[1];
+            const uint8_t *v = planes.planes[2] + (size_t)(y / 2) * planes.strides[2];
+            for (int x = x0; x < x1; x++, dst += 3) {
+                yuvToRGB(src[x], u[x / 2], v[x / 2], dst);
+            }
+            break;
+        }
+        case YAD_PIX_FMT_RGB888:
+            memcpy(dst, src + x0 * 3, (size_t)(x1 - x0) * 3);
+            break;
+        case YAD_PIX_FMT_BGR888:
+        case YAD_PIX_FMT_BGRA8888:
+        case YAD_PIX_FMT_RGBA8888: {
+            int pixelSize = getPixelSize(format);
+            bool bgr = format != YAD_PIX_FMT_RGBA8888;
+            src += x0 * pixelSize;
+            for (int x = x0; x < x1; x++, dst += 3, src += pixelSize) {
+                dst[0] = bgr ? src[2] : src[0];
+                dst[1] = src[1];
+                dst[2] = bgr ? src[0] : src[2];
+            }
+            break;
+        }
+        case YAD_PIX_FMT_BGR565:
+        case YAD_PIX_FMT_RGB565: {
+            const uint16_t *row = (const uint16_t *)src;
+            bool bgr = format == YAD_PIX_FMT_BGR565;
+            for (int x = x0; x < x1; x++, dst += 3) {
+                uint16_t pixel = row[x];
+                uint8_t hi = (uint8_t)(((pixel >> 11) & 0x1f) << 3);
+                uint8_t mid = (uint8_t)(((pixel >> 5) & 0x3f) << 2);
+                uint8_t lo = (uint8_t)((pixel & 0x1f) << 3);
+                dst[0] = bgr ? lo : hi;
+                dst[1] = mid;
+                dst[2] = bgr ? hi : lo;
+            }
+            break;
+        }
+        default:
+            return YAD_FORMAT_UNSUPPORTED;
+    }
+    return YAD_OK;
+}
+
+int convertToRGB888(const ImagePlanes &planes, uint8_t *rgb, int rgbStride)
+{
+    if (!rgb) {
+        return YAD_BAD_VALUE;
+    }
+    
+    for (int y = 0; y < planes.height; y++) {
+        int err = convertRowToRGB888(planes, y, 0, planes.width, rgb + (size_t)y * rgbStride);
+        if (err != YAD_OK) {
+            return err;
+        }
+    }
+    return YAD_OK;
+}
+
+#define YAD_LUMA_R  66
+#define YAD_LUMA_G  129
+#define YAD_LUMA_B  25
+
+static inline uint8_t rgbToLuma(int r, int g, int b)
+{
+    return (uint8_t)(((YAD_LUMA_R * r + YAD_LUMA_G * g + YAD_LUMA_B * b + 128) >> 8) + 16);
+}
+
+// 一行RGB/BGR(A)像素的亮度，返回SIMD处理的像素个数，剩余像素由调用者按标量处理
+static int extractLumaRow(const uint8_t *src, uint8_t *dst, int width, int pixelSize, bool bgr)
+{
+    int x = 0;
+#if defined(YAD_SIMD_NEON)
+    uint8x8_t cr = vdup_n_u8(YAD_LUMA_R);
+    uint8x8_t cg = vdup_n_u8(YAD_LUMA_G);
+    uint8x8_t cb = vdup_n_u8(YAD_LUMA_B);
+    uint16x8_t round = vdupq_n_u16(128);
+    uint8x16_t offset = vdupq_n_u8(16);
+    for (; x + 16 <= width; x += 16, src += 16 * pixelSize) {
+        uint8x16_t c0, c1, c2;
+        if (pixelSize == 4) {
+            uint8x16x4_t pixels = vld4q_u8(src);
+            c0 = pixels.val[0];
+            c1 = pixels.val[1];
+            c2 = pixels.val[2];
+        } else {
+            uint8x16x3_t pixels = vld3q_u8(src);
+            c0 = pixels.val[0];
+            c1 = pixels.val[1];
+            c2 = pixels.val[2];
+        }
+        uint8x16_t r = bgr ? c2 : c0;
+        uint8x16_t b = bgr ? c0 : c2;
+        uint16x8_t lo = vmlal_u8(vmlal_u8(vmlal_u8(round, vget_low_u8(r), cr), vget_low_u8(c1), cg), vget_low_u8(b), cb);
+        uint16x8_t hi = vmlal_u8(vmlal_u8(vmlal_u8(round, vget_high_u8(r), cr), vget_high_u8(c1), cg), vget_high_u8(b), cb);
+        vst1q_u8(dst + x, vaddq_u8(vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)), offset));
+    }
+#elif defined(YAD_SIMD_SSE2)
+    // SSE2没有三通道的解交织，只处理四字节像素
+    if (pixelSize != 4) {
+        return 0;
+    }
+    short r = YAD_LUMA_R, g = YAD_LUMA_G, b = YAD_LUMA_B;
+    __m128i coeffs = bgr ? _mm_setr_epi16(b, g, r, 0, b, g, r, 0) : _mm_setr_epi16(r, g, b, 0, r, g, b, 0);
+    __m128i zero = _mm_setzero_si128();
+    __m128i round = _mm_set1_epi32(128);
+    __m128i offset = _mm_set1_epi16(16);
+    // 每次4个像素：两两相乘累加后，每个像素的和位于64位的低32位
+    auto luma4 = [&](const uint8_t *p) -> __m128i {
+        __m128i pixels = _mm_loadu_si128((const __m128i *)p);
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), coeffs);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), coeffs);
+        lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+        hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+        lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 3, 2, 0));
+        hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 3, 2, 0));
+        return _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi64(lo, hi), round), 8);
+    };
+    for (; x + 16 <= width; x += 16, src += 64) {
+        __m128i y0 = _mm_add_epi16(_mm_packs_epi32(luma4(src), luma4(src + 16)), offset);
+        __m128i y1 = _mm_add_epi16(_mm_packs_epi32(luma4(src + 32), luma4(src + 48)), offset);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(y0, y1));
+    }
+#endif
+    return x;
+}
+
+uint8_t getLumaAt(const ImagePlanes &planes, int x, int y)
+{
+    YADPixelFormat format = planes.format;
+    const uint8_t *row = planes.planes[0] + (size_t)y * planes.strides[0];
+    if (isYUV420(format)) {
+        return row[x];
+    }
+    
+    const uint8_t *src = row + (size_t)x * getPixelSize(format);
+    switch (format) {
+        case YAD_PIX_FMT_RGB888:
+        case YAD_PIX_FMT_RGBA8888:
+            return rgbToLuma(src[0], src[1], src[2]);
+        case YAD_PIX_FMT_BGR888:
+        case YAD_PIX_FMT_BGRA8888:
+            return rgbToLuma(src[2], src[1], src[0]);
+        case YAD_PIX_FMT_BGR565:
+        case YAD_PIX_FMT_RGB565: {
+            uint16_t pixel = *(const uint16_t *)src;
+            int hi = ((pixel >> 11) & 0x1f) << 3;
+            int mid = ((pixel >> 5) & 0x3f) << 2;
+            int lo = (pixel & 0x1f) << 3;
+            return format == YAD_PIX_FMT_BGR565 ? rgbToLuma(lo, mid, hi) : rgbToLuma(hi, mid, lo);
+        }
+        default:
+            return 0;
+    }
+}
+
+void getRGBAt(const ImagePlanes &planes, int x, int y, uint8_t *rgb)
+{
+    YADPixelFormat format = planes.format;
+    const uint8_t *row = planes.planes[0] + (size_t)y * planes.strides[0];
+    switch (format) {
+        case YAD_PIX_FMT_NV12:
+        case YAD_PIX_FMT_NV21: {
+            const uint8_t *chroma = planes.planes[1] + (size_t)(y / 2) * planes.strides[1] + (x / 2) * 2;
+            int uIndex = format == YAD_PIX_FMT_NV12 ? 0 : 1;
+            yuvToRGB(row[x], chroma[uIndex], chroma[1 - uIndex], rgb);
+            break;
+        }
+        case YAD_PIX_FMT_I420: {
+            const uint8_t *u = planes.planes[1] + (size_t)(y / 2) * planes.strides[1];
+            const uint8_t *v = planes.planes[2] + (size_t)(y / 2) * planes.strides[2];
+            yuvToRGB(row[x], u[x / 2], v[x / 2], rgb);
+            break;
+        }
+        case YAD_PIX_FMT_RGB888:
+        case YAD_PIX_FMT_RGBA8888:
+        case YAD_PIX_FMT_BGR888:
+        case YAD_PIX_FMT_BGRA8888: {
+            const uint8_t *src = row + (size_t)x * getPixelSize(format);
+            bool bgr = format == YAD_PIX_FMT_BGR888 || format == YAD_PIX_FMT_BGRA8888;
+            rgb[0] = bgr ? src[2] : src[0];
+            rgb[1] = src[1];
+            rgb[2] = bgr ? src[0] : src[2];
+            break;
+        }
+        case YAD_PIX_FMT_BGR565:
+        case YAD_PIX_FMT_RGB565: {
+            uint16_t pixel = ((const uint16_t *)row)[x];
+            uint8_t hi = (uint8_t)(((pixel >> 11) & 0x1f) << 3);
+            uint8_t mid = (uint8_t)(((pixel >> 5) & 0x3f) << 2);
+            uint8_t lo = (uint8_t)((pixel & 0x1f) << 3);
+            bool bgr = format == YAD_PIX_FMT_BGR565;
+            rgb[0] = bgr ? lo : hi;
+            rgb[1] = mid;
+            rgb[2] = bgr ? hi : lo;
+            break;
+        }
+        default:
+            rgb[0] = rgb[1] = rgb[2] = 0;
+            break;
+    }
+}
+
+int extractLuma(const ImagePlanes &planes, uint8_t *gray, int grayStride)
+{
+    if (!gray) {
+        return YAD_BAD_VALUE;
+    }
+    
+    YADPixelFormat format = planes.format;
+    if (isYUV420(format)) {
+        for (int y = 0; y < planes.height; y++) {
+            memcpy(gray + (size_t)y * grayStride, planes.planes[0] + (size_t)y * planes.strides[0], planes.width);
+        }
+        return YAD_OK;
+    }
+    
+    int pixelSize = getPixelSize(format);
+    bool bgr = format == YAD_PIX_FMT_BGR888 || format == YAD_PIX_FMT_BGRA8888;
+    for (int y = 0; y < planes.height; y++) {
+        uint8_t *dst = gray + (size_t)y * grayStride;
+        const uint8_t *src = planes.planes[0] + (size_t)y * planes.strides[0];
+        switch (format) {
+            case YAD_PIX_FMT_RGB888:
+            case YAD_PIX_FMT_BGR888:
+            case YAD_PIX_FMT_RGBA8888:
+            case YAD_PIX_FMT_BGRA8888: {
+                int x = extractLumaRow(src, dst, planes.width, pixelSize, bgr);
+                for (src += (size_t)x * pixelSize; x < planes.width; x++, src += pixelSize) {
+                    dst[x] = bgr ? rgbToLuma(src[2], src[1], src[0]) : rgbToLuma(src[0], src[1], src[2]);
+                }
+                break;
+            }
+            case YAD_PIX_FMT_BGR565:
+            case YAD_PIX_FMT_RGB565: {
+                const uint16_t *row = (const uint16_t *)src;
+                bool swap = format == YAD_PIX_FMT_BGR565;
+                for (int x = 0; x < planes.width; x++) {
+                    uint16_t pixel = row[x];
+                    int hi = ((pixel >> 11) & 0x1f) << 3;
+                    int mid = ((pixel >> 5) & 0x3f) << 2;
+                    int lo = (pixel & 0x1f) << 3;
+                    dst[x] = swap ? rgbToLuma(lo, mid, hi) : rgbToLuma(hi, mid, lo);
+                }
+                break;
+            }
+            default:
+                return YAD_FORMAT_UNSUPPORTED;
+        }
+    }
+    return YAD_OK;
+}
+
+uint64_t sumAbsDiff(const uint8_t *a, const uint8_t *b, size_t size)
+{
+    uint64_t sum = 0;
+    size_t i = 0;
+#if defined(YAD_SIMD_NEON)
+    // 每次16字节，16位累加器每个通道最多累加到255*2*128，分块避免溢出
+    while (i + 16 <= size) {
+        uint16x8_t acc = vdupq_n_u16(0);
+        size_t end = std::min(size & ~(size_t)15, i + 16 * 128);
+        for (; i < end; i += 16) {
+            uint8x16_t diff = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+            acc = vpadalq_u8(acc, diff);
+        }
+        uint64x2_t total = vpaddlq_u32(vpaddlq_u16(acc));
+        sum += vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1);
+    }
+#elif defined(YAD_SIMD_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    sum = lanes[0] + lanes[1];
+#endif
+    for (; i < size; i++) {
+        sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    }
+    return sum;
+}
+
+void offsetFaceResults(YADFaceResults *faceResults, float dx, float dy)
+{
+    if (!faceResults || (dx == 0.0f && dy == 0.0f)) {
+        return;
+    }
+    
+    for (int i = 0; i < faceResults->num_faces; i++) {
+        YADFaceInfo *faceInfo = &(faceResults->faces[i]);
+        faceInfo->rect.x += dx;
+        faceInfo->rect.y += dy;
+        for (int j = 0; j < YAD_FACE_LANDMARK_NUM; j++) {
+            faceInfo->landmarks[j].x += dx;
+            faceInfo->landmarks[j].y += dy;
+        }
+    }
+}
+
+int rotateToUpright(const uint8_t *src, int width, int height, int stride, int pixelSize, YADRotateMode rotateMode,
+                    uint8_t *dst, int dstStride)
+{
+    if (!src || !dst || pixelSize <= 0) {
+        return YAD_BAD_VALUE;
+    }
+    
+    // 正向图像(x, y)对应原图的坐标，与mapFaceResultsToSource一致
+    bool swap = rotateMode == YAD_ROTATE_90 || rotateMode == YAD_ROTATE_270;
+    int dstWidth = swap ? height : width;
+    int dstHeight = swap ? width : height;
+    for (int y = 0; y < dstHeight; y++) {
+        uint8_t *row = dst + (size_t)y * dstStride;
+        switch (rotateMode) {
+            case YAD_ROTATE_0:
+                memcpy(row, src + (size_t)y * stride, (size_t)width * pixelSize);
+                break;
+            case YAD_ROTATE_90:
+                for (int x = 0; x < dstWidth; x++) {
+                    memcpy(row + x * pixelSize, src + (size_t)(dstWidth - 1 - x) * stride + y * pixelSize, pixelSize);
+                }
+                break;
+            case YAD_ROTATE_180: {
+                const uint8_t *srcRow = src + (size_t)(height - 1 - y) * stride;
+                for (int x = 0; x < dstWidth; x++) {
+                    memcpy(row + x * pixelSize, srcRow + (width - 1 - x) * pixelSize, pixelSize);
+                }
+                break;
+            }
+            case YAD_ROTATE_270:
+                for (int x = 0; x < dstWidth; x++) {
+                    memcpy(row + x * pixelSize, src + (size_t)x * stride + (dstHeight - 1 - y) * pixelSize, pixelSize);
+                }
+                break;
+            default:
+                return YAD_ROTATE_UNSUPPORTED;
+        }
+    }
+    return YAD_OK;
+}
+
+void mapFaceResultsToSource(YADFaceResults *faceResults, YADRotateMode rotateMode, int width, int height)
+{
+    if (!faceResults || rotateMode == YAD_ROTATE_0) {
+        return;
+    }
+    
+    auto map = [&](float x, float y) -> YADPoint2f {
+        switch (rotateMode) {
+            case YAD_ROTATE_90:
+                return {y, width - x};
+            case YAD_ROTATE_180:
+                return {width - x, height - y};
+            case YAD_ROTATE_270:
+                return {height - y, x};
+            default:
+                return {x, y};
+        }
+    };
+    
+    for (int i = 0; i < faceResults->num_faces; i++) {
+        YADFaceInfo *faceInfo = &(faceResults->faces[i]);
+        for (int j = 0; j < YAD_FACE_LANDMARK_NUM; j++) {
+            faceInfo->landmarks[j] = map(faceInfo->landmarks[j].x, faceInfo->landmarks[j].y);
+        }
+        YADPoint2f p1 = map(faceInfo->rect.x, faceInfo->rect.y);
+        YADPoint2f p2 = map(faceInfo->rect.x + faceInfo->rect.w, faceInfo->rect.y + faceInfo->rect.h);
+        faceInfo->rect = {std::min(p1.x, p2.x), std::min(p1.y, p2.y), fabsf(p2.x - p1.x), fabsf(p2.y - p1.y)};
+    }
+}
+
+}; // namespace yad
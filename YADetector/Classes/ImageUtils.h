@@ -0,0 +1,76 @@
+//
+//  ImageUtils.h
+//  YAD
+//
+
+#ifndef YAD_IMAGE_UTILS_H
+#define YAD_IMAGE_UTILS_H
+
+#include "YADetector.h"
+#include <stddef.h>
+#include <stdint.h>
+
+namespace yad {
+
+// 图像各平面的统一视图，由YAD_DATA_TYPE_RAW或YAD_DATA_TYPE_RAW_PLANES得到，已经应用了crop
+typedef struct {
+    YADPixelFormat format;
+    int width;
+    int height;
+    int num_planes;
+    const uint8_t *planes[YAD_MAX_PLANE_NUM];
+    int strides[YAD_MAX_PLANE_NUM];
+    int crop_x;     // 视图在整幅图像中的偏移，用于还原结果坐标
+    int crop_y;
+} ImagePlanes;
+
+// 获取像素字节数，YUV格式返回亮度平面的字节数
+int getPixelSize(YADPixelFormat format);
+// 是否为YUV420半平面格式(NV12/NV21)
+bool isYUV420SP(YADPixelFormat format);
+// 是否为YUV420格式(NV12/NV21/I420)
+bool isYUV420(YADPixelFormat format);
+// 获取平面个数
+int getPlaneCount(YADPixelFormat format);
+// 获取平面每行有效字节数和行数，失败返回false
+bool getPlaneGeometry(YADPixelFormat format, int width, int height, int plane, int *rowBytes, int *rows);
+// 连续内存图像(YAD_DATA_TYPE_RAW)中平面的步长，I420的色度平面为亮度的一半
+int getPlaneStride(YADPixelFormat format, int stride, int plane);
+// 获取连续内存图像(YAD_DATA_TYPE_RAW)的总字节数
+size_t getImageSize(YADPixelFormat format, int height, int stride);
+// 紧凑存放时亮度平面的最小步长，YUV420奇数宽度时向上取偶，保证色度平面的一行放得下
+int getCompactStride(YADPixelFormat format, int width);
+// 连续内存图像的每个平面一行是否都放得下有效像素，宽高和stride来自不可信的输入时先检查
+bool checkImageStride(YADPixelFormat format, int width, int height, int stride);
+
+// 获取平面视图，不拷贝数据。宽高或stride非法(见checkImageStride)、裁剪超出图像时返回YAD_BAD_VALUE
+int getImagePlanes(const YADDetectImage *detectImage, ImagePlanes *planes);
+// 平面是否按YAD_DATA_TYPE_RAW的布局连续存放
+bool isContiguous(const ImagePlanes &planes);
+// 把各平面按YAD_DATA_TYPE_RAW的布局拷贝到dst，dstStride为亮度平面步长
+void copyToContiguous(const ImagePlanes &planes, uint8_t *dst, int dstStride);
+// 单个YUV(BT.601 video range)像素转换为RGB
+void convertYUVToRGB(int y, int u, int v, uint8_t *rgb);
+// 直接从各平面读取并转换为RGB888，不需要先拼接平面
+int convertToRGB888(const ImagePlanes &planes, uint8_t *rgb, int rgbStride);
+// 把第y行的[x0, x1)像素转换为RGB888，写入rgb，不检查坐标
+int convertRowToRGB888(const ImagePlanes &planes, int y, int x0, int x1, uint8_t *rgb);
+// 单个像素的亮度(BT.601 video range)，不检查坐标
+uint8_t getLumaAt(const ImagePlanes &planes, int x, int y);
+// 单个像素转换为RGB，写入rgb[0..2]，不检查坐标
+void getRGBAt(const ImagePlanes &planes, int x, int y, uint8_t *rgb);
+// 提取亮度(BT.601 video range)到gray，YUV格式直接拷贝Y平面，RGB格式使用SIMD计算
+int extractLuma(const ImagePlanes &planes, uint8_t *gray, int grayStride);
+// 两块内存的绝对差之和(SAD)，使用SIMD计算
+uint64_t sumAbsDiff(const uint8_t *a, const uint8_t *b, size_t size);
+// 人脸坐标整体平移
+void offsetFaceResults(YADFaceResults *faceResults, float dx, float dy);
+// 把打包格式(非YUV)的图像按rotateMode旋转为正向，width/height为原图尺寸，dst的宽高在90/270时互换
+int rotateToUpright(const uint8_t *src, int width, int height, int stride, int pixelSize, YADRotateMode rotateMode,
+                    uint8_t *dst, int dstStride);
+// 把正向图像上的人脸坐标映射回原图，width/height为正向图像的尺寸
+void mapFaceResultsToSource(YADFaceResults *faceResults, YADRotateMode rotateMode, int width, int height);
+
+}; // namespace yad
+
+#endif /* YAD_IMAGE_UTILS_H */
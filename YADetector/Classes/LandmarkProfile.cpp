@@ -0,0 +1,98 @@
+//
+//  LandmarkProfile.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADLandmark"
+#include "LogMacros.h"
+
+#include "LandmarkProfile.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+namespace yad {
+
+bool isValidLandmarkProfile(int profile)
+{
+    return profile == YAD_LANDMARK_PROFILE_5 || profile == YAD_LANDMARK_PROFILE_68 ||
+           profile == YAD_LANDMARK_PROFILE_106;
+}
+
+const uint8_t *getLandmarkIndices(YADLandmarkProfile profile)
+{
+    switch (profile) {
+        case YAD_LANDMARK_PROFILE_5:
+            return kLandmarkIndices5;
+        case YAD_LANDMARK_PROFILE_68:
+            return kLandmarkIndices68;
+        default:
+            return nullptr;
+    }
+}
+
+int getConfigLandmarkProfile(YADConfig &config, YADLandmarkProfile *profile)
+{
+    *profile = YAD_LANDMARK_PROFILE_106;
+    auto it = config.find(kYADLandmarkProfile);
+    if (it == config.end() || it->second.empty()) {
+        return YAD_OK;
+    }
+    
+    int value = atoi(it->second.c_str());
+    if (!isValidLandmarkProfile(value)) {
+        YLOGE("invalid landmark profile: %s", it->second.c_str());
+        return YAD_BAD_VALUE;
+    }
+    *profile = (YADLandmarkProfile)value;
+    return YAD_OK;
+}
+
+// 点数和下标在编译期确定，循环可以完全展开
+template <size_t Count>
+static inline void copySubset(const YADPoint2f *src, const uint8_t (&indices)[Count], YADPoint2f *dst)
+{
+    for (size_t i = 0; i < Count; i++) {
+        dst[i] = src[indices[i]];
+    }
+}
+
+int extractLandmarks(const YADFaceResults *faceResults, YADLandmarkResults *landmarkResults)
+{
+    if (!faceResults || !landmarkResults || !isValidLandmarkProfile(landmarkResults->profile)) {
+        return YAD_BAD_VALUE;
+    }
+    if (landmarkResults->capacity > 0 && (!landmarkResults->faces || !landmarkResults->landmarks)) {
+        return YAD_BAD_VALUE;
+    }
+    
+    int numFaces = std::min(faceResults->num_faces, landmarkResults->capacity);
+    for (int i = 0; i < numFaces; i++) {
+        const YADFaceInfo &src = faceResults->faces[i];
+        YADFaceBox &box = landmarkResults->faces[i];
+        box.track_id = src.track_id;
+        box.rect = src.rect;
+        box.yaw = src.yaw;
+        box.pitch = src.pitch;
+        box.roll = src.roll;
+        
+        YADPoint2f *dst = landmarkResults->landmarks + (size_t)i * landmarkResults->profile;
+        switch (landmarkResults->profile) {
+            case YAD_LANDMARK_PROFILE_5:
+                copySubset(src.landmarks, kLandmarkIndices5, dst);
+                break;
+            case YAD_LANDMARK_PROFILE_68:
+                copySubset(src.landmarks, kLandmarkIndices68, dst);
+                break;
+            default:
+                memcpy(dst, src.landmarks, sizeof(YADPoint2f) * YAD_FACE_LANDMARK_NUM);
+                break;
+        }
+    }
+    landmarkResults->num_faces = numFaces;
+    return YAD_OK;
+}
+
+}; // namespace yad
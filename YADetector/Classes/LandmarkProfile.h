@@ -0,0 +1,56 @@
+//
+//  LandmarkProfile.h
+//  YAD
+//
+
+#ifndef YAD_LANDMARK_PROFILE_H
+#define YAD_LANDMARK_PROFILE_H
+
+#include "YADetector.h"
+
+#include <stdint.h>
+
+namespace yad {
+
+// 106点定义中有特定含义的点，插件、人脸对齐和子集共用
+#define YAD_LANDMARK_CONTOUR_LEFT   0
+#define YAD_LANDMARK_CONTOUR_RIGHT  32
+#define YAD_LANDMARK_NOSE_TIP       46
+#define YAD_LANDMARK_MOUTH_LEFT     84
+#define YAD_LANDMARK_MOUTH_TOP      87
+#define YAD_LANDMARK_MOUTH_RIGHT    90
+#define YAD_LANDMARK_LEFT_PUPIL     104
+#define YAD_LANDMARK_RIGHT_PUPIL    105
+
+// 各子集在106点中的下标，编译期常量。
+// 5点也是FaceAligner的对齐点，插件在任何子集下都要输出这5个点
+static constexpr uint8_t kLandmarkIndices5[YAD_LANDMARK_PROFILE_5] = {
+    YAD_LANDMARK_LEFT_PUPIL, YAD_LANDMARK_RIGHT_PUPIL,
+    YAD_LANDMARK_NOSE_TIP,
+    YAD_LANDMARK_MOUTH_LEFT, YAD_LANDMARK_MOUTH_RIGHT,
+};
+
+static constexpr uint8_t kLandmarkIndices68[YAD_LANDMARK_PROFILE_68] = {
+    0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30, 32,  // 轮廓，隔点取
+    33, 34, 35, 36, 37,             // 左眉
+    38, 39, 40, 41, 42,             // 右眉
+    43, 44, 45, 46,                 // 鼻梁
+    47, 48, 49, 50, 51,             // 鼻底
+    52, 53, 54, 55, 56, 57,         // 左眼
+    58, 59, 60, 61, 62, 63,         // 右眼
+    84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95,                 // 外唇
+    96, 97, 98, 99, 100, 101, 102, 103,                             // 内唇
+};
+
+// 是否为支持的子集
+bool isValidLandmarkProfile(int profile);
+// 子集在106点中的下标，106返回nullptr表示全部
+const uint8_t *getLandmarkIndices(YADLandmarkProfile profile);
+// 读取配置kYADLandmarkProfile，没有配置时返回YAD_LANDMARK_PROFILE_106，无效值返回YAD_BAD_VALUE
+int getConfigLandmarkProfile(YADConfig &config, YADLandmarkProfile *profile);
+// 把完整结果中的子集拷贝到紧凑结果，人脸个数取两者容量的较小值
+int extractLandmarks(const YADFaceResults *faceResults, YADLandmarkResults *landmarkResults);
+
+}; // namespace yad
+
+#endif /* YAD_LANDMARK_PROFILE_H */
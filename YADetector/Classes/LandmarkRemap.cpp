@@ -0,0 +1,172 @@
+//
+//  LandmarkRemap.cpp
+//  YAD
+//
+
+#include "LandmarkRemap.h"
+#include "Simd.h"
+
+namespace yad {
+
+// iBUG 68点，106点中68点没有的点(眉毛下沿、眼睛中心、鼻翼)由相邻点插值近似
+static constexpr LandmarkRemap makeLandmarkRemap68()
+{
+    LandmarkRemap remap = {};
+    remap.source_count = 68;
+    // 轮廓17点为106点轮廓的偶数点，奇数点取中点
+    for (int i = 0; i < 17; i++) {
+        setLandmarkTaps(remap, i * 2, i, 1.0f);
+        if (i < 16) {
+            setLandmarkTaps(remap, i * 2 + 1, i, 0.5f, i + 1, 0.5f);
+        }
+    }
+    copyLandmarkRange(remap, 33, 17, 5);    // 左眉上沿
+    copyLandmarkRange(remap, 38, 22, 5);    // 右眉上沿
+    copyLandmarkRange(remap, 43, 27, 4);    // 鼻梁
+    copyLandmarkRange(remap, 47, 31, 5);    // 鼻底
+    copyLandmarkRange(remap, 52, 36, 6);    // 左眼
+    copyLandmarkRange(remap, 58, 42, 6);    // 右眼
+    // 眉毛下沿，从上沿向眼睛方向偏移
+    setLandmarkTaps(remap, 64, 18, 0.8f, 36, 0.2f);
+    setLandmarkTaps(remap, 65, 19, 0.8f, 37, 0.2f);
+    setLandmarkTaps(remap, 66, 20, 0.8f, 38, 0.2f);
+    setLandmarkTaps(remap, 67, 21, 0.8f, 39, 0.2f);
+    setLandmarkTaps(remap, 68, 22, 0.8f, 42, 0.2f);
+    setLandmarkTaps(remap, 69, 23, 0.8f, 43, 0.2f);
+    setLandmarkTaps(remap, 70, 24, 0.8f, 44, 0.2f);
+    setLandmarkTaps(remap, 71, 25, 0.8f, 45, 0.2f);
+    // 眼睛上下中点和中心
+    setLandmarkTaps(remap, 72, 37, 0.5f, 38, 0.5f);
+    setLandmarkTaps(remap, 73, 40, 0.5f, 41, 0.5f);
+    setLandmarkTaps(remap, 74, 37, 0.25f, 38, 0.25f, 40, 0.25f, 41, 0.25f);
+    setLandmarkTaps(remap, 75, 43, 0.5f, 44, 0.5f);
+    setLandmarkTaps(remap, 76, 46, 0.5f, 47, 0.5f);
+    setLandmarkTaps(remap, 77, 43, 0.25f, 44, 0.25f, 46, 0.25f, 47, 0.25f);
+    // 鼻翼
+    setLandmarkTaps(remap, 78, 29, 0.5f, 31, 0.5f);
+    setLandmarkTaps(remap, 79, 29, 0.5f, 35, 0.5f);
+    setLandmarkTaps(remap, 80, 31, 1.2f, 33, -0.2f);
+    setLandmarkTaps(remap, 81, 35, 1.2f, 33, -0.2f);
+    setLandmarkTaps(remap, 82, 32, 0.5f, 33, 0.5f);
+    setLandmarkTaps(remap, 83, 33, 0.5f, 34, 0.5f);
+    copyLandmarkRange(remap, 84, 48, 12);   // 外唇
+    copyLandmarkRange(remap, 96, 60, 8);    // 内唇
+    // 瞳孔取眼睛中心
+    setLandmarkTaps(remap, 104, 37, 0.25f, 38, 0.25f, 40, 0.25f, 41, 0.25f);
+    setLandmarkTaps(remap, 105, 43, 0.25f, 44, 0.25f, 46, 0.25f, 47, 0.25f);
+    return remap;
+}
+
+// WFLW 98点，与106点只差眼睛中心和鼻翼
+static constexpr LandmarkRemap makeLandmarkRemap98()
+{
+    LandmarkRemap remap = {};
+    remap.source_count = 98;
+    copyLandmarkRange(remap, 0, 0, 33);     // 轮廓
+    copyLandmarkRange(remap, 33, 33, 5);    // 左眉上沿
+    copyLandmarkRange(remap, 38, 42, 5);    // 右眉上沿
+    copyLandmarkRange(remap, 43, 51, 4);    // 鼻梁
+    copyLandmarkRange(remap, 47, 55, 5);    // 鼻底
+    // 98点的眼睛为8点，上下中点单独放在72、73和75、76
+    setLandmarkTaps(remap, 52, 60, 1.0f);
+    setLandmarkTaps(remap, 53, 61, 1.0f);
+    setLandmarkTaps(remap, 72, 62, 1.0f);
+    setLandmarkTaps(remap, 54, 63, 1.0f);
+    setLandmarkTaps(remap, 55, 64, 1.0f);
+    setLandmarkTaps(remap, 56, 65, 1.0f);
+    setLandmarkTaps(remap, 73, 66, 1.0f);
+    setLandmarkTaps(remap, 57, 67, 1.0f);
+    setLandmarkTaps(remap, 58, 68, 1.0f);
+    setLandmarkTaps(remap, 59, 69, 1.0f);
+    setLandmarkTaps(remap, 75, 70, 1.0f);
+    setLandmarkTaps(remap, 60, 71, 1.0f);
+    setLandmarkTaps(remap, 61, 72, 1.0f);
+    setLandmarkTaps(remap, 62, 73, 1.0f);
+    setLandmarkTaps(remap, 76, 74, 1.0f);
+    setLandmarkTaps(remap, 63, 75, 1.0f);
+    copyLandmarkRange(remap, 64, 38, 4);    // 左眉下沿
+    copyLandmarkRange(remap, 68, 47, 4);    // 右眉下沿
+    setLandmarkTaps(remap, 74, 96, 1.0f);
+    setLandmarkTaps(remap, 77, 97, 1.0f);
+    // 鼻翼
+    setLandmarkTaps(remap, 78, 53, 0.5f, 55, 0.5f);
+    setLandmarkTaps(remap, 79, 53, 0.5f, 59, 0.5f);
+    setLandmarkTaps(remap, 80, 55, 1.0f);
+    setLandmarkTaps(remap, 81, 59, 1.0f);
+    setLandmarkTaps(remap, 82, 56, 0.5f, 57, 0.5f);
+    setLandmarkTaps(remap, 83, 57, 0.5f, 58, 0.5f);
+    copyLandmarkRange(remap, 84, 76, 12);   // 外唇
+    copyLandmarkRange(remap, 96, 88, 8);    // 内唇
+    setLandmarkTaps(remap, 104, 96, 1.0f);
+    setLandmarkTaps(remap, 105, 97, 1.0f);
+    return remap;
+}
+
+static constexpr LandmarkRemap kLandmarkRemap68 = makeLandmarkRemap68();
+static constexpr LandmarkRemap kLandmarkRemap98 = makeLandmarkRemap98();
+static_assert(isValidLandmarkRemap(kLandmarkRemap68), "invalid 68 to 106 landmark remap");
+static_assert(isValidLandmarkRemap(kLandmarkRemap98), "invalid 98 to 106 landmark remap");
+
+const LandmarkRemap *getLandmarkRemap(int sourceCount)
+{
+    switch (sourceCount) {
+        case 68:
+            return &kLandmarkRemap68;
+        case 98:
+            return &kLandmarkRemap98;
+        default:
+            return nullptr;
+    }
+}
+
+// src和dst都是x、y交错的浮点数
+static void remapFace(const LandmarkRemap &remap, const float *src, float *dst)
+{
+    int t = 0;
+#if defined(YAD_SIMD_SSE2)
+    // 一次计算两个目标点，每个抽头把两个源点的x、y装入一个寄存器
+    for (; t + 2 <= YAD_FACE_LANDMARK_NUM; t += 2) {
+        const LandmarkTap &a = remap.taps[t];
+        const LandmarkTap &b = remap.taps[t + 1];
+        __m128 sum = _mm_setzero_ps();
+        for (int k = 0; k < YAD_LANDMARK_TAP_NUM; k++) {
+            __m128 points = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)(src + a.index[k] * 2));
+            points = _mm_loadh_pi(points, (const __m64 *)(src + b.index[k] * 2));
+            __m128 weights = _mm_setr_ps(a.weight[k], a.weight[k], b.weight[k], b.weight[k]);
+            sum = _mm_add_ps(sum, _mm_mul_ps(points, weights));
+        }
+        _mm_storeu_ps(dst + t * 2, sum);
+    }
+#elif defined(YAD_SIMD_NEON)
+    for (; t + 2 <= YAD_FACE_LANDMARK_NUM; t += 2) {
+        const LandmarkTap &a = remap.taps[t];
+        const LandmarkTap &b = remap.taps[t + 1];
+        float32x4_t sum = vdupq_n_f32(0.0f);
+        for (int k = 0; k < YAD_LANDMARK_TAP_NUM; k++) {
+            float32x4_t points = vcombine_f32(vld1_f32(src + a.index[k] * 2), vld1_f32(src + b.index[k] * 2));
+            float32x4_t weights = vcombine_f32(vdup_n_f32(a.weight[k]), vdup_n_f32(b.weight[k]));
+            sum = vmlaq_f32(sum, points, weights);
+        }
+        vst1q_f32(dst + t * 2, sum);
+    }
+#endif
+    for (; t < YAD_FACE_LANDMARK_NUM; t++) {
+        const LandmarkTap &tap = remap.taps[t];
+        float x = 0.0f, y = 0.0f;
+        for (int k = 0; k < YAD_LANDMARK_TAP_NUM; k++) {
+            x += src[tap.index[k] * 2] * tap.weight[k];
+            y += src[tap.index[k] * 2 + 1] * tap.weight[k];
+        }
+        dst[t * 2] = x;
+        dst[t * 2 + 1] = y;
+    }
+}
+
+void remapLandmarks(const LandmarkRemap &remap, const YADPoint2f *src, int numFaces, YADFaceInfo *faces)
+{
+    for (int i = 0; i < numFaces; i++) {
+        remapFace(remap, (const float *)(src + (size_t)i * remap.source_count), (float *)faces[i].landmarks);
+    }
+}
+
+}; // namespace yad
@@ -0,0 +1,77 @@
+//
+//  LandmarkRemap.h
+//  YAD
+//
+
+#ifndef YAD_LANDMARK_REMAP_H
+#define YAD_LANDMARK_REMAP_H
+
+#include "YADetector.h"
+
+#include <stdint.h>
+
+namespace yad {
+
+#define YAD_LANDMARK_TAP_NUM    4   // 每个目标点最多由几个源点加权得到
+
+// 106点中的一个目标点，等于源点的加权和，权重之和为1，未使用的抽头权重为0
+typedef struct LandmarkTap {
+    uint8_t index[YAD_LANDMARK_TAP_NUM];
+    float weight[YAD_LANDMARK_TAP_NUM];
+} LandmarkTap;
+
+// 其它关键点布局到106点的换算表，用下面的constexpr函数在编译期生成
+typedef struct LandmarkRemap {
+    int source_count;   // 源布局的点数
+    LandmarkTap taps[YAD_FACE_LANDMARK_NUM];
+} LandmarkRemap;
+
+constexpr void setLandmarkTaps(LandmarkRemap &remap, int target, int i0, float w0, int i1 = 0, float w1 = 0.0f,
+                               int i2 = 0, float w2 = 0.0f, int i3 = 0, float w3 = 0.0f)
+{
+    LandmarkTap &tap = remap.taps[target];
+    tap.index[0] = (uint8_t)i0;
+    tap.index[1] = (uint8_t)i1;
+    tap.index[2] = (uint8_t)i2;
+    tap.index[3] = (uint8_t)i3;
+    tap.weight[0] = w0;
+    tap.weight[1] = w1;
+    tap.weight[2] = w2;
+    tap.weight[3] = w3;
+}
+
+// 目标点[target, target + count)依次取源点[source, source + count)
+constexpr void copyLandmarkRange(LandmarkRemap &remap, int target, int source, int count)
+{
+    for (int i = 0; i < count; i++) {
+        setLandmarkTaps(remap, target + i, source + i, 1.0f);
+    }
+}
+
+// 下标不越界、权重之和为1时换算才是仿射不变的，可以先换算归一化坐标再映射
+constexpr bool isValidLandmarkRemap(const LandmarkRemap &remap)
+{
+    for (int t = 0; t < YAD_FACE_LANDMARK_NUM; t++) {
+        float sum = 0.0f;
+        for (int k = 0; k < YAD_LANDMARK_TAP_NUM; k++) {
+            if (remap.taps[t].index[k] >= remap.source_count) {
+                return false;
+            }
+            sum += remap.taps[t].weight[k];
+        }
+        if (sum < 0.999f || sum > 1.001f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 内置的换算表，sourceCount为68(iBUG)或98(WFLW)，不支持时返回nullptr
+const LandmarkRemap *getLandmarkRemap(int sourceCount);
+// 用SIMD把numFaces个人脸的关键点换算为106点，src为连续存放的源点，每个人脸remap.source_count个，
+// 结果写入faces[i].landmarks，不修改其它字段
+void remapLandmarks(const LandmarkRemap &remap, const YADPoint2f *src, int numFaces, YADFaceInfo *faces);
+
+}; // namespace yad
+
+#endif /* YAD_LANDMARK_REMAP_H */
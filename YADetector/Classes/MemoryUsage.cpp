@@ -0,0 +1,70 @@
+//
+//  MemoryUsage.cpp
+//  YAD
+//
+
+#include "MemoryUsage.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <malloc/malloc.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace yad {
+
+#if defined(__linux__)
+static int64_t readRssBytes()
+{
+    // statm的第二项为常驻页数，比解析status快
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (!file) {
+        return -1;
+    }
+    long size = 0, resident = 0;
+    int count = fscanf(file, "%ld %ld", &size, &resident);
+    fclose(file);
+    return count == 2 ? (int64_t)resident * sysconf(_SC_PAGESIZE) : -1;
+}
+#endif
+
+void getMemoryUsage(MemoryUsage *usage)
+{
+    usage->rss_bytes = -1;
+    usage->heap_bytes = -1;
+    
+#if defined(__APPLE__)
+    task_vm_info_data_t info;
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+    if (task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&info, &count) == KERN_SUCCESS) {
+        usage->rss_bytes = (int64_t)info.phys_footprint;
+    }
+    malloc_statistics_t stats;
+    malloc_zone_statistics(nullptr, &stats);
+    usage->heap_bytes = (int64_t)stats.size_in_use;
+#elif defined(__linux__)
+    usage->rss_bytes = readRssBytes();
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    usage->heap_bytes = (int64_t)(info.uordblks + info.hblkhd);
+#elif defined(__GLIBC__)
+    // 旧版glibc的mallinfo为int，超过2GB时不准确
+    struct mallinfo info = mallinfo();
+    usage->heap_bytes = (int64_t)(unsigned int)info.uordblks + (int64_t)(unsigned int)info.hblkhd;
+#endif
+#endif
+}
+
+MemoryUsage diffMemoryUsage(const MemoryUsage &begin, const MemoryUsage &end)
+{
+    MemoryUsage delta;
+    delta.rss_bytes = begin.rss_bytes >= 0 && end.rss_bytes >= 0 ? end.rss_bytes - begin.rss_bytes : 0;
+    delta.heap_bytes = begin.heap_bytes >= 0 && end.heap_bytes >= 0 ? end.heap_bytes - begin.heap_bytes : 0;
+    return delta;
+}
+
+}; // namespace yad
@@ -0,0 +1,27 @@
+//
+//  MemoryUsage.h
+//  YAD
+//
+
+#ifndef YAD_MEMORY_USAGE_H
+#define YAD_MEMORY_USAGE_H
+
+#include "YADetector.h"
+
+#include <stdint.h>
+
+namespace yad {
+
+// 进程的内存占用，单位字节，无法获取的项为-1
+typedef struct MemoryUsage {
+    int64_t rss_bytes;      // 常驻内存，Apple平台为phys_footprint
+    int64_t heap_bytes;     // malloc已分配且未释放的内存
+} MemoryUsage;
+
+void getMemoryUsage(MemoryUsage *usage);
+// end - begin，任一端无法获取的项为0
+MemoryUsage diffMemoryUsage(const MemoryUsage &begin, const MemoryUsage &end);
+
+}; // namespace yad
+
+#endif /* YAD_MEMORY_USAGE_H */
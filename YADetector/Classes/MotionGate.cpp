@@ -0,0 +1,155 @@
+//
+//  MotionGate.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADMotion"
+#include "LogMacros.h"
+
+#include "MotionGate.h"
+#include "ImageUtils.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace yad {
+
+MotionGatingDetector::MotionGatingDetector(Detector *detector, float threshold, int maxSkip) :
+    detector_(detector),
+    threshold_(threshold),
+    max_skip_(maxSkip),
+    skip_count_(0),
+    cache_valid_(false),
+    cache_format_(YAD_PIX_FMT_NONE),
+    cache_width_(0),
+    cache_height_(0),
+    cache_rotate_mode_(YAD_ROTATE_0),
+    thumbnail_(YAD_MOTION_THUMB_WIDTH * YAD_MOTION_THUMB_HEIGHT)
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+MotionGatingDetector::~MotionGatingDetector()
+{
+    YLOGI("skipped %llu of %llu frames", (unsigned long long)stats_.skipped, (unsigned long long)stats_.frames);
+}
+
+int MotionGatingDetector::initCheck() const
+{
+    return detector_ ? detector_->initCheck() : YAD_NO_INIT;
+}
+
+YADLandmarkProfile MotionGatingDetector::getLandmarkProfile() const
+{
+    return detector_ ? detector_->getLandmarkProfile() : YAD_LANDMARK_PROFILE_106;
+}
+
+void MotionGatingDetector::setThreshold(float threshold)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    threshold_ = threshold;
+}
+
+void MotionGatingDetector::setMaxSkip(int maxSkip)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_skip_ = maxSkip;
+}
+
+MotionGateStats MotionGatingDetector::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+bool MotionGatingDetector::makeThumbnail(YADDetectImage *detectImage, uint8_t *thumbnail)
+{
+    ImagePlanes planes;
+    if (getImagePlanes(detectImage, &planes) != YAD_OK) {
+        return false;
+    }
+    if (planes.width < YAD_MOTION_THUMB_WIDTH || planes.height < YAD_MOTION_THUMB_HEIGHT) {
+        return false;
+    }
+    
+    // 每个缩略图像素取对应区域内2x2个采样点的平均，降低噪声的影响
+    int xs[YAD_MOTION_THUMB_WIDTH * 2];
+    for (int i = 0; i < YAD_MOTION_THUMB_WIDTH * 2; i++) {
+        xs[i] = (int)(((int64_t)i * 2 + 1) * planes.width / (YAD_MOTION_THUMB_WIDTH * 4));
+    }
+    for (int ty = 0; ty < YAD_MOTION_THUMB_HEIGHT; ty++) {
+        int y0 = (int)(((int64_t)ty * 4 + 1) * planes.height / (YAD_MOTION_THUMB_HEIGHT * 4));
+        int y1 = (int)(((int64_t)ty * 4 + 3) * planes.height / (YAD_MOTION_THUMB_HEIGHT * 4));
+        uint8_t *dst = thumbnail + ty * YAD_MOTION_THUMB_WIDTH;
+        for (int tx = 0; tx < YAD_MOTION_THUMB_WIDTH; tx++) {
+            int x0 = xs[tx * 2];
+            int x1 = xs[tx * 2 + 1];
+            int sum = getLumaAt(planes, x0, y0) + getLumaAt(planes, x1, y0) +
+                      getLumaAt(planes, x0, y1) + getLumaAt(planes, x1, y1);
+            dst[tx] = (uint8_t)((sum + 2) >> 2);
+        }
+    }
+    return true;
+}
+
+int MotionGatingDetector::detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo)
+{
+    if (!featureInfo) {
+        return YAD_BAD_VALUE;
+    }
+    
+    YADFaceResults faceResults = makeFaceResults(featureInfo);
+    int ret = detectFaces(detectImage, detectInfo, &faceResults);
+    featureInfo->num_faces = faceResults.num_faces;
+    return ret;
+}
+
+int MotionGatingDetector::detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults)
+{
+    if (!detector_) {
+        return YAD_NO_INIT;
+    }
+    if (!detectImage || !detectInfo || !faceResults) {
+        return YAD_BAD_VALUE;
+    }
+    
+    const size_t thumbSize = YAD_MOTION_THUMB_WIDTH * YAD_MOTION_THUMB_HEIGHT;
+    uint8_t thumbnail[thumbSize];
+    bool gated = makeThumbnail(detectImage, thumbnail);
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.frames++;
+        bool sameInput = cache_valid_ && cache_format_ == detectImage->format && cache_width_ == detectImage->width &&
+                         cache_height_ == detectImage->height && cache_rotate_mode_ == detectInfo->rotate_mode;
+        if (gated && sameInput && threshold_ > 0.0f && skip_count_ < max_skip_) {
+            stats_.last_diff = (float)sumAbsDiff(thumbnail, thumbnail_.data(), thumbSize) / thumbSize;
+            if (stats_.last_diff < threshold_) {
+                skip_count_++;
+                stats_.skipped++;
+                faceResults->num_faces = std::min((int)cache_faces_.size(), faceResults->capacity);
+                memcpy(faceResults->faces, cache_faces_.data(), sizeof(YADFaceInfo) * faceResults->num_faces);
+                return YAD_OK;
+            }
+        }
+    }
+    
+    int err = detector_->detectFaces(detectImage, detectInfo, faceResults);
+    
+    // 只缓存成功的结果，下一帧与这一帧比较
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_valid_ = gated && err == YAD_OK;
+    if (cache_valid_) {
+        memcpy(thumbnail_.data(), thumbnail, thumbSize);
+        cache_faces_.assign(faceResults->faces, faceResults->faces + faceResults->num_faces);
+        cache_format_ = detectImage->format;
+        cache_width_ = detectImage->width;
+        cache_height_ = detectImage->height;
+        cache_rotate_mode_ = detectInfo->rotate_mode;
+    }
+    skip_count_ = 0;
+    return err;
+}
+
+}; // namespace yad
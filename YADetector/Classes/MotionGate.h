@@ -0,0 +1,70 @@
+//
+//  MotionGate.h
+//  YAD
+//
+
+#ifndef YAD_MOTION_GATE_H
+#define YAD_MOTION_GATE_H
+
+#include "YADetector.h"
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace yad {
+
+#define YAD_MOTION_THUMB_WIDTH      64  // 亮度缩略图尺寸，与输入分辨率无关
+#define YAD_MOTION_THUMB_HEIGHT     48
+#define YAD_MOTION_DEFAULT_MAX_SKIP 30
+
+// 静止画面跳帧统计
+typedef struct MotionGateStats {
+    uint64_t frames;        // 总帧数
+    uint64_t skipped;       // 复用上次结果、没有调用插件的帧数
+    float last_diff;        // 最近一帧与上次分析帧的平均亮度差(0~255)
+} MotionGateStats;
+
+// 静止画面跳帧Detector。每帧先把亮度缩小为固定尺寸的缩略图，与上次真正检测的帧计算平均绝对差，
+// 小于阈值时直接返回缓存的结果，不调用实际的Detector。连续跳过maxSkip帧后强制检测一次，
+// 避免缓慢变化(如光照)的场景一直得不到更新。
+class MotionGatingDetector : public Detector {
+public:
+    MotionGatingDetector(Detector *detector, float threshold, int maxSkip);
+    virtual ~MotionGatingDetector();
+    
+    int initCheck() const override;
+    int detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo) override;
+    int detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults) override;
+    YADLandmarkProfile getLandmarkProfile() const override;
+    
+    void setThreshold(float threshold);
+    void setMaxSkip(int maxSkip);
+    MotionGateStats getStats();
+    
+private:
+    MotionGatingDetector(const MotionGatingDetector &);
+    MotionGatingDetector &operator=(const MotionGatingDetector &);
+    
+    // 生成亮度缩略图，格式不支持时返回false，此时不跳帧
+    static bool makeThumbnail(YADDetectImage *detectImage, uint8_t *thumbnail);
+    
+    std::unique_ptr<Detector> detector_;
+    std::mutex mutex_;
+    float threshold_;
+    int max_skip_;
+    int skip_count_;
+    bool cache_valid_;
+    YADPixelFormat cache_format_;
+    int cache_width_;
+    int cache_height_;
+    YADRotateMode cache_rotate_mode_;
+    std::vector<uint8_t> thumbnail_;       // 上次真正检测的帧
+    std::vector<YADFaceInfo> cache_faces_; // 上次检测结果
+    MotionGateStats stats_;
+};
+
+}; // namespace yad
+
+#endif /* YAD_MOTION_GATE_H */
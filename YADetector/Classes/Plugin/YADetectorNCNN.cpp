@@ -0,0 +1,901 @@
+#ifdef WITH_YAD_NCNN
+
+//
+//  YADetectorNCNN.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADNCNN"
+#include "LogMacros.h"
+
+#include "YADetectorNCNN.h"
+#include "ImageUtils.h"
+#include "ImagePreprocess.h"
+#include "WorkerPool.h"
+#include "CpuAffinity.h"
+#include "LandmarkProfile.h"
+#include "LandmarkRemap.h"
+#ifdef __APPLE__
+#include <CoreFoundation/CoreFoundation.h>
+#endif
+#include "net.h"
+#include "mat.h"
+#include "cpu.h"
+
+#include <math.h>
+#include <limits.h>
+#include <unistd.h>
+#include <mutex>
+#include <string.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <stdexcept>
+
+// 人脸检测使用 Ultra-Light-Fast-Generic-Face-Detector(RFB-320)，关键点使用 PFLD-106。
+// 模型可以通过config指定路径，key: 默认模型名，value: 模型路径。若存在同名的int8量化模型(xxx.int8.param/bin)，优先使用。
+
+#define YAD_NCNN_MODEL_DIR                  "YADetectorNCNN/model"
+#define YAD_NCNN_FACE_PARAM_NAME            "yadface.param"
+#define YAD_NCNN_FACE_BIN_NAME              "yadface.bin"
+#define YAD_NCNN_LANDMARK_PARAM_NAME        "yadlandmark.param"
+#define YAD_NCNN_LANDMARK_BIN_NAME          "yadlandmark.bin"
+#define YAD_NCNN_INT8_SUFFIX                ".int8"
+
+#define YAD_NCNN_FACE_INPUT_WIDTH           320
+#define YAD_NCNN_FACE_INPUT_HEIGHT          240
+#define YAD_NCNN_FACE_MIN_INPUT_WIDTH       160 // 按detect_scale缩小输入时的下限
+#define YAD_NCNN_FACE_INPUT_ALIGNMENT       32
+#define YAD_NCNN_FACE_INPUT_BLOB            "input"
+#define YAD_NCNN_FACE_SCORES_BLOB           "scores"
+#define YAD_NCNN_FACE_BOXES_BLOB            "boxes"
+#define YAD_NCNN_FACE_SCORE_THRESHOLD       0.7f
+#define YAD_NCNN_FACE_NMS_THRESHOLD         0.3f
+#define YAD_NCNN_CENTER_VARIANCE            0.1f
+#define YAD_NCNN_SIZE_VARIANCE              0.2f
+
+#define YAD_NCNN_LANDMARK_INPUT_SIZE        112
+#define YAD_NCNN_LANDMARK_INPUT_BLOB        "input"
+#define YAD_NCNN_LANDMARK_OUTPUT_BLOB       "output"
+#define YAD_NCNN_LANDMARK_CROP_SCALE        1.2f
+
+#define YAD_NCNN_TRACK_IOU_THRESHOLD        0.5f
+
+namespace yad {
+
+// ncnn kanna_rotate 的旋转类型，与EXIF方向一致
+enum {
+    kRotateType_0   = 1,
+    kRotateType_180 = 3,
+    kRotateType_90  = 6,
+    kRotateType_270 = 8,
+};
+
+typedef struct {
+    std::string face_param_path;
+    std::string face_bin_path;
+    std::string landmark_param_path;
+    std::string landmark_bin_path;
+} NCNNModelInfo;
+
+// load()校验通过后整体替换，重新加载期间创建的detector使用旧模型或新模型之一，不会混用
+static std::mutex s_model_mutex;
+static NCNNModelInfo s_model_info;
+
+NCNNDetector::NCNNDetector(YADConfig &config) :
+    init_check_(YAD_NO_INIT),
+    max_face_num_(YAD_MAX_FACE_NUM),
+    detect_scale_(1.0f),
+    quality_max_faces_(0),
+    num_threads_(1),
+    face_net_(nullptr),
+    landmark_net_(nullptr),
+    input_width_(0),
+    input_height_(0),
+    grayscale_(false),
+    image_(nullptr),
+    image_stride_(0),
+    image_type_(ncnn::Mat::PIXEL_RGB),
+    next_track_id_(0)
+{
+    YLOGV("YADetectorNCNN ctor");
+    
+    // 输出个数由结果容量决定，这里不再限制为 YAD_MAX_FACE_NUM
+    max_face_num_ = std::max(1, std::stoi(config[kYADMaxFaceCount]));
+    
+    // 推理线程默认跟随工作线程的绑定
+    const char *affinityKey = config[kYADBackendAffinity].empty() ? kYADCpuAffinity : kYADBackendAffinity;
+    int err = getConfigCpus(config, affinityKey, &backend_cpus_);
+    if (err != YAD_OK) {
+        init_check_ = err;
+        return;
+    }
+    
+    // 默认使用大核数量，避免调度到小核上拖慢整体速度；指定了绑定时每个CPU一个线程
+    num_threads_ = backend_cpus_.empty() ? ncnn::get_big_cpu_count() : (int)backend_cpus_.size();
+    if (!config[kYADThreadCount].empty()) {
+        num_threads_ = std::max(1, std::stoi(config[kYADThreadCount]));
+    }
+    
+    if (!config[kYADGrayscale].empty()) {
+        grayscale_ = std::stoi(config[kYADGrayscale]) != 0;
+    }
+    
+    if (!config[kYADDetectScale].empty()) {
+        detect_scale_ = std::stof(config[kYADDetectScale]);
+    }
+    
+    // 只需要部分关键点时，只换算和映射该子集，对齐用的5点和姿态估计用到的点总是保留
+    YADLandmarkProfile profile;
+    getConfigLandmarkProfile(config, &profile);
+    const uint8_t *indices = getLandmarkIndices(profile);
+    if (indices) {
+        landmark_indices_.assign(indices, indices + profile);
+        landmark_indices_.insert(landmark_indices_.end(), kLandmarkIndices5, kLandmarkIndices5 + YAD_LANDMARK_PROFILE_5);
+        landmark_indices_.insert(landmark_indices_.end(), {
+            YAD_LANDMARK_NOSE_TIP, YAD_LANDMARK_LEFT_PUPIL, YAD_LANDMARK_RIGHT_PUPIL,
+            YAD_LANDMARK_MOUTH_TOP, YAD_LANDMARK_CONTOUR_LEFT, YAD_LANDMARK_CONTOUR_RIGHT,
+        });
+        std::sort(landmark_indices_.begin(), landmark_indices_.end());
+        landmark_indices_.erase(std::unique(landmark_indices_.begin(), landmark_indices_.end()), landmark_indices_.end());
+    }
+    
+    err = WorkerPool::getShared(config, &worker_pool_);
+    if (err != YAD_OK) {
+        init_check_ = err;
+        return;
+    }
+    // 格式转换和旋转与框架的预处理使用同一个线程池，kYADPreprocessThreads没有配置时与人脸并行共用
+    auto threadsIt = config.find(kYADPreprocessThreads);
+    const char *threadsKey = threadsIt != config.end() && !threadsIt->second.empty() ? kYADPreprocessThreads
+                                                                                    : kYADWorkerThreads;
+    err = WorkerPool::getShared(config, threadsKey, &preprocess_pool_);
+    if (err != YAD_OK) {
+        init_check_ = err;
+        return;
+    }
+    
+    face_net_ = new ncnn::Net;
+    landmark_net_ = new ncnn::Net;
+    
+    NCNNModelInfo modelInfo;
+    {
+        std::lock_guard<std::mutex> lock(s_model_mutex);
+        modelInfo = s_model_info;
+    }
+    err = loadNet(face_net_, modelInfo.face_param_path.c_str(), modelInfo.face_bin_path.c_str());
+    if (err != YAD_OK) {
+        init_check_ = err;
+        return;
+    }
+    err = loadNet(landmark_net_, modelInfo.landmark_param_path.c_str(), modelInfo.landmark_bin_path.c_str());
+    if (err != YAD_OK) {
+        init_check_ = err;
+        return;
+    }
+    
+    generatePriors(YAD_NCNN_FACE_INPUT_WIDTH, YAD_NCNN_FACE_INPUT_HEIGHT);
+    
+    init_check_ = YAD_OK;
+}
+
+NCNNDetector::~NCNNDetector()
+{
+    YLOGV("YADetectorNCNN dtor");
+    
+    delete face_net_;
+    face_net_ = nullptr;
+    delete landmark_net_;
+    landmark_net_ = nullptr;
+}
+
+#pragma mark Praivate
+
+std::string NCNNDetector::mainBundlePath()
+{
+    static std::once_flag flag;
+    static std::string path;
+    std::call_once(flag, [&] {
+        path = initMainBundlePath();
+    });
+    return path;
+}
+
+std::string NCNNDetector::initMainBundlePath()
+{
+    char path[PATH_MAX];
+    
+    memset(path, 0x0, PATH_MAX);
+    
+#ifdef __APPLE__
+    CFBundleRef bundleRef = CFBundleGetMainBundle(); // 该引用无需释放
+    CFURLRef urlRef = bundleRef ? CFBundleCopyBundleURL(bundleRef) : NULL;
+    CFStringRef stringRef = urlRef ? CFURLCopyFileSystemPath(urlRef, kCFURLPOSIXPathStyle) : NULL;
+    bool success = stringRef && CFStringGetCString(stringRef, path, PATH_MAX, kCFStringEncodingUTF8);
+    if (stringRef) {
+        CFRelease(stringRef);
+    }
+    if (urlRef) {
+        CFRelease(urlRef);
+    }
+    if (!success) {
+        throw std::runtime_error("main bundle path");
+    }
+    return std::string(path) + "/Frameworks";
+#else
+    // 以可执行文件所在目录作为主目录
+    ssize_t len = readlink("/proc/self/exe", path, PATH_MAX - 1);
+    if (len <= 0) {
+        throw std::runtime_error("readlink");
+    }
+    std::string exePath(path, len);
+    std::size_t pos = exePath.rfind('/');
+    return pos == std::string::npos ? std::string(".") : exePath.substr(0, pos);
+#endif
+}
+
+std::string NCNNDetector::getDefalutModelDirectory()
+{
+    return mainBundlePath() + "/" + YAD_NCNN_MODEL_DIR;
+}
+
+// 优先使用int8量化模型
+std::string NCNNDetector::getModelPath(const char *name)
+{
+    std::string path = getDefalutModelDirectory() + "/" + name;
+    std::size_t pos = path.rfind('.');
+    std::string int8Path = path.substr(0, pos) + YAD_NCNN_INT8_SUFFIX + path.substr(pos);
+    if (fileExists(int8Path)) {
+        return int8Path;
+    }
+    return path;
+}
+
+bool NCNNDetector::fileExists(std::string path)
+{
+    struct stat pathStat;
+    memset(&pathStat, 0, sizeof(struct stat));
+    return stat(path.c_str(), &pathStat) == 0;
+}
+
+int NCNNDetector::translateRotateType(YADRotateMode rotateMode)
+{
+    switch (rotateMode) {
+        case YAD_ROTATE_0:
+            return kRotateType_0;
+        case YAD_ROTATE_90:
+            return kRotateType_90;
+        case YAD_ROTATE_180:
+            return kRotateType_180;
+        case YAD_ROTATE_270:
+            return kRotateType_270;
+        default:
+            break;
+    }
+    return INT_MAX;
+}
+
+float NCNNDetector::getIoU(const YADRectf &a, const YADRectf &b)
+{
+    float x1 = std::max(a.x, b.x);
+    float y1 = std::max(a.y, b.y);
+    float x2 = std::min(a.x + a.w, b.x + b.w);
+    float y2 = std::min(a.y + a.h, b.y + b.h);
+    float inter = std::max(0.0f, x2 - x1) * std::max(0.0f, y2 - y1);
+    float unionArea = a.w * a.h + b.w * b.h - inter;
+    return unionArea > 0.0f ? inter / unionArea : 0.0f;
+}
+
+void NCNNDetector::applyBackendAffinity()
+{
+    if (backend_cpus_.empty()) {
+        return;
+    }
+    
+    // 同一线程上的Detector可能使用不同的绑定，记录最后一次设置的CPU集合
+    static thread_local std::string s_applied;
+    std::string cpus = formatCpuList(backend_cpus_);
+    if (cpus == s_applied) {
+        return;
+    }
+    
+    // set_cpu_thread_affinity在OpenMP线程组内设置，调用线程作为主线程也会被绑定，设置后恢复调用者自己的绑定
+    std::vector<int> callerCpus;
+    int err = getThreadAffinity(&callerCpus);
+    ncnn::CpuSet mask;
+    for (int cpu : backend_cpus_) {
+        mask.enable(cpu);
+    }
+    if (ncnn::set_cpu_thread_affinity(mask) != 0) {
+        YLOGW("set backend affinity failed, cpus: %s", cpus.c_str());
+    }
+    if (err == YAD_OK) {
+        setThreadAffinity(callerCpus);
+    }
+    s_applied = cpus;
+}
+
+int NCNNDetector::loadNet(ncnn::Net *net, const char *paramPath, const char *binPath)
+{
+    // 尽量走packing和int8路径，int8只对量化模型生效
+    net->opt.num_threads = num_threads_;
+    net->opt.lightmode = true;
+    net->opt.use_packing_layout = true;
+    net->opt.use_int8_inference = true;
+    net->opt.use_fp16_packed = true;
+    net->opt.use_fp16_storage = true;
+    
+    if (net->load_param(paramPath) != 0) {
+        YLOGE("load param failed, path: %s", paramPath);
+        return YAD_MODEL_NOT_FOUND;
+    }
+    if (net->load_model(binPath) != 0) {
+        YLOGE("load model failed, path: %s", binPath);
+        return YAD_MODEL_NOT_FOUND;
+    }
+    return YAD_OK;
+}
+
+void NCNNDetector::generatePriors(int inputWidth, int inputHeight)
+{
+    static const int strides[] = {8, 16, 32, 64};
+    static const std::vector<std::vector<float>> minBoxes = {
+        {10.0f, 16.0f, 24.0f},
+        {32.0f, 48.0f},
+        {64.0f, 96.0f},
+        {128.0f, 192.0f, 256.0f},
+    };
+    
+    input_width_ = inputWidth;
+    input_height_ = inputHeight;
+    priors_.clear();
+    for (size_t i = 0; i < minBoxes.size(); i++) {
+        float scaleW = (float)inputWidth / strides[i];
+        float scaleH = (float)inputHeight / strides[i];
+        int featureW = (int)ceilf(scaleW);
+        int featureH = (int)ceilf(scaleH);
+        for (int y = 0; y < featureH; y++) {
+            for (int x = 0; x < featureW; x++) {
+                float cx = (x + 0.5f) / scaleW;
+                float cy = (y + 0.5f) / scaleH;
+                for (float minBox : minBoxes[i]) {
+                    YADRectf prior;
+                    prior.x = std::min(std::max(cx, 0.0f), 1.0f);
+                    prior.y = std::min(std::max(cy, 0.0f), 1.0f);
+                    prior.w = std::min(std::max(minBox / inputWidth, 0.0f), 1.0f);
+                    prior.h = std::min(std::max(minBox / inputHeight, 0.0f), 1.0f);
+                    priors_.push_back(prior);
+                }
+            }
+        }
+    }
+}
+
+// 从共享的帧缓冲池借出至少bytes字节，已持有的缓冲区够用时直接复用，失败返回nullptr
+static unsigned char *acquireFrameBuffer(FrameBuffer *buffer, size_t bytes)
+{
+    return FramePool::getDefault().acquire(bytes, buffer) == YAD_OK ? buffer->data() : nullptr;
+}
+
+int NCNNDetector::convertToRGB(const ImagePlanes &planes, YADRotateMode rotateMode, int *width, int *height)
+{
+    if (translateRotateType(rotateMode) == INT_MAX) {
+        return YAD_ROTATE_UNSUPPORTED;
+    }
+    
+    bool transposed = rotateMode == YAD_ROTATE_90 || rotateMode == YAD_ROTATE_270;
+    int dstWidth = transposed ? planes.height : planes.width;
+    int dstHeight = transposed ? planes.width : planes.height;
+    
+    if (!acquireFrameBuffer(&rgb_, (size_t)dstWidth * dstHeight * 3)) {
+        return YAD_NO_MEMORY;
+    }
+    // 按行分块一次完成转换和旋转，不经过整帧的中间缓冲区，多平面、有填充或奇数宽度的YUV直接读取
+    int err = convertToUpright(planes, YAD_PIX_FMT_RGB888, rotateMode, rgb_.data(), dstWidth * 3,
+                               preprocess_pool_.get());
+    if (err != YAD_OK) {
+        return err;
+    }
+    
+    image_ = rgb_.data();
+    image_stride_ = dstWidth * 3;
+    image_type_ = ncnn::Mat::PIXEL_RGB;
+    *width = dstWidth;
+    *height = dstHeight;
+    return YAD_OK;
+}
+
+int NCNNDetector::convertToGray(const ImagePlanes &planes, YADRotateMode rotateMode, int *width, int *height)
+{
+    int rotateType = translateRotateType(rotateMode);
+    if (rotateType == INT_MAX) {
+        return YAD_ROTATE_UNSUPPORTED;
+    }
+    
+    int srcWidth = planes.width;
+    int srcHeight = planes.height;
+    bool transposed = rotateMode == YAD_ROTATE_90 || rotateMode == YAD_ROTATE_270;
+    int dstWidth = transposed ? srcHeight : srcWidth;
+    int dstHeight = transposed ? srcWidth : srcHeight;
+    
+    // YUV直接使用Y平面，不做任何转换
+    const unsigned char *luma = planes.planes[0];
+    int lumaStride = planes.strides[0];
+    if (!isYUV420(planes.format)) {
+        if (!acquireFrameBuffer(&converted_, (size_t)srcWidth * srcHeight)) {
+            return YAD_NO_MEMORY;
+        }
+        int err = extractLuma(planes, converted_.data(), srcWidth);
+        if (err != YAD_OK) {
+            return err;
+        }
+        luma = converted_.data();
+        lumaStride = srcWidth;
+    }
+    
+    if (rotateType != kRotateType_0) {
+        if (!acquireFrameBuffer(&gray_, (size_t)dstWidth * dstHeight)) {
+            return YAD_NO_MEMORY;
+        }
+        ncnn::kanna_rotate_c1(luma, srcWidth, srcHeight, lumaStride, gray_.data(), dstWidth, dstHeight, dstWidth, rotateType);
+        luma = gray_.data();
+        lumaStride = dstWidth;
+    }
+    
+    // 网络输入仍为三通道，由ncnn在缩放时把亮度复制到各通道
+    image_ = luma;
+    image_stride_ = lumaStride;
+    image_type_ = ncnn::Mat::PIXEL_GRAY2RGB;
+    *width = dstWidth;
+    *height = dstHeight;
+    return YAD_OK;
+}
+
+int NCNNDetector::detectBoxes(int width, int height, float detectScale, std::vector<FaceBox> &faces)
+{
+    static const float meanVals[3] = {127.0f, 127.0f, 127.0f};
+    static const float normVals[3] = {1.0f / 128, 1.0f / 128, 1.0f / 128};
+    
+    // 按缩放降低检测网络的输入分辨率，先验框随输入尺寸重新生成
+    int inputWidth = YAD_NCNN_FACE_INPUT_WIDTH;
+    if (detectScale > 0.0f && detectScale < 1.0f) {
+        inputWidth = (int)(YAD_NCNN_FACE_INPUT_WIDTH * detectScale + YAD_NCNN_FACE_INPUT_ALIGNMENT / 2) /
+                     YAD_NCNN_FACE_INPUT_ALIGNMENT * YAD_NCNN_FACE_INPUT_ALIGNMENT;
+        inputWidth = std::max(inputWidth, YAD_NCNN_FACE_MIN_INPUT_WIDTH);
+    }
+    int inputHeight = inputWidth * YAD_NCNN_FACE_INPUT_HEIGHT / YAD_NCNN_FACE_INPUT_WIDTH;
+    if (inputWidth != input_width_ || inputHeight != input_height_) {
+        generatePriors(inputWidth, inputHeight);
+    }
+    
+    ncnn::Mat in = ncnn::Mat::from_pixels_resize(image_, image_type_, width, height, image_stride_, inputWidth, inputHeight);
+    in.substract_mean_normalize(meanVals, normVals);
+    
+    ncnn::Extractor ex = face_net_->create_extractor();
+    ex.input(YAD_NCNN_FACE_INPUT_BLOB, in);
+    ncnn::Mat scores, boxes;
+    if (ex.extract(YAD_NCNN_FACE_SCORES_BLOB, scores) != 0 || ex.extract(YAD_NCNN_FACE_BOXES_BLOB, boxes) != 0) {
+        YLOGE("extract face failed");
+        return YAD_DETECT_FAILED;
+    }
+    // 每个先验框对应2个分数和4个偏移，模型与先验框不匹配时不解码，避免越界读
+    if ((size_t)scores.w * scores.h < priors_.size() * 2 || (size_t)boxes.w * boxes.h < priors_.size() * 4) {
+        YLOGE("face output mismatch, scores: %dx%d boxes: %dx%d priors: %zu", scores.w, scores.h, boxes.w, boxes.h,
+              priors_.size());
+        return YAD_DETECT_FAILED;
+    }
+    
+    // 解码候选框
+    std::vector<FaceBox> candidates;
+    const float *scoreData = scores.channel(0);
+    const float *boxData = boxes.channel(0);
+    for (size_t i = 0; i < priors_.size(); i++) {
+        float score = scoreData[i * 2 + 1];
+        if (score < YAD_NCNN_FACE_SCORE_THRESHOLD) {
+            continue;
+        }
+        const YADRectf &prior = priors_[i];
+        float cx = boxData[i * 4] * YAD_NCNN_CENTER_VARIANCE * prior.w + prior.x;
+        float cy = boxData[i * 4 + 1] * YAD_NCNN_CENTER_VARIANCE * prior.h + prior.y;
+        float w = expf(boxData[i * 4 + 2] * YAD_NCNN_SIZE_VARIANCE) * prior.w;
+        float h = expf(boxData[i * 4 + 3] * YAD_NCNN_SIZE_VARIANCE) * prior.h;
+        
+        float x1 = std::max(0.0f, (cx - w / 2) * width);
+        float y1 = std::max(0.0f, (cy - h / 2) * height);
+        float x2 = std::min((float)width, (cx + w / 2) * width);
+        float y2 = std::min((float)height, (cy + h / 2) * height);
+        if (x2 <= x1 || y2 <= y1) {
+            continue;
+        }
+        candidates.push_back({{x1, y1, x2 - x1, y2 - y1}, score});
+    }
+    
+    // NMS
+    std::sort(candidates.begin(), candidates.end(), [](const FaceBox &a, const FaceBox &b) {
+        return a.score > b.score;
+    });
+    faces.clear();
+    for (const FaceBox &candidate : candidates) {
+        bool suppressed = false;
+        for (const FaceBox &face : faces) {
+            if (getIoU(candidate.rect, face.rect) > YAD_NCNN_FACE_NMS_THRESHOLD) {
+                suppressed = true;
+                break;
+            }
+        }
+        if (!suppressed) {
+            faces.push_back(candidate);
+        }
+    }
+    return YAD_OK;
+}
+
+int NCNNDetector::detectLandmarks(int width, int height, const YADRectf &rect, YADFaceInfo *faceInfo) const
+{
+    // 以人脸中心取正方形区域
+    float size = std::max(rect.w, rect.h) * YAD_NCNN_LANDMARK_CROP_SCALE;
+    int x1 = std::max(0, (int)(rect.x + rect.w / 2 - size / 2));
+    int y1 = std::max(0, (int)(rect.y + rect.h / 2 - size / 2));
+    int x2 = std::min(width, (int)(rect.x + rect.w / 2 + size / 2));
+    int y2 = std::min(height, (int)(rect.y + rect.h / 2 + size / 2));
+    int cropWidth = x2 - x1;
+    int cropHeight = y2 - y1;
+    if (cropWidth <= 0 || cropHeight <= 0) {
+        return YAD_BAD_VALUE;
+    }
+    
+    static const float normVals[3] = {1.0f / 255, 1.0f / 255, 1.0f / 255};
+    int channels = image_type_ == ncnn::Mat::PIXEL_RGB ? 3 : 1;
+    const unsigned char *crop = image_ + (size_t)y1 * image_stride_ + (size_t)x1 * channels;
+    ncnn::Mat in = ncnn::Mat::from_pixels_resize(crop, image_type_, cropWidth, cropHeight, image_stride_,
+                                                 YAD_NCNN_LANDMARK_INPUT_SIZE, YAD_NCNN_LANDMARK_INPUT_SIZE);
+    in.substract_mean_normalize(0, normVals);
+    
+    ncnn::Extractor ex = landmark_net_->create_extractor();
+    if (worker_pool_) {
+        // 多个人脸已经在线程池中并行，单个人脸不再开多线程，避免超额占用CPU
+        ex.set_num_threads(1);
+    }
+    ex.input(YAD_NCNN_LANDMARK_INPUT_BLOB, in);
+    ncnn::Mat out;
+    if (ex.extract(YAD_NCNN_LANDMARK_OUTPUT_BLOB, out) != 0) {
+        YLOGE("extract landmark failed");
+        return YAD_DETECT_FAILED;
+    }
+    
+    // 输出为相对裁剪区域归一化的坐标。68点、98点的模型先换算为106点，换算是仿射不变的，可以在归一化坐标上进行
+    const float *points = out;
+    int numPoints = (int)(out.total() / 2);
+    if (numPoints < YAD_FACE_LANDMARK_NUM) {
+        const LandmarkRemap *remap = getLandmarkRemap(numPoints);
+        if (!remap) {
+            YLOGE("unsupported landmark count: %d", numPoints);
+            return YAD_DETECT_FAILED;
+        }
+        remapLandmarks(*remap, (const YADPoint2f *)points, 1, faceInfo);
+        points = (const float *)faceInfo->landmarks;
+    }
+    auto setLandmark = [&](int i) {
+        faceInfo->landmarks[i].x = x1 + points[i * 2] * cropWidth;
+        faceInfo->landmarks[i].y = y1 + points[i * 2 + 1] * cropHeight;
+        faceInfo->visibilites[i] = 1.0f;
+    };
+    if (landmark_indices_.empty()) {
+        for (int i = 0; i < YAD_FACE_LANDMARK_NUM; i++) {
+            setLandmark(i);
+        }
+    } else {
+        for (int i : landmark_indices_) {
+            setLandmark(i);
+        }
+    }
+    faceInfo->rect = rect;
+    return YAD_OK;
+}
+
+// 根据关键点近似估计姿态，单位为度
+void NCNNDetector::estimatePose(YADFaceInfo *faceInfo)
+{
+    const YADPoint2f &leftPupil = faceInfo->landmarks[YAD_LANDMARK_LEFT_PUPIL];
+    const YADPoint2f &rightPupil = faceInfo->landmarks[YAD_LANDMARK_RIGHT_PUPIL];
+    const YADPoint2f &noseTip = faceInfo->landmarks[YAD_LANDMARK_NOSE_TIP];
+    const YADPoint2f &mouthTop = faceInfo->landmarks[YAD_LANDMARK_MOUTH_TOP];
+    const YADPoint2f &contourLeft = faceInfo->landmarks[YAD_LANDMARK_CONTOUR_LEFT];
+    const YADPoint2f &contourRight = faceInfo->landmarks[YAD_LANDMARK_CONTOUR_RIGHT];
+    
+    faceInfo->roll = atan2f(rightPupil.y - leftPupil.y, rightPupil.x - leftPupil.x) * 180.0f / (float)M_PI;
+    
+    float halfWidth = (contourRight.x - contourLeft.x) / 2;
+    float centerX = (contourRight.x + contourLeft.x) / 2;
+    float ratio = halfWidth > 0.0f ? (noseTip.x - centerX) / halfWidth : 0.0f;
+    faceInfo->yaw = asinf(std::min(std::max(ratio, -1.0f), 1.0f)) * 180.0f / (float)M_PI;
+    
+    // 正脸时鼻尖大约位于双眼与上唇的中点
+    float eyeY = (leftPupil.y + rightPupil.y) / 2;
+    float span = mouthTop.y - eyeY;
+    ratio = span > 0.0f ? ((noseTip.y - eyeY) / span - 0.5f) * 2 : 0.0f;
+    faceInfo->pitch = asinf(std::min(std::max(ratio, -1.0f), 1.0f)) * 180.0f / (float)M_PI;
+}
+
+// 把旋转后图像上的坐标映射回原图
+void NCNNDetector::mapToSource(YADRotateMode rotateMode, int width, int height, YADFaceInfo *faceInfo) const
+{
+    if (rotateMode == YAD_ROTATE_0) {
+        return;
+    }
+    
+    auto map = [&](float x, float y) -> YADPoint2f {
+        switch (rotateMode) {
+            case YAD_ROTATE_90:
+                return {y, width - x};
+            case YAD_ROTATE_180:
+                return {width - x, height - y};
+            case YAD_ROTATE_270:
+                return {height - y, x};
+            default:
+                return {x, y};
+        }
+    };
+    
+    if (landmark_indices_.empty()) {
+        for (int i = 0; i < YAD_FACE_LANDMARK_NUM; i++) {
+            faceInfo->landmarks[i] = map(faceInfo->landmarks[i].x, faceInfo->landmarks[i].y);
+        }
+    } else {
+        for (int i : landmark_indices_) {
+            faceInfo->landmarks[i] = map(faceInfo->landmarks[i].x, faceInfo->landmarks[i].y);
+        }
+    }
+    YADPoint2f p1 = map(faceInfo->rect.x, faceInfo->rect.y);
+    YADPoint2f p2 = map(faceInfo->rect.x + faceInfo->rect.w, faceInfo->rect.y + faceInfo->rect.h);
+    faceInfo->rect = {std::min(p1.x, p2.x), std::min(p1.y, p2.y), fabsf(p2.x - p1.x), fabsf(p2.y - p1.y)};
+}
+
+// 与上一帧的人脸按IoU匹配，沿用跟踪id
+int NCNNDetector::assignTrackId(const YADRectf &rect, std::vector<TrackInfo> &tracks)
+{
+    float bestIoU = YAD_NCNN_TRACK_IOU_THRESHOLD;
+    auto best = tracks_.end();
+    for (auto it = tracks_.begin(); it != tracks_.end(); ++it) {
+        float iou = getIoU(rect, it->rect);
+        if (iou > bestIoU) {
+            bestIoU = iou;
+            best = it;
+        }
+    }
+    int trackId;
+    if (best != tracks_.end()) {
+        // 匹配过的跟踪不再参与后续匹配
+        trackId = best->track_id;
+        tracks_.erase(best);
+    } else {
+        trackId = next_track_id_++;
+    }
+    tracks.push_back({rect, trackId});
+    return trackId;
+}
+
+#pragma mark API
+
+int NCNNDetector::load(YADConfig &config)
+{
+    // 调用者可以在config增加字段定制模型路径，key: 默认模型名，value: 模型路径
+    auto resolve = [&](const char *name) -> std::string {
+        std::string path = config[name];
+        return path.empty() ? getModelPath(name) : path;
+    };
+    NCNNModelInfo modelInfo;
+    modelInfo.face_param_path = resolve(YAD_NCNN_FACE_PARAM_NAME);
+    modelInfo.face_bin_path = resolve(YAD_NCNN_FACE_BIN_NAME);
+    modelInfo.landmark_param_path = resolve(YAD_NCNN_LANDMARK_PARAM_NAME);
+    modelInfo.landmark_bin_path = resolve(YAD_NCNN_LANDMARK_BIN_NAME);
+    
+    // 新模型不可用时保留之前的模型
+    if (!fileExists(modelInfo.face_param_path) || !fileExists(modelInfo.face_bin_path)) {
+        YLOGE("face model file not found");
+        return YAD_MODEL_NOT_FOUND;
+    }
+    if (!fileExists(modelInfo.landmark_param_path) || !fileExists(modelInfo.landmark_bin_path)) {
+        YLOGE("landmark model file not found");
+        return YAD_MODEL_NOT_FOUND;
+    }
+    
+    std::lock_guard<std::mutex> lock(s_model_mutex);
+    s_model_info = modelInfo;
+    return YAD_OK;
+}
+
+int NCNNDetector::initCheck() const
+{
+    return init_check_;
+}
+
+int NCNNDetector::detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo)
+{
+    if (!featureInfo) {
+        YLOGE("params is null");
+        return YAD_BAD_VALUE;
+    }
+    
+    YADFaceResults faceResults = makeFaceResults(featureInfo);
+    int ret = detectFaces(detectImage, detectInfo, &faceResults);
+    featureInfo->num_faces = faceResults.num_faces;
+    return ret;
+}
+
+int NCNNDetector::setQuality(const YADDetectQuality *quality)
+{
+    if (!quality) {
+        return YAD_BAD_VALUE;
+    }
+    
+    detect_scale_ = quality->detect_scale;
+    quality_max_faces_ = std::max(0, quality->max_faces);
+    return YAD_OK;
+}
+
+int NCNNDetector::detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults)
+{
+    if (!detectImage || !detectInfo || !faceResults) {
+        YLOGE("params is null");
+        return YAD_BAD_VALUE;
+    }
+    
+    ImagePlanes planes;
+    if (getImagePlanes(detectImage, &planes) != YAD_OK) {
+        YLOGE("data is null or type unsupported");
+        return YAD_BAD_VALUE;
+    }
+    
+    if (init_check_ != YAD_OK) {
+        YLOGE("detector not initialized");
+        return YAD_INVALID_OPERATION;
+    }
+    
+    int width, height;
+    int err = grayscale_ ? convertToGray(planes, detectInfo->rotate_mode, &width, &height)
+                         : convertToRGB(planes, detectInfo->rotate_mode, &width, &height);
+    if (err != YAD_OK) {
+        YLOGE("convert failed, err: %d", err);
+        return err;
+    }
+    
+    applyBackendAffinity();
+    
+    std::vector<FaceBox> faces;
+    err = detectBoxes(width, height, detect_scale_, faces);
+    if (err != YAD_OK) {
+        return err;
+    }
+    
+    // 检测框确定后，每个人脸的关键点和姿态相互独立，可以并行
+    int numFaces = std::min(std::min((int)faces.size(), max_face_num_), faceResults->capacity);
+    if (quality_max_faces_ > 0) {
+        numFaces = std::min(numFaces, quality_max_faces_);
+    }
+    std::vector<int> results(numFaces, YAD_OK);
+    auto processFace = [&](int i) {
+        YADFaceInfo *faceInfo = &(faceResults->faces[i]);
+        results[i] = detectLandmarks(width, height, faces[i].rect, faceInfo);
+        if (results[i] == YAD_OK) {
+            estimatePose(faceInfo);
+            mapToSource(detectInfo->rotate_mode, width, height, faceInfo);
+        }
+    };
+    if (worker_pool_) {
+        worker_pool_->parallelFor(numFaces, processFace);
+    } else {
+        for (int i = 0; i < numFaces; i++) {
+            processFace(i);
+        }
+    }
+    
+    // 去掉失败的人脸，跟踪id依赖上一帧状态，串行分配
+    std::vector<TrackInfo> tracks;
+    faceResults->num_faces = 0;
+    for (int i = 0; i < numFaces; i++) {
+        if (results[i] != YAD_OK) {
+            continue;
+        }
+        if (i != faceResults->num_faces) {
+            memcpy(&(faceResults->faces[faceResults->num_faces]), &(faceResults->faces[i]), sizeof(YADFaceInfo));
+        }
+        faceResults->num_faces++;
+    }
+    // 裁剪区域内的坐标还原到整幅图像，跟踪也按整幅图像匹配
+    offsetFaceResults(faceResults, planes.crop_x, planes.crop_y);
+    for (int i = 0; i < faceResults->num_faces; i++) {
+        YADFaceInfo *faceInfo = &(faceResults->faces[i]);
+        faceInfo->track_id = assignTrackId(faceInfo->rect, tracks);
+    }
+    tracks_.swap(tracks);
+    
+    return YAD_OK;
+}
+
+#pragma mark Export
+
+static Detector *createDetector(YADConfig &config)
+{
+    return new NCNNDetector(config);
+}
+
+static int setQuality(Detector *detector, const YADDetectQuality *quality)
+{
+    return static_cast<NCNNDetector *>(detector)->setQuality(quality);
+}
+
+static const char *getName()
+{
+    return "YADetectorNCNN";
+}
+
+static void setLog(Log log)
+{
+    
+}
+
+static int load(YADConfig &config)
+{
+    return yad::NCNNDetector::load(config);
+}
+
+static bool sniffDetector(YADConfig &config, float *confidence)
+{
+    if (!confidence) {
+        YLOGE("confidence is null");
+        return false;
+    }
+    
+    YADPixelFormat pixFormat = (YADPixelFormat)std::stoi(config[kYADPixFormat]);
+    YADDataType dataType = (YADDataType)std::stoi(config[kYADDataType]);
+    
+    // 支持所有格式的裸数据，CPU推理，优先级低于平台专用插件。灰度模式下亮度复制为三通道送入网络，同样支持
+    if (pixFormat > YAD_PIX_FMT_NONE && pixFormat < YAD_PIX_FMT_MAX &&
+        (dataType == YAD_DATA_TYPE_RAW || dataType == YAD_DATA_TYPE_RAW_PLANES)) {
+        *confidence = 0.6f;
+    } else {
+        *confidence = 0.0f;
+    }
+    
+    return *confidence > 0.0f;
+}
+
+static int getCaps(YADConfig &config, PluginCaps *caps)
+{
+    if (!caps) {
+        return YAD_BAD_VALUE;
+    }
+    
+    // 所有格式都在插件内经convertToUpright一次转换并旋转，多平面直接读取；跟踪状态没有加锁，不能并发调用
+    caps->pix_formats = 0;
+    for (int format = YAD_PIX_FMT_NONE + 1; format < YAD_PIX_FMT_MAX; format++) {
+        caps->pix_formats |= YAD_PLUGIN_CAP_FORMAT(format);
+    }
+    caps->data_types = YAD_PLUGIN_CAP_TYPE(YAD_DATA_TYPE_RAW) | YAD_PLUGIN_CAP_TYPE(YAD_DATA_TYPE_RAW_PLANES);
+    caps->rotations = YAD_PLUGIN_CAP_ROTATE_ALL;
+    caps->thread_safe = 0;
+    caps->detect_cost_ms = 30.0f;
+    // 每个Detector有自己的网络，共享的模型路径由s_model_mutex保护
+    caps->concurrent_create = 1;
+    return YAD_OK;
+}
+
+}; // namespace yad
+
+yad::PluginV2 *createYADetectorNCNNPlugin()
+{
+    yad::PluginV2 *plugin = new yad::PluginV2;
+    plugin->abi_version = YAD_PLUGIN_ABI_VERSION;
+    plugin->base.getName = yad::getName;
+    plugin->base.setLog = yad::setLog;
+    plugin->base.load = yad::load;
+    plugin->base.sniff = yad::sniffDetector;
+    plugin->base.createDetector = yad::createDetector;
+    plugin->getCaps = yad::getCaps;
+    plugin->setQuality = yad::setQuality;
+    return plugin;
+}
+
+#endif // WITH_YAD_NCNN
@@ -0,0 +1,110 @@
+#ifdef WITH_YAD_NCNN
+
+//
+//  YADetectorNCNN.h
+//  YAD
+//
+
+#ifndef YAD_DETECTOR_NCNN_H
+#define YAD_DETECTOR_NCNN_H
+
+#include "YADetector.h"
+#include "ImageUtils.h"
+#include "FramePool.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ncnn {
+class Net;
+};
+
+namespace yad {
+
+class WorkerPool;
+
+class NCNNDetector : public Detector
+{
+public:
+    NCNNDetector() = delete;
+    NCNNDetector(YADConfig &config);
+    virtual ~NCNNDetector();
+    
+    static int load(YADConfig &config);
+    
+    int initCheck() const override;
+    int detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo) override;
+    int detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults) override;
+    // 耗时预算控制调整检测质量，下一帧生效
+    int setQuality(const YADDetectQuality *quality);
+    
+private:
+    typedef struct {
+        YADRectf rect;
+        float score;
+    } FaceBox;
+    
+    typedef struct {
+        YADRectf rect;
+        int track_id;
+    } TrackInfo;
+    
+    static std::string mainBundlePath();
+    static std::string initMainBundlePath();
+    static std::string getDefalutModelDirectory();
+    static std::string getModelPath(const char *name);
+    static bool fileExists(std::string path);
+    
+    static int translateRotateType(YADRotateMode rotateMode);
+    static float getIoU(const YADRectf &a, const YADRectf &b);
+    
+    int loadNet(ncnn::Net *net, const char *paramName, const char *binName);
+    void generatePriors(int inputWidth, int inputHeight);
+    // 转换为RGB888并旋转为正向，结果保存在rgb_
+    int convertToRGB(const ImagePlanes &planes, YADRotateMode rotateMode, int *width, int *height);
+    // 灰度模式，只取亮度并旋转为正向，YUV不旋转时直接引用Y平面
+    int convertToGray(const ImagePlanes &planes, YADRotateMode rotateMode, int *width, int *height);
+    int detectBoxes(int width, int height, float detectScale, std::vector<FaceBox> &faces);
+    int detectLandmarks(int width, int height, const YADRectf &rect, YADFaceInfo *faceInfo) const;
+    // ncnn的OpenMP线程池属于调用线程，第一次在某个线程上检测时才能设置绑定，调用线程本身的绑定不变
+    void applyBackendAffinity();
+    static void estimatePose(YADFaceInfo *faceInfo);
+    void mapToSource(YADRotateMode rotateMode, int width, int height, YADFaceInfo *faceInfo) const;
+    int assignTrackId(const YADRectf &rect, std::vector<TrackInfo> &tracks);
+    
+    int init_check_;
+    int max_face_num_;
+    float detect_scale_; // 检测网络输入相对原始尺寸的缩放，来自kYADDetectScale和setQuality
+    int quality_max_faces_; // setQuality限制的人脸数，0表示不限制
+    int num_threads_;
+    std::vector<int> backend_cpus_; // 推理线程绑定的CPU，为空时不绑定
+    ncnn::Net *face_net_;
+    ncnn::Net *landmark_net_;
+    std::shared_ptr<WorkerPool> worker_pool_; // 多人脸时并行处理关键点和姿态，为空时串行
+    std::shared_ptr<WorkerPool> preprocess_pool_; // 格式转换和旋转的分块并行，为空时串行
+    int input_width_;   // 当前检测网络的输入尺寸，随detect_scale变化
+    int input_height_;
+    std::vector<YADRectf> priors_; // 检测网络的先验框，归一化中心点和宽高
+    bool grayscale_;
+    std::vector<int> landmark_indices_; // kYADLandmarkProfile子集加上估计姿态需要的点，升序，为空时输出全部106点
+    // 当前帧送入网络的图像，指向rgb_、gray_或调用者的Y平面，只在一次检测内有效
+    const unsigned char *image_;
+    int image_stride_;
+    int image_type_; // ncnn::Mat::PixelType
+    FrameBuffer rgb_;       // 以下缓冲区来自FramePool::getDefault()，跨帧持有，尺寸不变时不再分配
+    FrameBuffer gray_;
+    FrameBuffer converted_; // 灰度模式下非YUV格式提取的亮度
+    std::vector<TrackInfo> tracks_;
+    int next_track_id_;
+    
+    NCNNDetector(const NCNNDetector &);
+    NCNNDetector &operator=(const NCNNDetector &);
+};
+
+}; // namespace yad
+
+extern "C" yad::PluginV2 *createYADetectorNCNNPlugin();
+
+#endif /* YAD_DETECTOR_NCNN_H */
+
+#endif // WITH_YAD_NCNN
@@ -10,6 +10,7 @@
 #include "LogMacros.h"
 
 #include "YADetectorTT.h"
+#include "ImageUtils.h"
 #include <CoreFoundation/CoreFoundation.h>
 #include <CoreMedia/CMSampleBuffer.h>
 #include <dlfcn.h>
@@ -28,6 +29,7 @@
 #define YAD_TT_LIB_NAME                 "TTMLKit"
 #define YAD_TT_FACE_MODEL_NAME          "ttface.model"
 #define YAD_TT_FACE_EXTRA_MODLE_NAME    "ttfaceext.model"
+#define YAD_TT_MAX_FACE_NUM             10  // tt库结果结构体的容量，与 YAD_MAX_FACE_NUM 无关
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,7 +42,7 @@ enum {
     kOrientation_LEFT,
 };
 
-// tt facedetect支持范围: 0~3
+// tt facedetect的像素格式，NV12和GRAY用于YUV输入及灰度模式
 enum {
     kPixelFormat_RGBA8888 = 0,
     kPixelFormat_BGRA8888,
@@ -87,8 +89,8 @@ typedef struct tt_face_extra_t
 
 typedef struct tt_faces_info_t
 {
-  tt_face_base_t faces[YAD_MAX_FACE_NUM];
-  tt_face_extra_t dummy1[YAD_MAX_FACE_NUM];
+  tt_face_base_t faces[YAD_TT_MAX_FACE_NUM];
+  tt_face_extra_t dummy1[YAD_TT_MAX_FACE_NUM];
   int num_faces;
 } tt_faces_info_t;
 
@@ -103,13 +105,6 @@ typedef void (*AddExtraModelFnPtr)(void *handle, unsigned long long flags, char
 typedef int (*DoPredictFnPtr)(void *handle, unsigned char const *baseAddress, unsigned int pixelFormatType,signed int width, signed int height, int stride, int screenOrient, unsigned long long flags, tt_faces_info_t *facesInfo);
 typedef void (*ReleaseHandleFnPtr)(void *handle);
 
-typedef struct {
-    void *lib_handle;
-    std::string lib_path;
-    std::string face_model_path;
-    std::string face_extra_model_path;
-} TTLibraryInfo;
-
 typedef struct {
     CreateHandlerFnPtr CreateHandler;
     AddExtraModelFnPtr AddExtraModel;
@@ -117,26 +112,62 @@ typedef struct {
     ReleaseHandleFnPtr ReleaseHandle;
 } TTSymbolTable;
 
-static TTSymbolTable s_symbol_table;
-static TTLibraryInfo s_library_info;
+// 一次load()得到的库和模型路径，由当前的s_library和用它创建的detector共同持有
+struct TTLibrary {
+    void *lib_handle;
+    TTSymbolTable symbols;
+    std::string lib_path;
+    std::string face_model_path;
+    std::string face_extra_model_path;
+    bool prefer_config; // 重新加载时调用者指定的路径优先于App自带的资源，否则重新加载不会生效
+    
+    TTLibrary() :
+        lib_handle(nullptr),
+        prefer_config(false)
+    {
+        memset(&symbols, 0, sizeof(TTSymbolTable));
+    }
+    
+    ~TTLibrary()
+    {
+        if (lib_handle) {
+            dlclose(lib_handle);
+            lib_handle = nullptr;
+        }
+    }
+};
+
+static std::mutex s_library_mutex;
+static std::shared_ptr<TTLibrary> s_library;
 
 TTDetector::TTDetector(YADConfig &config) :
     init_check_(YAD_NO_INIT),
     handle_(nullptr),
-    max_face_num_(YAD_MAX_FACE_NUM)
+    max_face_num_(YAD_TT_MAX_FACE_NUM),
+    grayscale_(false)
 {
     YLOGV("YADetectorTT ctor");
     
+    // 输出个数由结果容量决定，这里不再限制为 YAD_MAX_FACE_NUM
     max_face_num_ = std::stoi(config[kYADMaxFaceCount]);
-    max_face_num_ = std::min(max_face_num_, YAD_MAX_FACE_NUM);
+    if (!config[kYADGrayscale].empty()) {
+        grayscale_ = std::stoi(config[kYADGrayscale]) != 0;
+    }
     
-    std::string modelPath = getModelPath();
+    library_ = getLibrary();
+    if (!library_) {
+        YLOGE("symbols not loaded");
+        init_check_ = YAD_SYMBOLS_NOT_LOADED;
+        return;
+    }
+    
+    std::string modelPath = getModelPath(*library_);
     if (!fileExists(modelPath)) {
         YLOGE("model file not found");
         init_check_ = YAD_MODEL_NOT_FOUND;
         return;
     }
-    std::string extraModelPath = getExtraModelPath();
+    std::string extraModelPath = getExtraModelPath(*library_);
     if (!fileExists(extraModelPath)) {
         YLOGE("extra model file not found");
         init_check_ = YAD_MODEL_NOT_FOUND;
@@ -144,7 +175,7 @@ TTDetector::TTDetector(YADConfig &config) :
     }
     
     unsigned long long flags = 0x20007f;
-    int ret = s_symbol_table.CreateHandler(flags, modelPath.c_str(), &handle_);
+    int ret = library_->symbols.CreateHandler(flags, modelPath.c_str(), &handle_);
     if (ret) {
         YLOGE("create handler failed, err: %d", ret);
         init_check_ = YAD_HANDLE_INVALID;
@@ -152,7 +183,7 @@ TTDetector::TTDetector(YADConfig &config) :
     }
     
     flags = 0x900;
-    s_symbol_table.AddExtraModel(handle_, flags, extraModelPath.c_str());
+    library_->symbols.AddExtraModel(handle_, flags, extraModelPath.c_str());
     
     init_check_ = YAD_OK;
 }
@@ -162,43 +193,44 @@ TTDetector::~TTDetector()
     YLOGV("YADetectorTT dtor");
     
     if (handle_) {
-        s_symbol_table.ReleaseHandle(handle_);
+        library_->symbols.ReleaseHandle(handle_);
         handle_ = nullptr;
     }
 }
 
 #pragma mark Praivate
 
-bool TTDetector::loadSymbols(std::string libPath)
+// SDK总是动态加载，定义YAD_STATIC_PLUGINS_ONLY时也一样，启用TT的构建需要链接libdl
+bool TTDetector::loadSymbols(std::string libPath, TTLibrary *library)
 {
-    memset(&s_symbol_table, 0, sizeof(TTSymbolTable));
+    TTSymbolTable &symbols = library->symbols;
     
-    s_library_info.lib_handle = dlopen(libPath.c_str(), RTLD_NOW);
-    if (s_library_info.lib_handle == nullptr) {
+    library->lib_handle = dlopen(libPath.c_str(), RTLD_NOW);
+    if (library->lib_handle == nullptr) {
         YLOGE("dlopen failed");
         return false;
     }
 
-    s_symbol_table.CreateHandler = (CreateHandlerFnPtr)dlsym(s_library_info.lib_handle, "FS_CreateHandler");
-    if (s_symbol_table.CreateHandler == nullptr) {
+    symbols.CreateHandler = (CreateHandlerFnPtr)dlsym(library->lib_handle, "FS_CreateHandler");
+    if (symbols.CreateHandler == nullptr) {
         YLOGE("dlsym 1 failed");
         goto bail;
     }
     
-    s_symbol_table.AddExtraModel = (AddExtraModelFnPtr)dlsym(s_library_info.lib_handle, "FS_AddExtraModel");
-    if (s_symbol_table.AddExtraModel == nullptr) {
+    symbols.AddExtraModel = (AddExtraModelFnPtr)dlsym(library->lib_handle, "FS_AddExtraModel");
+    if (symbols.AddExtraModel == nullptr) {
         YLOGE("dlsym 2 failed");
         goto bail;
     }
 
-    s_symbol_table.DoPredict = (DoPredictFnPtr)dlsym(s_library_info.lib_handle, "FS_DoPredict");
-    if (s_symbol_table.DoPredict == nullptr) {
+    symbols.DoPredict = (DoPredictFnPtr)dlsym(library->lib_handle, "FS_DoPredict");
+    if (symbols.DoPredict == nullptr) {
         YLOGE("dlsym 3 failed");
         goto bail;
     }
 
-    s_symbol_table.ReleaseHandle = (ReleaseHandleFnPtr)dlsym(s_library_info.lib_handle, "FS_ReleaseHandle");
-    if (s_symbol_table.ReleaseHandle == nullptr) {
+    symbols.ReleaseHandle = (ReleaseHandleFnPtr)dlsym(library->lib_handle, "FS_ReleaseHandle");
+    if (symbols.ReleaseHandle == nullptr) {
         YLOGE("dlsym 4 failed");
         goto bail;
     }
@@ -206,12 +238,18 @@ bool TTDetector::loadSymbols(std::string libPath)
     return true;
     
 bail:
-    memset(&s_symbol_table, 0, sizeof(TTSymbolTable));
-    dlclose(s_library_info.lib_handle);
-    s_library_info.lib_handle = nullptr;
+    memset(&symbols, 0, sizeof(TTSymbolTable));
+    dlclose(library->lib_handle);
+    library->lib_handle = nullptr;
     return false;
 }
 
+std::shared_ptr<TTLibrary> TTDetector::getLibrary()
+{
+    std::lock_guard<std::mutex> lock(s_library_mutex);
+    return s_library;
+}
+
 std::string TTDetector::mainBundlePath()
 {
     static std::once_flag flag;
@@ -293,32 +331,28 @@ std::string TTDetector::getDefalutExtraModelPath()
     return getDefalutModelDirectory() + "/" + YAD_TT_FACE_EXTRA_MODLE_NAME;
 }
 
-// 优先使用App本身的库和资源
-std::string TTDetector::getLibPath()
+// 优先使用App本身的库和资源，重新加载时优先使用调用者指定的
+std::string TTDetector::selectPath(const TTLibrary &library, const std::string &configPath, const std::string &defaultPath)
 {
-    std::string path = getDefalutLibPath();
-    if (fileExists(path)) {
-        return path;
+    if (library.prefer_config && !configPath.empty()) {
+        return configPath;
     }
-    return s_library_info.lib_path;
+    return fileExists(defaultPath) ? defaultPath : configPath;
 }
 
-std::string TTDetector::getModelPath()
+std::string TTDetector::getLibPath(const TTLibrary &library)
 {
-    std::string path = getDefalutModelPath();
-    if (fileExists(path)) {
-        return path;
-    }
-    return s_library_info.face_model_path;
+    return selectPath(library, library.lib_path, getDefalutLibPath());
 }
 
-std::string TTDetector::getExtraModelPath()
+std::string TTDetector::getModelPath(const TTLibrary &library)
 {
-    std::string path = getDefalutExtraModelPath();
-    if (fileExists(path)) {
-        return path;
-    }
-    return s_library_info.face_extra_model_path;
+    return selectPath(library, library.face_model_path, getDefalutModelPath());
+}
+
+std::string TTDetector::getExtraModelPath(const TTLibrary &library)
+{
+    return selectPath(library, library.face_extra_model_path, getDefalutExtraModelPath());
 }
 
 bool TTDetector::fileExists(std::string path)
@@ -339,6 +373,8 @@ int TTDetector::translatePixelFormat(YADPixelFormat pixelFormat)
             return kPixelFormat_BGRA8888;
         case YAD_PIX_FMT_RGBA8888:
             return kPixelFormat_RGBA8888;
+        case YAD_PIX_FMT_NV12:
+            return kPixelFormat_NV12;
         default:
             break;
     }
@@ -367,35 +403,38 @@ int TTDetector::translateOrientation(YADRotateMode rotateMode)
 int TTDetector::load(YADConfig &config)
 {
     // 有些情况下，调用者希望定制资源，调用者可以在config增加字段实现该功能，key: 默认资源名，value: 资源指定的路径
-    // 但是需要注意的是，仍旧会优先使用App本身的资源
-    s_library_info.lib_handle = nullptr;
-    s_library_info.lib_path = config[YAD_TT_LIB_NAME];
-    s_library_info.face_model_path = config[YAD_TT_FACE_MODEL_NAME];
-    s_library_info.face_extra_model_path = config[YAD_TT_FACE_EXTRA_MODLE_NAME];
-
-    std::string libPath = getLibPath();
+    // 但是需要注意的是，第一次加载仍旧会优先使用App本身的资源，重新加载(ReloadPlugin)时指定的资源优先
+    // 重新加载时先完整加载新的库和模型，成功后才替换，失败时继续使用之前的版本
+    std::shared_ptr<TTLibrary> library = std::make_shared<TTLibrary>();
+    library->lib_path = config[YAD_TT_LIB_NAME];
+    library->face_model_path = config[YAD_TT_FACE_MODEL_NAME];
+    library->face_extra_model_path = config[YAD_TT_FACE_EXTRA_MODLE_NAME];
+    library->prefer_config = getLibrary() != nullptr;
+
+    std::string libPath = getLibPath(*library);
     if (!fileExists(libPath)) {
         YLOGE("lib not found");
         return YAD_SYMBOLS_NOT_LOADED;
     }
     
-    loadSymbols(libPath);
-    if (s_library_info.lib_handle == nullptr) {
+    if (!loadSymbols(libPath, library.get())) {
         YLOGE("symbols not loaded");
         return YAD_SYMBOLS_NOT_LOADED;
     }
     
-    std::string modelPath = getModelPath();
+    std::string modelPath = getModelPath(*library);
     if (!fileExists(modelPath)) {
         YLOGE("model file not found");
         return YAD_MODEL_NOT_FOUND;
     }
-    std::string extraModelPath = getExtraModelPath();
+    std::string extraModelPath = getExtraModelPath(*library);
     if (!fileExists(extraModelPath)) {
         YLOGE("extra model file not found");
         return YAD_MODEL_NOT_FOUND;
     }
     
+    std::lock_guard<std::mutex> lock(s_library_mutex);
+    s_library = library;
     return YAD_OK;
 }
 
@@ -406,7 +445,20 @@ int TTDetector::initCheck() const
 
 int TTDetector::detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo)
 {
-    if (!detectImage || !detectInfo || !featureInfo) {
+    if (!featureInfo) {
+        YLOGE("params is null");
+        return YAD_BAD_VALUE;
+    }
+    
+    YADFaceResults faceResults = makeFaceResults(featureInfo);
+    int ret = detectFaces(detectImage, detectInfo, &faceResults);
+    featureInfo->num_faces = faceResults.num_faces;
+    return ret;
+}
+
+int TTDetector::detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults)
+{
+    if (!detectImage || !detectInfo || !faceResults) {
         YLOGE("params is null");
         return YAD_BAD_VALUE;
     }
@@ -436,12 +488,62 @@ int TTDetector::detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, Y
 
     unsigned long long flags = 0x13f;
     CVPixelBufferLockBaseAddress(pixelBuffer, 0);
-    unsigned char *baseAddress = (unsigned char *)CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 0);
+    unsigned char *baseAddress = (unsigned char *)CVPixelBufferGetBaseAddress(pixelBuffer);
+    int stride = detectImage->stride;
+    if (CVPixelBufferIsPlanar(pixelBuffer)) {
+        // SDK只接受单个地址，NV12的色度平面不紧跟亮度平面时先拼接
+        unsigned char *luma = (unsigned char *)CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 0);
+        unsigned char *chroma = (unsigned char *)CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 1);
+        size_t lumaStride = CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 0);
+        size_t chromaStride = CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 1);
+        baseAddress = luma;
+        stride = (int)lumaStride;
+        if (grayscale_) {
+            // 灰度模式直接使用Y平面，不需要色度
+            pixelFormat = kPixelFormat_GRAY;
+        } else if (chroma != luma + lumaStride * detectImage->height || chromaStride != lumaStride) {
+            ImagePlanes planes;
+            memset(&planes, 0, sizeof(planes));
+            planes.format = detectImage->format;
+            planes.width = detectImage->width;
+            planes.height = detectImage->height;
+            planes.num_planes = 2;
+            planes.planes[0] = luma;
+            planes.planes[1] = chroma;
+            planes.strides[0] = (int)lumaStride;
+            planes.strides[1] = (int)chromaStride;
+            stride = getCompactStride(planes.format, planes.width);
+            if (FramePool::getDefault().acquire(getImageSize(planes.format, planes.height, stride), &packed_) != YAD_OK) {
+                CVPixelBufferUnlockBaseAddress(pixelBuffer, 0);
+                return YAD_NO_MEMORY;
+            }
+            copyToContiguous(planes, packed_.data(), stride);
+            baseAddress = packed_.data();
+        }
+    } else if (grayscale_) {
+        // RGB格式先提取亮度，SDK只需要处理单通道
+        ImagePlanes planes;
+        memset(&planes, 0, sizeof(planes));
+        planes.format = detectImage->format;
+        planes.width = detectImage->width;
+        planes.height = detectImage->height;
+        planes.num_planes = 1;
+        planes.planes[0] = baseAddress;
+        planes.strides[0] = (int)CVPixelBufferGetBytesPerRow(pixelBuffer);
+        if (FramePool::getDefault().acquire((size_t)planes.width * planes.height, &packed_) != YAD_OK) {
+            CVPixelBufferUnlockBaseAddress(pixelBuffer, 0);
+            return YAD_NO_MEMORY;
+        }
+        extractLuma(planes, packed_.data(), planes.width);
+        baseAddress = packed_.data();
+        stride = planes.width;
+        pixelFormat = kPixelFormat_GRAY;
+    }
     
     // FIXME support flags
     tt_faces_info_t facesInfo;
     memset(&facesInfo, 0, sizeof(tt_faces_info_t));
-    int ret = s_symbol_table.DoPredict(handle_, baseAddress, pixelFormat, detectImage->width, detectImage->height, detectImage->stride, orientation, flags, (tt_faces_info_t *)&facesInfo);
+    int ret = library_->symbols.DoPredict(handle_, baseAddress, pixelFormat, detectImage->width, detectImage->height, stride, orientation, flags, (tt_faces_info_t *)&facesInfo);
     if (ret) {
         YLOGE("DoPredict failed, ret: %d", ret);
         CVPixelBufferUnlockBaseAddress(pixelBuffer, 0);
@@ -453,15 +555,16 @@ int TTDetector::detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, Y
     //YLOGD("DoPredict succuss, num_faces: %d", facesInfo.num_faces);
     
     // 转换结构
-    featureInfo->num_faces = std::min(facesInfo.num_faces, max_face_num_);
-    for (int i = 0; i < facesInfo.num_faces; i++) {
-        YADFaceInfo *dst = &(featureInfo->faces[i]);
+    int numFaces = std::min(std::min(facesInfo.num_faces, YAD_TT_MAX_FACE_NUM), max_face_num_);
+    faceResults->num_faces = std::min(numFaces, faceResults->capacity);
+    for (int i = 0; i < faceResults->num_faces; i++) {
+        YADFaceInfo *dst = &(faceResults->faces[i]);
         tt_face_base_t *src = &(facesInfo.faces[i]);
         
         dst->track_id = src->face_id;
         dst->rect = {(float)src->rect.left, (float)src->rect.top, (float)(src->rect.right - src->rect.left), (float)(src->rect.bottom - src->rect.top)};
         memcpy(dst->landmarks, src->points, sizeof(YADPoint2f) * YAD_FACE_LANDMARK_NUM);
-        memcpy(dst->visibilites, src->visibilites, sizeof(YADPoint2f) * YAD_FACE_LANDMARK_NUM);
+        memcpy(dst->visibilites, src->visibilites, sizeof(float) * YAD_FACE_LANDMARK_NUM);
         dst->yaw = src->yaw;
         dst->pitch = src->pitch;
         dst->roll = src->roll;
@@ -502,7 +605,8 @@ static bool sniffDetector(YADConfig &config, float *confidence)
     YADPixelFormat pixFormat = (YADPixelFormat)std::stoi(config[kYADPixFormat]);
     YADDataType dataType = (YADDataType)std::stoi(config[kYADDataType]);
     
-    if (pixFormat == YAD_PIX_FMT_BGRA8888 && dataType == YAD_DATA_TYPE_IOS_PIXEL_BUFFER) {
+    // SDK支持kPixelFormat_GRAY，灰度模式同样可用
+    if ((pixFormat == YAD_PIX_FMT_BGRA8888 || pixFormat == YAD_PIX_FMT_NV12) && dataType == YAD_DATA_TYPE_IOS_PIXEL_BUFFER) {
         *confidence = 0.8f;
     } else {
         *confidence = 0.0f;
@@ -511,16 +615,35 @@ static bool sniffDetector(YADConfig &config, float *confidence)
     return *confidence > 0.0f;
 }
 
+static int getCaps(YADConfig &config, PluginCaps *caps)
+{
+    if (!caps) {
+        return YAD_BAD_VALUE;
+    }
+    
+    // SDK只接受PixelBuffer，旋转由SDK处理；框架的convertToUpright只输出RAW，不能为该插件转换，RAW输入不会选中该插件
+    caps->pix_formats = YAD_PLUGIN_CAP_FORMAT(YAD_PIX_FMT_BGRA8888) | YAD_PLUGIN_CAP_FORMAT(YAD_PIX_FMT_NV12);
+    caps->data_types = YAD_PLUGIN_CAP_TYPE(YAD_DATA_TYPE_IOS_PIXEL_BUFFER);
+    caps->rotations = YAD_PLUGIN_CAP_ROTATE_ALL;
+    caps->thread_safe = 0;
+    caps->detect_cost_ms = 10.0f;
+    caps->concurrent_create = 0;
+    return YAD_OK;
+}
+
 }; // namespace yad
 
-yad::Plugin *createYADetectorTTPlugin()
+yad::PluginV2 *createYADetectorTTPlugin()
 {
-    yad::Plugin *plugin = new yad::Plugin;
-    plugin->getName = yad::getName;
-    plugin->setLog = yad::setLog;
-    plugin->load = yad::load;
-    plugin->sniff = yad::sniffDetector;
-    plugin->createDetector = yad::createDetector;
+    yad::PluginV2 *plugin = new yad::PluginV2;
+    plugin->abi_version = YAD_PLUGIN_ABI_VERSION;
+    plugin->base.getName = yad::getName;
+    plugin->base.setLog = yad::setLog;
+    plugin->base.load = yad::load;
+    plugin->base.sniff = yad::sniffDetector;
+    plugin->base.createDetector = yad::createDetector;
+    plugin->getCaps = yad::getCaps;
+    plugin->setQuality = nullptr; // 不支持调整检测质量，由框架裁剪人脸数
     return plugin;
 }
 
@@ -9,10 +9,14 @@
 #define YAD_DETECTOR_TT_H
 
 #include "YADetector.h"
+#include "FramePool.h"
+#include <memory>
 #include <string>
 
 namespace yad {
 
+struct TTLibrary;
+
 class TTDetector : public Detector
 {
 public:
@@ -24,9 +28,11 @@ public:
     
     int initCheck() const override;
     int detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo) override;
+    int detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults) override;
     
 private:
-    static bool loadSymbols(std::string libPath);
+    static bool loadSymbols(std::string libPath, TTLibrary *library);
+    static std::shared_ptr<TTLibrary> getLibrary();
     
     static std::string mainBundlePath();
     static std::string initMainBundlePath();
@@ -36,17 +42,21 @@ private:
     static std::string getDefalutLibPath();
     static std::string getDefalutModelPath();
     static std::string getDefalutExtraModelPath();
-    static std::string getLibPath();
-    static std::string getModelPath();
-    static std::string getExtraModelPath();
+    static std::string selectPath(const TTLibrary &library, const std::string &configPath, const std::string &defaultPath);
+    static std::string getLibPath(const TTLibrary &library);
+    static std::string getModelPath(const TTLibrary &library);
+    static std::string getExtraModelPath(const TTLibrary &library);
     
     static bool fileExists(std::string path);
     static int translatePixelFormat(YADPixelFormat pixelFormat);
     static int translateOrientation(YADRotateMode rotateMode);
     
     int init_check_;
+    std::shared_ptr<TTLibrary> library_;    // 创建handle_时的库，重新加载后旧库在所有detector释放后才关闭
     void *handle_;
     int max_face_num_;
+    bool grayscale_;
+    FrameBuffer packed_;    // 平面不连续时拼接后的NV12数据，或灰度模式下提取的亮度，来自FramePool::getDefault()，跨帧持有
 
     TTDetector(const TTDetector &);
     TTDetector &operator=(const TTDetector &);
@@ -54,7 +64,7 @@ private:
 
 }; // namespace yad
 
-extern "C" yad::Plugin *createYADetectorTTPlugin();
+extern "C" yad::PluginV2 *createYADetectorTTPlugin();
 
 #endif /* YAD_DETECTOR_TT_H */
 
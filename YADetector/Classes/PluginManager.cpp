@@ -8,16 +8,40 @@
 #include "LogMacros.h"
 
 #include "PluginManager.h"
+#ifdef __APPLE__
 #include <CoreFoundation/CoreFoundation.h>
+#endif
 #include "Logger.h"
+#include "FrameRecorder.h"
+#include "MotionGate.h"
+#include "AdaptiveDetector.h"
+#include "ConvertingDetector.h"
+#include "WorkerPool.h"
+#include "CpuAffinity.h"
+#include "ImageUtils.h"
+#include "LandmarkProfile.h"
+#include "MemoryUsage.h"
+#include "PluginRegistry.h"
+#if defined(__linux__)
+#include "RemoteDetector.h"
+#endif
 #ifdef WITH_YAD_TT
 #include "YADetectorTT.h"
 #endif
+#ifdef WITH_YAD_NCNN
+#include "YADetectorNCNN.h"
+#endif
 
+#ifndef YAD_STATIC_PLUGINS_ONLY
 #include <dlfcn.h>
+#endif
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
 #include <dirent.h>
+#include <algorithm>
 #include <mutex>
 #include <memory>
 #include <sstream>
@@ -25,6 +49,14 @@
 #include <stdexcept>
 
 #define YAD_PLUGIN_DIRS_KEY     "YAD_PLUGIN_DIRS"
+#define YAD_MEMORY_BUDGET_KEY   "YAD_MEMORY_BUDGET_MB"  // 默认的内存预算，单位MB
+
+// 插件选择的耗时估计，单位毫秒，按640x480的帧计
+#define YAD_PLUGIN_DEFAULT_DETECT_COST  20.0f   // 插件没有给出检测耗时时的估计，v1插件再除以confidence
+#define YAD_CONVERT_COST_PACK           0.1f    // 多平面拼接为连续内存
+#define YAD_CONVERT_COST_YUV_TO_RGB     1.0f    // YUV转换为RGB888
+#define YAD_CONVERT_COST_RGB_TO_RGB     0.4f    // 其它RGB格式转换为RGB888
+#define YAD_CONVERT_COST_NO_ROTATE      1000.0f // 插件和框架都无法完成需要的旋转，只在没有其它方案时选择
 
 static void logCallback(int level, const char *tag, const char *file, int line, const char *function, const char *format, va_list args)
 {
@@ -39,12 +71,23 @@ PluginManager &PluginManager::getInstance()
     return instance;
 }
 
-PluginManager::PluginManager()
+PluginManager::PluginManager() :
+    plugins_(std::make_shared<PluginList>()),
+    generation_(0),
+    memory_budget_(0)
 {
     YLOGV("ctor");
     
+    const char *budget = getenv(YAD_MEMORY_BUDGET_KEY);
+    if (budget) {
+        setMemoryBudget(atoll(budget) * 1024 * 1024);
+    }
+    
     registerBuildInPlugins();
+    registerStaticPlugins();
+#ifndef YAD_STATIC_PLUGINS_ONLY
     registerExtendedPlugins();
+#endif
 }
 
 PluginManager::~PluginManager()
@@ -54,43 +97,424 @@ PluginManager::~PluginManager()
 
 size_t PluginManager::getPluginCount()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    return plugins_.size();
+    // 还没有激活的插件也计入，激活失败的不计入
+    size_t count = 0;
+    std::shared_ptr<const PluginList> plugins = getPlugins();
+    for (const PluginEntry &entry : *plugins) {
+        if (!entry.module->isFailed()) {
+            count++;
+        }
+    }
+    return count;
 }
-    
-Detector *PluginManager::createDetector(YADConfig &config)
+
+Detector *PluginManager::createDetector(YADConfig &config, std::string *pluginName, uint64_t *generation)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
+    if (pluginName) {
+        pluginName->clear();
+    }
+    if (generation) {
+        *generation = 0;
+    }
+    YADLandmarkProfile profile;
+    if (getConfigLandmarkProfile(config, &profile) != YAD_OK) {
+        return nullptr;
+    }
+    
+#if defined(__linux__)
+    // 指定了守护进程时，由yad-detectd加载插件和检测
+    if (!config[kYADServicePath].empty()) {
+        return decorateDetector(new RemoteDetector(config), nullptr, config);
+    }
+#endif
+    
+    // CPU列表非法时与StreamScheduler一样创建失败，不能静默地不绑定
+    std::vector<int> cpus;
+    if (getConfigCpus(config, kYADCpuAffinity, &cpus) != YAD_OK ||
+        getConfigCpus(config, kYADBackendAffinity, &cpus) != YAD_OK) {
+        return nullptr;
+    }
     
     int maxFaceCount = std::stoi(config[kYADMaxFaceCount]);
     YADPixelFormat pixFormat = (YADPixelFormat)std::stoi(config[kYADPixFormat]);
     YADDataType dataType = (YADDataType)std::stoi(config[kYADDataType]);
     
-    // 查询插件是否支持对应的参数，并且选择优化最好的插件
-    Plugin *plugin = nullptr;
-    float confidence = 0.0f;
-    for (auto it = plugins_.begin(); it != plugins_.end(); ++it) {
-        float newConfidence;
-        if ((*it)->sniff(config, &newConfidence)) {
-            if (newConfidence > confidence) {
-                confidence = newConfidence;
-                plugin = (*it);
+    // 查询插件是否支持对应的参数，并且选择耗时最小的插件和预处理。
+    // 选中的插件第一次使用时才加载资源，加载失败的插件被排除后重新选择。
+    // 选择和创建都在快照上进行，不持有全局锁，多路流可以同时创建detector
+    std::shared_ptr<const PluginList> plugins = getPlugins();
+    Selection selection;
+    while (true) {
+        if (!selectPlugin(*plugins, config, &selection)) {
+            // 无法找到符合要求的插件，返回空
+            YLOGW("plugin not found, maxFaceCount: %d pixFormat:%d dataType: %d",
+                  maxFaceCount, pixFormat, dataType);
+            return nullptr;
+        }
+        if (selection.entry.module->activate() == YAD_OK) {
+            break;
+        }
+    }
+    
+    YLOGI("select %s plugin, maxFaceCount: %d pixFormat: %d -> %s dataType: %d -> %s cost: %f",
+          selection.entry.plugin->getName(), maxFaceCount, pixFormat, selection.config[kYADPixFormat].c_str(),
+          dataType, selection.config[kYADDataType].c_str(), selection.cost);
+    
+    // 按该插件之前创建的detector估计增量，超出预算时拒绝
+    const std::shared_ptr<PluginModule> &module = selection.entry.module;
+    // 创建之前读取版本，创建期间重新加载时调用者会再创建一次
+    uint64_t moduleGeneration = module->getGeneration();
+    // 同一插件的创建逐个进行，增量也不会混入该插件的另一次创建。插件声明可以并发创建时不加锁
+    std::unique_lock<std::mutex> createLock(module->getCallMutex(), std::defer_lock);
+    if (!selection.caps.concurrent_create) {
+        createLock.lock();
+    }
+    MemoryUsage before;
+    getMemoryUsage(&before);
+    int64_t budget = getMemoryBudget();
+    if (budget > 0 && before.rss_bytes >= 0 && before.rss_bytes + module->estimateDetectorBytes() > budget) {
+        YLOGW("memory budget exceeded, %s plugin, rss: %lld estimate: %lld budget: %lld", module->getName().c_str(),
+              (long long)before.rss_bytes, (long long)module->estimateDetectorBytes(), (long long)budget);
+        module->addRefused();
+        return nullptr;
+    }
+    
+    // 否则调用插件创建detector，v2插件由框架完成插件不支持的转换和旋转
+    Detector *detector = selection.entry.plugin->createDetector(selection.config);
+    // detector持有模块引用并记录创建时的内存增量，插件被替换后旧的动态库在detector释放后才卸载
+    ModuleDetector *moduleDetector = nullptr;
+    if (detector) {
+        MemoryUsage after;
+        getMemoryUsage(&after);
+        moduleDetector = new ModuleDetector(detector, module, diffMemoryUsage(before, after),
+                                            selection.caps.thread_safe != 0, profile);
+        detector = moduleDetector;
+    }
+    if (createLock.owns_lock()) {
+        createLock.unlock();
+    }
+    if (detector && selection.entry.getCaps) {
+        ConversionPlan plan;
+        plan.format = (YADPixelFormat)std::stoi(selection.config[kYADPixFormat]);
+        plan.data_types = selection.caps.data_types;
+        plan.rotations = selection.caps.rotations;
+        // 预处理的并行度没有单独配置时与人脸并行共用线程池
+        auto threadsIt = config.find(kYADPreprocessThreads);
+        const char *threadsKey = threadsIt != config.end() && !threadsIt->second.empty() ? kYADPreprocessThreads
+                                                                                        : kYADWorkerThreads;
+        std::shared_ptr<WorkerPool> pool;
+        if (WorkerPool::getShared(config, threadsKey, &pool) != YAD_OK) {
+            delete detector;
+            return nullptr;
+        }
+        detector = new ConvertingDetector(detector, plan, pool);
+    }
+    if (detector && pluginName) {
+        *pluginName = module->getName();
+    }
+    if (detector && generation) {
+        *generation = moduleGeneration;
+    }
+    return decorateDetector(detector, moduleDetector, config);
+}
+
+int PluginManager::getCapabilities(YADConfig &config, PluginCaps *caps)
+{
+    if (!caps) {
+        return YAD_BAD_VALUE;
+    }
+    
+    Selection selection;
+    if (!selectPlugin(*getPlugins(), config, &selection)) {
+        return YAD_NAME_NOT_FOUND;
+    }
+    *caps = selection.caps;
+    return YAD_OK;
+}
+
+int PluginManager::loadPlugin(const std::string &libPath)
+{
+    // 加载失败的路径不记录，修复后重新扫描还能加载
+    int err = addPlugin(libPath, true);
+    if (err == YAD_OK || err == YAD_ALREADY_EXISTS) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        scanned_paths_.insert(libPath);
+    }
+    return err;
+}
+
+int PluginManager::rescanPlugins()
+{
+#ifdef YAD_STATIC_PLUGINS_ONLY
+    // 静态链接的插件在启动时已经全部注册
+    return 0;
+#else
+    std::list<std::string> pluginDirectories;
+    getPluginDirectories(pluginDirectories);
+    
+    int count = 0;
+    for (const std::string &directory : pluginDirectories) {
+        try {
+            count += registerPlugins(directory, true);
+        } catch (const std::exception &e) {
+            YLOGW("rescan %s failed: %s", directory.c_str(), e.what());
+        }
+    }
+    YLOGI("rescan plugins, loaded: %d generation: %llu", count, (unsigned long long)getGeneration());
+    return count;
+#endif
+}
+
+int PluginManager::reloadPlugin(const std::string &name, YADConfig &config)
+{
+    std::shared_ptr<PluginModule> module;
+    std::shared_ptr<const PluginList> plugins = getPlugins();
+    for (const PluginEntry &entry : *plugins) {
+        if (entry.module->getName() == name) {
+            module = entry.module;
+            break;
+        }
+    }
+    if (!module) {
+        return YAD_NAME_NOT_FOUND;
+    }
+    
+    // 加载模型可能很慢，不持有锁，期间仍可以用旧模型创建detector
+    int err = module->reload(config);
+    if (err != YAD_OK) {
+        YLOGW("reload %s plugin failed, err: %d, keep the previous model", name.c_str(), err);
+        return err;
+    }
+    generation_.fetch_add(1, std::memory_order_release);
+    YLOGI("reload %s plugin success, generation: %llu", name.c_str(), (unsigned long long)module->getGeneration());
+    return YAD_OK;
+}
+
+uint64_t PluginManager::getGeneration() const
+{
+    return generation_.load(std::memory_order_acquire);
+}
+
+uint64_t PluginManager::getGeneration(const std::string &name) const
+{
+    std::shared_ptr<const PluginList> plugins = getPlugins();
+    for (const PluginEntry &entry : *plugins) {
+        if (entry.module->getName() == name) {
+            return entry.module->getGeneration();
+        }
+    }
+    return 0;
+}
+
+void PluginManager::setMemoryBudget(int64_t bytes)
+{
+    memory_budget_.store(std::max<int64_t>(0, bytes), std::memory_order_relaxed);
+}
+
+int64_t PluginManager::getMemoryBudget() const
+{
+    return memory_budget_.load(std::memory_order_relaxed);
+}
+
+void PluginManager::getMemoryStats(std::vector<std::pair<std::string, PluginMemoryStats>> &stats)
+{
+    stats.clear();
+    std::shared_ptr<const PluginList> plugins = getPlugins();
+    for (const PluginEntry &entry : *plugins) {
+        PluginMemoryStats memory;
+        entry.module->getMemoryStats(&memory);
+        stats.push_back(std::make_pair(entry.module->getName(), memory));
+    }
+}
+
+void PluginManager::getPluginNames(std::vector<std::string> &names)
+{
+    names.clear();
+    std::shared_ptr<const PluginList> plugins = getPlugins();
+    for (const PluginEntry &entry : *plugins) {
+        names.push_back(entry.module->getName());
+    }
+}
+
+std::shared_ptr<const PluginManager::PluginList> PluginManager::getPlugins() const
+{
+    return std::atomic_load(&plugins_);
+}
+
+bool PluginManager::selectPlugin(const PluginList &plugins, YADConfig &config, Selection *selection)
+{
+    auto nameIt = config.find(kYADPluginName);
+    const std::string pluginName = nameIt != config.end() ? nameIt->second : std::string();
+    bool found = false;
+    for (const PluginEntry &entry : plugins) {
+        if (entry.module->isFailed() || (!pluginName.empty() && entry.module->getName() != pluginName)) {
+            continue;
+        }
+        Selection candidate;
+        if (entry.getCaps) {
+            if (!evaluatePlugin(entry, config, &candidate)) {
+                continue;
             }
+        } else {
+            // v1插件只能处理原始格式，没有耗时估计，按confidence折算，与原来选confidence最高的插件一致
+            float confidence;
+            bool sniffed;
+            {
+                std::lock_guard<std::mutex> lock(entry.module->getCallMutex());
+                sniffed = entry.plugin->sniff(config, &confidence);
+            }
+            if (!sniffed || confidence <= 0.0f) {
+                continue;
+            }
+            candidate.entry = entry;
+            candidate.config = config;
+            candidate.cost = YAD_PLUGIN_DEFAULT_DETECT_COST / confidence;
+            memset(&candidate.caps, 0, sizeof(candidate.caps));
+            candidate.caps.pix_formats = YAD_PLUGIN_CAP_FORMAT(std::stoi(config[kYADPixFormat]));
+            candidate.caps.data_types = YAD_PLUGIN_CAP_TYPE(std::stoi(config[kYADDataType]));
+            candidate.caps.rotations = YAD_PLUGIN_CAP_ROTATE_ALL;
+            candidate.caps.detect_cost_ms = candidate.cost;
+        }
+        
+        // 耗时相同时保留先注册的插件
+        if (!found || candidate.cost < selection->cost) {
+            *selection = candidate;
+            found = true;
         }
     }
-    // 无法找到符合要求的插件，返回空
-    if (!plugin) {
-        YLOGW("plugin not found, maxFaceCount: %d pixFormat:%d dataType: %d",
-              maxFaceCount, pixFormat, dataType);
+    return found;
+}
+
+// 帧可能使用的旋转，YAD_PLUGIN_CAP_ROTATE的组合，没有配置或无法解析时为全部
+static uint32_t getConfigRotations(YADConfig &config)
+{
+    auto it = config.find(kYADRotateModes);
+    if (it == config.end() || it->second.empty()) {
+        return YAD_PLUGIN_CAP_ROTATE_ALL;
+    }
+    uint32_t rotations = 0;
+    std::stringstream stream(it->second);
+    std::string mode;
+    while (std::getline(stream, mode, ',')) {
+        char *end;
+        long degrees = strtol(mode.c_str(), &end, 10);
+        if (end == mode.c_str() || degrees < 0 || degrees > YAD_ROTATE_270 || degrees % 90 != 0) {
+            YLOGW("invalid %s: %s", kYADRotateModes, it->second.c_str());
+            return YAD_PLUGIN_CAP_ROTATE_ALL;
+        }
+        rotations |= YAD_PLUGIN_CAP_ROTATE(degrees);
+    }
+    return rotations ? rotations : YAD_PLUGIN_CAP_ROTATE_ALL;
+}
+
+bool PluginManager::evaluatePlugin(const PluginEntry &entry, YADConfig &config, Selection *selection)
+{
+    // 以后追加的字段对旧插件保持为0
+    PluginCaps caps;
+    memset(&caps, 0, sizeof(caps));
+    int err;
+    {
+        std::lock_guard<std::mutex> lock(entry.module->getCallMutex());
+        err = entry.getCaps(config, &caps);
+    }
+    if (err != YAD_OK) {
+        return false;
+    }
+    
+    YADPixelFormat pixFormat = (YADPixelFormat)std::stoi(config[kYADPixFormat]);
+    YADDataType dataType = (YADDataType)std::stoi(config[kYADDataType]);
+    if (pixFormat <= YAD_PIX_FMT_NONE || pixFormat >= YAD_PIX_FMT_MAX ||
+        dataType <= YAD_DATA_TYPE_NONE || dataType >= YAD_DATA_TYPE_MAX) {
+        return false;
+    }
+    
+    // 可选的输入形式：原生、拼接为连续内存、转换为RGB888。框架只能转换裸数据
+    struct Candidate {
+        YADPixelFormat format;
+        YADDataType type;
+        float cost;
+    } candidates[3];
+    int count = 0;
+    bool raw = dataType == YAD_DATA_TYPE_RAW || dataType == YAD_DATA_TYPE_RAW_PLANES;
+    bool acceptRaw = (caps.data_types & YAD_PLUGIN_CAP_TYPE(YAD_DATA_TYPE_RAW)) != 0;
+    if ((caps.pix_formats & YAD_PLUGIN_CAP_FORMAT(pixFormat)) != 0) {
+        if ((caps.data_types & YAD_PLUGIN_CAP_TYPE(dataType)) != 0) {
+            candidates[count++] = {pixFormat, dataType, 0.0f};
+        } else if (raw && acceptRaw) {
+            candidates[count++] = {pixFormat, YAD_DATA_TYPE_RAW, YAD_CONVERT_COST_PACK};
+        }
+    }
+    if (raw && acceptRaw && pixFormat != YAD_PIX_FMT_RGB888 &&
+        (caps.pix_formats & YAD_PLUGIN_CAP_FORMAT(YAD_PIX_FMT_RGB888)) != 0) {
+        float cost = isYUV420(pixFormat) ? YAD_CONVERT_COST_YUV_TO_RGB : YAD_CONVERT_COST_RGB_TO_RGB;
+        candidates[count++] = {YAD_PIX_FMT_RGB888, YAD_DATA_TYPE_RAW, cost};
+    }
+    
+    // 框架只能旋转RGB，插件不支持的旋转在YUV方案下会返回YAD_ROTATE_UNSUPPORTED，这样的方案排在最后
+    uint32_t rotations = getConfigRotations(config) & ~YAD_PLUGIN_CAP_ROTATE(YAD_ROTATE_0);
+    bool rotateMissing = (caps.rotations & rotations) != rotations;
+    float detectCost = caps.detect_cost_ms > 0.0f ? caps.detect_cost_ms : YAD_PLUGIN_DEFAULT_DETECT_COST;
+    bool found = false;
+    for (int i = 0; i < count; i++) {
+        // 插件还可能因为模型等原因拒绝，以转换后的格式确认
+        YADConfig pluginConfig = config;
+        pluginConfig[kYADPixFormat] = std::to_string(candidates[i].format);
+        pluginConfig[kYADDataType] = std::to_string(candidates[i].type);
+        float confidence;
+        bool sniffed;
+        {
+            std::lock_guard<std::mutex> lock(entry.module->getCallMutex());
+            sniffed = entry.plugin->sniff(pluginConfig, &confidence);
+        }
+        if (!sniffed) {
+            continue;
+        }
+        float cost = detectCost + candidates[i].cost;
+        if (rotateMissing && isYUV420(candidates[i].format)) {
+            cost += YAD_CONVERT_COST_NO_ROTATE;
+        }
+        if (!found || cost < selection->cost) {
+            selection->entry = entry;
+            selection->config = pluginConfig;
+            selection->caps = caps;
+            selection->cost = cost;
+            found = true;
+        }
+    }
+    return found;
+}
+
+Detector *PluginManager::decorateDetector(Detector *detector, ModuleDetector *module, YADConfig &config)
+{
+    if (!detector) {
         return nullptr;
     }
     
-    YLOGI("select %s plugin, maxFaceCount: %d pixFormat: %d dataType: %d confidence: %f",
-          plugin->getName(), maxFaceCount, pixFormat, dataType, confidence);
+    // 耗时预算控制，只统计插件本身的耗时，所以放在最内层
+    auto budget = config.find(kYADFrameBudgetUs);
+    int budgetUs = budget != config.end() && !budget->second.empty() ? std::stoi(budget->second) : 0;
+    if (budgetUs > 0) {
+        detector = new AdaptiveDetector(detector, config, module);
+    }
+    
+    // 静止画面跳帧，跳过的帧不会调用插件
+    if (!config[kYADMotionThreshold].empty()) {
+        float threshold = std::stof(config[kYADMotionThreshold]);
+        int maxSkip = YAD_MOTION_DEFAULT_MAX_SKIP;
+        if (!config[kYADMotionMaxSkip].empty()) {
+            maxSkip = std::stoi(config[kYADMotionMaxSkip]);
+        }
+        if (threshold > 0.0f) {
+            detector = new MotionGatingDetector(detector, threshold, maxSkip);
+        }
+    }
     
-    // 否则调用插件创建detector
-    return plugin->createDetector(config);
+    // 指定了录制路径时，包装一层录制，放在最外层以录制所有输入帧
+    if (!config[kYADRecordPath].empty()) {
+        detector = new RecordingDetector(detector, config[kYADRecordPath]);
+    }
+    
+    return detector;
 }
 
 void PluginManager::registerBuildInPlugins()
@@ -98,6 +522,20 @@ void PluginManager::registerBuildInPlugins()
 #ifdef WITH_YAD_TT
     addPlugin(createYADetectorTTPlugin());
 #endif
+#ifdef WITH_YAD_NCNN
+    addPlugin(createYADetectorNCNNPlugin());
+#endif
+}
+
+void PluginManager::registerStaticPlugins()
+{
+    for (const StaticPluginRegistrar *registrar = StaticPluginRegistrar::getFirst(); registrar;
+         registrar = registrar->getNext()) {
+        YLOGI("found static plugin: %s priority: %d", registrar->getName(), registrar->getPriority());
+        if (!addPlugin((*registrar->getCreateFunc())())) {
+            YLOGE("register static plugin %s failed", registrar->getName());
+        }
+    }
 }
 
 void PluginManager::registerExtendedPlugins()
@@ -106,7 +544,7 @@ void PluginManager::registerExtendedPlugins()
     
     getPluginDirectories(pluginDirectories);
     for (std::list<std::string>::iterator it = pluginDirectories.begin(); it != pluginDirectories.end(); ++it) {
-        registerPlugins(*it);
+        registerPlugins(*it, false);
     }
 }
 
@@ -117,17 +555,20 @@ void PluginManager::getPluginDirectories(std::list<std::string> &pluginDirectori
     pluginDirectories.push_back(getAppLibDirectory());
     
     // 接着添加用户指定的目录，目录可以多个，以","隔开
-    char *dirs = getenv(YAD_PLUGIN_DIRS_KEY);
-    if (dirs) {
+    // strtok_r会修改字符串，拷贝一份，保证重新扫描时环境变量完整
+    const char *env = getenv(YAD_PLUGIN_DIRS_KEY);
+    if (env) {
+        std::string dirs = env;
         char *brkt;
-        for (char *dir = strtok_r(dirs, ",", &brkt); dir; dir = strtok_r(NULL, ",", &brkt)) {
+        for (char *dir = strtok_r(&dirs[0], ",", &brkt); dir; dir = strtok_r(NULL, ",", &brkt)) {
             pluginDirectories.push_back(dir);
         }
     }
 }
 
-void PluginManager::registerPlugins(std::string libDirectory)
+int PluginManager::registerPlugins(std::string libDirectory, bool replace)
 {
+    int count = 0;
     DIR *dir;
     struct dirent *ent;
     if ((dir = opendir(libDirectory.c_str())) != NULL) {
@@ -136,11 +577,24 @@ void PluginManager::registerPlugins(std::string libDirectory)
             // YLOGD("%s\n", fileName.c_str());
             std::string relativeLibPath = getRelativePluginPath(fileName);
             if (!relativeLibPath.empty()) {
-                YLOGI("found plugin: %s", fileName.c_str());
                 // 构造全路径
                 std::string fullLibPath = libDirectory + "/" + relativeLibPath;
-                // 添加插件
-                addPlugin(fullLibPath);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (scanned_paths_.count(fullLibPath)) {
+                        continue;
+                    }
+                }
+                YLOGI("found plugin: %s", fileName.c_str());
+                // 添加插件，失败的路径不记录，下次扫描时重试
+                int err = addPlugin(fullLibPath, replace);
+                if (err == YAD_OK || err == YAD_ALREADY_EXISTS) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    scanned_paths_.insert(fullLibPath);
+                }
+                if (err == YAD_OK) {
+                    count++;
+                }
             }
         }
         closedir(dir);
@@ -149,6 +603,7 @@ void PluginManager::registerPlugins(std::string libDirectory)
         msg << "opendir() err";
         throw std::runtime_error(msg.str());
     }
+    return count;
 }
 
 std::string PluginManager::mainBundlePath()
@@ -163,6 +618,7 @@ std::string PluginManager::mainBundlePath()
 
 std::string PluginManager::initMainBundlePath()
 {
+#ifdef __APPLE__
     CFBundleRef bundleRef; // 该引用无需释放
     CFURLRef urlRef = NULL;
     CFStringRef stringRef = NULL;
@@ -187,7 +643,7 @@ std::string PluginManager::initMainBundlePath()
         errmsg = "CFStringGetCString";
         goto bail;
     }
-
+    
 bail:
     if (stringRef) {
         CFRelease(stringRef);
@@ -200,14 +656,33 @@ bail:
     } else {
         return std::string(path);
     }
+#else
+    // 非Apple平台没有bundle，以可执行文件所在目录作为主目录
+    char path[PATH_MAX];
+    
+    memset(path, 0x0, PATH_MAX);
+    
+    ssize_t len = readlink("/proc/self/exe", path, PATH_MAX - 1);
+    if (len <= 0) {
+        throw std::runtime_error("readlink");
+    }
+    
+    std::string exePath(path, len);
+    std::size_t pos = exePath.rfind('/');
+    return pos == std::string::npos ? std::string(".") : exePath.substr(0, pos);
+#endif
 }
 
 std::string PluginManager::getAppLibDirectory()
 {
+#ifdef __APPLE__
     return mainBundlePath() + "/Frameworks";
+#else
+    return mainBundlePath();
+#endif
 }
 
-// 动态库插件分两种类型: YADetectorXYZ.framework 或者 libYADetectorXYZ.dylib
+// 动态库插件分三种类型: YADetectorXYZ.framework, libYADetectorXYZ.dylib 或者 libYADetectorXYZ.so
 std::string PluginManager::getRelativePluginPath(std::string &fileName)
 {
     if (std::regex_match(fileName, std::regex("YADetector(.+)\\.framework"))) {
@@ -218,80 +693,157 @@ std::string PluginManager::getRelativePluginPath(std::string &fileName)
     } else if (std::regex_match(fileName, std::regex("libYADetector(.+)\\.dylib"))) {
         // 返回形式: libYADetectorXYZ.dylib
         return fileName;
+    } else if (std::regex_match(fileName, std::regex("libYADetector(.+)\\.so"))) {
+        // 返回形式: libYADetectorXYZ.so
+        return fileName;
     }
     
     return "";
 }
 
-void PluginManager::addPlugin(const std::string &libName)
+int PluginManager::addPlugin(const std::string &libName, bool replace)
 {
     YLOGD("add plugin, lib: %s", libName.c_str());
     
+#ifdef YAD_STATIC_PLUGINS_ONLY
+    (void)replace;
+    YLOGE("dynamic plugins are disabled, libName: %s", libName.c_str());
+    return YAD_INVALID_OPERATION;
+#else
     void *handle = dlopen(libName.c_str(), RTLD_NOW);
     if (!handle) {
         YLOGE("dlopen() failed, libName: %s", libName.c_str());
-        return;
+        return YAD_NAME_NOT_FOUND;
     }
-
+    
     // XXX iOS CFBundleGetFunctionPointerForName
+    // 优先使用v2接口，没有时按v1加载。模块接管句柄，添加失败时随模块一起关闭
+    typedef PluginV2 *(*CreateYADetectorPluginV2Func)();
+    CreateYADetectorPluginV2Func createYADPluginV2 = (CreateYADetectorPluginV2Func)dlsym(handle, "createYADetectorPluginV2");
+    if (createYADPluginV2) {
+        PluginV2 *plugin = (*createYADPluginV2)();
+        if (!plugin || plugin->abi_version < 2 || !plugin->getCaps) {
+            YLOGE("invalid v2 plugin, libName: %s", libName.c_str());
+            dlclose(handle);
+            return YAD_BAD_VALUE;
+        }
+        SetQualityFunc setQuality = plugin->abi_version >= 3 ? plugin->setQuality : nullptr;
+        return addModule(std::make_shared<PluginModule>(handle, &plugin->base, plugin->getCaps, libName, setQuality),
+                         replace);
+    }
+    
     typedef Plugin *(*CreateYADetectorPluginFunc)();
     CreateYADetectorPluginFunc createYADPlugin = (CreateYADetectorPluginFunc)dlsym(handle, "createYADetectorPlugin");
     if (createYADPlugin) {
-        if (!addPlugin((*createYADPlugin)())) {
-            YLOGE("add %s plugin failed, libName: %s", libName.c_str());
-            dlclose(handle);
-        }
-    } else {
-        YLOGE("dlsym() failed, create symbols not found, libName: %s", libName.c_str());
-        dlclose(handle);
+        return addModule(std::make_shared<PluginModule>(handle, (*createYADPlugin)(), nullptr, libName), replace);
     }
+    YLOGE("dlsym() failed, create symbols not found, libName: %s", libName.c_str());
+    dlclose(handle);
+    return YAD_SYMBOLS_NOT_LOADED;
+#endif
 }
 
-bool PluginManager::addPlugin(Plugin *plugin)
+bool PluginManager::addPlugin(PluginV2 *plugin)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
+    if (!plugin) {
+        return false;
+    }
+    if (plugin->abi_version < 2 || !plugin->getCaps) {
+        YLOGE("invalid v2 plugin, abi version: %d", plugin->abi_version);
+        return false;
+    }
+    // v3追加的字段只在abi_version足够时读取，旧插件的结构体没有这些字段
+    return addPlugin(&plugin->base, plugin->getCaps, plugin->abi_version >= 3 ? plugin->setQuality : nullptr);
+}
 
+bool PluginManager::addPlugin(Plugin *plugin, GetCapsFunc getCaps, SetQualityFunc setQuality)
+{
     if (!plugin) {
         return false;
     }
+    return addModule(std::make_shared<PluginModule>(nullptr, plugin, getCaps, "", setQuality), false) == YAD_OK;
+}
+
+int PluginManager::addModule(const std::shared_ptr<PluginModule> &module, bool replace)
+{
+    Plugin *plugin = module->getPlugin();
+    if (!plugin) {
+        return YAD_BAD_VALUE;
+    }
     
     // 检查合法
     if (!plugin->getName) {
         YLOGE("plugin getName() is missing");
-        return false;
+        return YAD_BAD_VALUE;
     }
-    std::string name = plugin->getName();
-        
+    const std::string &name = module->getName();
+    
     if (!(plugin->setLog && plugin->load && plugin->sniff && plugin->createDetector)) {
         YLOGE("%s plugin implementation is missing", name.c_str());
-        return false;
+        return YAD_BAD_VALUE;
     }
     
-    // 检查重复
-    for (auto it = plugins_.begin(); it != plugins_.end(); ++it) {
-        if (*it == plugin) {
+    // 检查重复，同一路径再次dlopen得到的是同一个插件
+    std::shared_ptr<const PluginList> current = getPlugins();
+    for (const PluginEntry &entry : *current) {
+        if (entry.plugin == plugin) {
             YLOGW("%s plugin has been added", name.c_str());
-            return false;
+            return YAD_ALREADY_EXISTS;
         }
     }
-
-    // 加载资源
-    // TODO 从json配置文件中读取配置，比如路径等
-    YADConfig config;
-    int err = plugin->load(config);
-    if (err != YAD_NO_ERROR) {
-        YLOGW("load %s plugin failure", name.c_str());
-        return false;
+    
+    // 启动时只登记插件，资源在第一次被选中时加载，启动耗时不随插件数增加。
+    // 替换时先加载新版本，不持有锁，加载期间旧版本仍然可用，失败时不替换
+    if (replace) {
+        int err = module->activate();
+        if (err != YAD_OK) {
+            YLOGW("load %s plugin failure", name.c_str());
+            return err;
+        }
     }
     
     // 注册日志
     plugin->setLog(logCallback);
     
-    plugins_.push_back(plugin);
+    // 写入者之间串行，复制当前快照修改后整体发布，正在使用旧快照的读者不受影响
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::shared_ptr<PluginList> plugins = std::make_shared<PluginList>(*getPlugins());
+    for (const PluginEntry &added : *plugins) {
+        if (added.plugin == plugin) {
+            YLOGW("%s plugin has been added", name.c_str());
+            return YAD_ALREADY_EXISTS;
+        }
+    }
+    
+    // 替换时新版本占用旧版本的位置，保持注册顺序决定的优先级
+    PluginEntry entry = {plugin, module->getCapsFunc(), module};
+    bool replaced = false;
+    if (replace) {
+        for (auto it = plugins->begin(); it != plugins->end();) {
+            if (it->module->getName() != name) {
+                ++it;
+            } else if (!replaced) {
+                YLOGI("replace %s plugin, %s -> %s", name.c_str(), it->module->getPath().c_str(), module->getPath().c_str());
+                module->setGeneration(it->module->getGeneration() + 1);
+                *it = entry;
+                replaced = true;
+                ++it;
+            } else {
+                it = plugins->erase(it);
+            }
+        }
+    }
+    if (!replaced) {
+        plugins->push_back(entry);
+    }
+    std::atomic_store(&plugins_, std::shared_ptr<const PluginList>(plugins));
+    if (replaced) {
+        generation_.fetch_add(1, std::memory_order_release);
+    }
     
-    YLOGI("add %s plugin success", name.c_str());
+    YLOGI("add %s plugin success, abi version: %d", name.c_str(), module->getSetQualityFunc() ? 3 : (entry.getCaps ? 2 : 1));
     
-    return true;
+    return YAD_OK;
 }
 
 }; // namespace yad
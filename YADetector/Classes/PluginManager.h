@@ -7,10 +7,17 @@
 #define YAD_PLUGIN_MANAGER_H
 
 #include "YADetector.h"
+#include "PluginModule.h"
 
+#include <stdint.h>
+#include <atomic>
 #include <mutex>
 #include <list>
+#include <memory>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace yad {
 
@@ -19,9 +26,46 @@ public:
     static PluginManager &getInstance();
     
     size_t getPluginCount();
-    Detector *createDetector(YADConfig &config);
+    // pluginName不为空时返回选中插件的名称，generation为创建前该插件的版本，远程检测时分别为空和0
+    Detector *createDetector(YADConfig &config, std::string *pluginName = nullptr, uint64_t *generation = nullptr);
+    // 按配置选出的插件的能力，v1插件只能给出保守的描述，找不到插件时返回YAD_NAME_NOT_FOUND
+    int getCapabilities(YADConfig &config, PluginCaps *caps);
+    // 加载插件动态库，与已有插件同名时替换，旧版本在最后一个Detector释放后卸载
+    int loadPlugin(const std::string &libPath);
+    // 加载插件目录中之前没有扫描到的动态库，返回加载的个数
+    int rescanPlugins();
+    // 以新配置重新加载插件的模型，插件的load()负责在新模型可用后再替换
+    int reloadPlugin(const std::string &name, YADConfig &config);
+    // 任一插件替换或重新加载时加一，变化后再按名称查看具体插件的版本
+    uint64_t getGeneration() const;
+    // 指定插件的版本，插件不存在时为0
+    uint64_t getGeneration(const std::string &name) const;
+    // 已注册插件的名称，按注册顺序
+    void getPluginNames(std::vector<std::string> &names);
+    // 进程常驻内存的预算(字节)，0表示不限。超出时createDetector返回空，不会把进程推入swap
+    void setMemoryBudget(int64_t bytes);
+    int64_t getMemoryBudget() const;
+    // 各插件的内存统计，按注册顺序
+    void getMemoryStats(std::vector<std::pair<std::string, PluginMemoryStats>> &stats);
     
 private:
+    struct PluginEntry {
+        Plugin *plugin;
+        GetCapsFunc getCaps;    // v1插件为空
+        std::shared_ptr<PluginModule> module;
+    };
+    
+    // 已注册插件的不可变快照，注册和替换时复制后整体发布，读者不加锁
+    typedef std::vector<PluginEntry> PluginList;
+    
+    // 插件加上预处理的方案，cost为估计的单帧耗时(毫秒)
+    struct Selection {
+        PluginEntry entry;      // 持有模块引用，快照被替换后仍然有效
+        YADConfig config;       // 送给插件的配置，格式和数据类型为插件原生支持的
+        PluginCaps caps;
+        float cost;
+    };
+    
     PluginManager();
     ~PluginManager();
     PluginManager(const PluginManager &) = delete;
@@ -30,18 +74,35 @@ private:
     PluginManager &operator=(PluginManager&&) = delete;
     
     void registerBuildInPlugins();
+    // YAD_REGISTER_STATIC_PLUGIN登记的静态链接插件
+    void registerStaticPlugins();
+    // 扫描插件目录并dlopen，定义YAD_STATIC_PLUGINS_ONLY时不调用。YADetectorTT加载SDK的dlopen不受影响
     void registerExtendedPlugins();
-    void registerPlugins(std::string libDirectory);
+    // replace为true时替换同名插件，启动时的注册保留同名插件，按注册顺序决定优先级
+    int registerPlugins(std::string libDirectory, bool replace);
     void getPluginDirectories(std::list<std::string> &libDirectories);
     std::string mainBundlePath();
     std::string initMainBundlePath();
     std::string getAppLibDirectory(); // 获取应用程序的库目录
     std::string getRelativePluginPath(std::string &fileName); // 获取插件相对路径
-    void addPlugin(const std::string &libName);
-    bool addPlugin(Plugin *plugin);
+    int addPlugin(const std::string &libName, bool replace);
+    bool addPlugin(Plugin *plugin, GetCapsFunc getCaps = nullptr, SetQualityFunc setQuality = nullptr);
+    bool addPlugin(PluginV2 *plugin);
+    int addModule(const std::shared_ptr<PluginModule> &module, bool replace);
+    // 当前发布的插件快照
+    std::shared_ptr<const PluginList> getPlugins() const;
+    // 在快照中选出检测耗时加转换耗时最小的插件
+    bool selectPlugin(const PluginList &plugins, YADConfig &config, Selection *selection);
+    // 评估一个v2插件在给定输入下的最优预处理方案
+    bool evaluatePlugin(const PluginEntry &entry, YADConfig &config, Selection *selection);
+    // 按配置给插件创建的detector添加耗时预算、跳帧、录制等包装，module为插件的detector，远程检测时为空
+    Detector *decorateDetector(Detector *detector, ModuleDetector *module, YADConfig &config);
     
-    std::mutex mutex_;
-    std::list<Plugin *> plugins_;
+    std::mutex mutex_;                      // 只在注册、替换插件时使用，选择和创建detector不加锁
+    std::shared_ptr<const PluginList> plugins_; // 通过std::atomic_load/atomic_store访问
+    std::set<std::string> scanned_paths_;   // 加载成功或已存在的插件路径，重新扫描时跳过，由mutex_保护
+    std::atomic<uint64_t> generation_;      // 所有插件版本变化的总次数
+    std::atomic<int64_t> memory_budget_;
 };
 
 }; // namespace yad
@@ -0,0 +1,275 @@
+//
+//  PluginModule.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADModule"
+#include "LogMacros.h"
+
+#include "PluginModule.h"
+
+#ifndef YAD_STATIC_PLUGINS_ONLY
+#include <dlfcn.h>
+#endif
+#include <string.h>
+
+namespace yad {
+
+enum {
+    kModuleInactive = 0,
+    kModuleActive,
+    kModuleFailed,
+};
+
+#pragma mark PluginModule
+
+PluginModule::PluginModule(void *handle, Plugin *plugin, GetCapsFunc getCaps, const std::string &path,
+                           SetQualityFunc setQuality) :
+    handle_(handle),
+    plugin_(plugin),
+    get_caps_(getCaps),
+    set_quality_(setQuality),
+    path_(path),
+    state_(kModuleInactive),
+    generation_(0),
+    activate_err_(YAD_NO_INIT),
+    created_rss_bytes_(0)
+{
+    memset(&memory_, 0, sizeof(memory_));
+    if (plugin_ && plugin_->getName) {
+        name_ = plugin_->getName();
+    }
+    YLOGV("ctor, name: %s path: %s", name_.c_str(), path_.c_str());
+}
+
+PluginModule::~PluginModule()
+{
+    YLOGV("dtor, name: %s path: %s", name_.c_str(), path_.c_str());
+    
+#ifndef YAD_STATIC_PLUGINS_ONLY
+    if (handle_) {
+        YLOGI("unload %s plugin, path: %s", name_.c_str(), path_.c_str());
+        dlclose(handle_);
+        handle_ = nullptr;
+    }
+#endif
+}
+
+Plugin *PluginModule::getPlugin() const
+{
+    return plugin_;
+}
+
+GetCapsFunc PluginModule::getCapsFunc() const
+{
+    return get_caps_;
+}
+
+SetQualityFunc PluginModule::getSetQualityFunc() const
+{
+    return set_quality_;
+}
+
+const std::string &PluginModule::getName() const
+{
+    return name_;
+}
+
+const std::string &PluginModule::getPath() const
+{
+    return path_;
+}
+
+bool PluginModule::isDynamic() const
+{
+    return handle_ != nullptr;
+}
+
+int PluginModule::activate()
+{
+    if (state_.load(std::memory_order_acquire) == kModuleActive) {
+        return YAD_OK;
+    }
+    
+    std::lock_guard<std::mutex> lock(activate_mutex_);
+    if (state_.load(std::memory_order_relaxed) != kModuleInactive) {
+        return activate_err_;
+    }
+    
+    // TODO 从json配置文件中读取配置，比如路径等
+    YADConfig config;
+    MemoryUsage before, after;
+    getMemoryUsage(&before);
+    activate_err_ = plugin_->load(config);
+    getMemoryUsage(&after);
+    if (activate_err_ != YAD_OK) {
+        YLOGW("activate %s plugin failed, err: %d", name_.c_str(), activate_err_);
+        state_.store(kModuleFailed, std::memory_order_release);
+        return activate_err_;
+    }
+    setLoadMemory(diffMemoryUsage(before, after));
+    state_.store(kModuleActive, std::memory_order_release);
+    YLOGI("activate %s plugin success", name_.c_str());
+    return YAD_OK;
+}
+
+bool PluginModule::isFailed() const
+{
+    return state_.load(std::memory_order_acquire) == kModuleFailed;
+}
+
+int PluginModule::reload(YADConfig &config)
+{
+    std::lock_guard<std::mutex> lock(activate_mutex_);
+    
+    MemoryUsage before, after;
+    getMemoryUsage(&before);
+    int err = plugin_->load(config);
+    getMemoryUsage(&after);
+    if (err != YAD_OK) {
+        // 之前激活成功的资源仍然可用
+        return err;
+    }
+    setLoadMemory(diffMemoryUsage(before, after));
+    activate_err_ = YAD_OK;
+    state_.store(kModuleActive, std::memory_order_release);
+    generation_.fetch_add(1, std::memory_order_release);
+    return YAD_OK;
+}
+
+uint64_t PluginModule::getGeneration() const
+{
+    return generation_.load(std::memory_order_acquire);
+}
+
+void PluginModule::setGeneration(uint64_t generation)
+{
+    generation_.store(generation, std::memory_order_release);
+}
+
+void PluginModule::setLoadMemory(const MemoryUsage &delta)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    memory_.load_rss_bytes = delta.rss_bytes;
+    memory_.load_heap_bytes = delta.heap_bytes;
+}
+
+void PluginModule::addDetector(const MemoryUsage &delta)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    memory_.detectors++;
+    memory_.detector_rss_bytes += delta.rss_bytes;
+    memory_.detector_heap_bytes += delta.heap_bytes;
+    memory_.created++;
+    created_rss_bytes_ += delta.rss_bytes;
+}
+
+void PluginModule::removeDetector(const MemoryUsage &delta)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    memory_.detectors--;
+    memory_.detector_rss_bytes -= delta.rss_bytes;
+    memory_.detector_heap_bytes -= delta.heap_bytes;
+}
+
+void PluginModule::addRefused()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    memory_.refused++;
+}
+
+int64_t PluginModule::estimateDetectorBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (memory_.created == 0 || created_rss_bytes_ <= 0) {
+        return 0;
+    }
+    return created_rss_bytes_ / (int64_t)memory_.created;
+}
+
+void PluginModule::getMemoryStats(PluginMemoryStats *stats)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    *stats = memory_;
+}
+
+std::mutex &PluginModule::getCallMutex()
+{
+    return call_mutex_;
+}
+
+#pragma mark ModuleDetector
+
+ModuleDetector::ModuleDetector(Detector *detector, const std::shared_ptr<PluginModule> &module, const MemoryUsage &cost,
+                               bool threadSafe, YADLandmarkProfile profile) :
+    module_(module),
+    detector_(detector),
+    cost_(cost),
+    native_faces_(module->getCapsFunc() != nullptr),
+    thread_safe_(threadSafe),
+    landmark_profile_(profile)
+{
+    module_->addDetector(cost_);
+}
+
+ModuleDetector::~ModuleDetector()
+{
+    detector_.reset();
+    module_->removeDetector(cost_);
+}
+
+int ModuleDetector::initCheck() const
+{
+    return detector_ ? detector_->initCheck() : YAD_NO_INIT;
+}
+
+// 插件的Detector可能按没有该虚函数的头文件编译，不能转发
+YADLandmarkProfile ModuleDetector::getLandmarkProfile() const
+{
+    return landmark_profile_;
+}
+
+int ModuleDetector::detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo)
+{
+    if (!detector_) {
+        return YAD_NO_INIT;
+    }
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (!thread_safe_) {
+        lock.lock();
+    }
+    return detector_->detect(detectImage, detectInfo, featureInfo);
+}
+
+int ModuleDetector::detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults)
+{
+    if (!detector_) {
+        return YAD_NO_INIT;
+    }
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (!thread_safe_) {
+        lock.lock();
+    }
+    // 限定调用基类的默认实现，不经过v1插件的虚表，其中只会调用detect()
+    return native_faces_ ? detector_->detectFaces(detectImage, detectInfo, faceResults)
+                         : detector_->Detector::detectFaces(detectImage, detectInfo, faceResults);
+}
+
+int ModuleDetector::setQuality(const YADDetectQuality *quality)
+{
+    if (!detector_ || !quality) {
+        return YAD_BAD_VALUE;
+    }
+    SetQualityFunc setQuality = module_->getSetQualityFunc();
+    if (!setQuality) {
+        return YAD_INVALID_OPERATION;
+    }
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (!thread_safe_) {
+        lock.lock();
+    }
+    return setQuality(detector_.get(), quality);
+}
+
+}; // namespace yad
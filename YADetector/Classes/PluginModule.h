@@ -0,0 +1,109 @@
+//
+//  PluginModule.h
+//  YAD
+//
+
+#ifndef YAD_PLUGIN_MODULE_H
+#define YAD_PLUGIN_MODULE_H
+
+#include "YADetector.h"
+#include "MemoryUsage.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace yad {
+
+// 一个已加载的插件，持有动态库句柄，内置插件的句柄为空。
+// PluginManager和插件创建的每个Detector各持有一份引用，插件被新版本替换后，最后一个Detector释放时才卸载动态库。
+// 发现插件时只读取名称和能力，模型等资源在第一次被选中时由activate()加载
+class PluginModule {
+public:
+    PluginModule(void *handle, Plugin *plugin, GetCapsFunc getCaps, const std::string &path,
+                 SetQualityFunc setQuality = nullptr);
+    ~PluginModule();
+    
+    Plugin *getPlugin() const;
+    GetCapsFunc getCapsFunc() const;
+    SetQualityFunc getSetQualityFunc() const;
+    const std::string &getName() const;
+    const std::string &getPath() const;
+    bool isDynamic() const;
+    
+    // 调用插件的load()，多个线程同时调用时只执行一次，之后返回缓存的结果
+    int activate();
+    // 激活失败的插件不再参与选择
+    bool isFailed() const;
+    // 以新配置重新调用load()，成功后视为已激活，版本加一
+    int reload(YADConfig &config);
+    // 该插件的版本，重新加载时加一，替换时新模块接着旧模块的版本
+    uint64_t getGeneration() const;
+    void setGeneration(uint64_t generation);
+    
+    void setLoadMemory(const MemoryUsage &delta);
+    void addDetector(const MemoryUsage &delta);
+    void removeDetector(const MemoryUsage &delta);
+    void addRefused();
+    // 按之前创建的detector估计新建一个的常驻内存增量，没有创建过时为0
+    int64_t estimateDetectorBytes();
+    void getMemoryStats(PluginMemoryStats *stats);
+    // 串行调用插件的sniff、getCaps和createDetector，插件声明PluginCaps::concurrent_create时创建不加锁
+    std::mutex &getCallMutex();
+    
+private:
+    PluginModule(const PluginModule &);
+    PluginModule &operator=(const PluginModule &);
+    
+    void *handle_;
+    Plugin *plugin_;
+    GetCapsFunc get_caps_;
+    SetQualityFunc set_quality_;
+    std::string name_;
+    std::string path_;
+    std::mutex activate_mutex_;
+    std::atomic<int> state_;
+    std::atomic<uint64_t> generation_;
+    int activate_err_;
+    std::mutex mutex_;
+    std::mutex call_mutex_;
+    PluginMemoryStats memory_;
+    int64_t created_rss_bytes_;     // 所有创建过的detector的增量之和，用于估计
+};
+
+// 持有插件模块引用的Detector，保证正在执行的detect()和插件Detector析构完成之前动态库不会被卸载，
+// 析构时从模块的内存统计中减去创建时的增量。
+// v1插件按没有detectFaces的旧虚表编译，框架不能调用该虚函数，由这里通过detect()实现
+class ModuleDetector : public Detector {
+public:
+    // threadSafe为PluginCaps::thread_safe，为false时串行调用插件的Detector。profile为创建时的kYADLandmarkProfile
+    ModuleDetector(Detector *detector, const std::shared_ptr<PluginModule> &module, const MemoryUsage &cost,
+                   bool threadSafe, YADLandmarkProfile profile);
+    virtual ~ModuleDetector();
+    
+    int initCheck() const override;
+    int detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo) override;
+    int detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults) override;
+    YADLandmarkProfile getLandmarkProfile() const override;
+    // 通过插件的setQuality设置检测质量，插件不支持时返回YAD_INVALID_OPERATION
+    int setQuality(const YADDetectQuality *quality);
+    
+private:
+    ModuleDetector(const ModuleDetector &);
+    ModuleDetector &operator=(const ModuleDetector &);
+    
+    // 析构顺序与声明顺序相反，先析构插件Detector再释放模块
+    std::shared_ptr<PluginModule> module_;
+    std::unique_ptr<Detector> detector_;
+    MemoryUsage cost_;
+    bool native_faces_;     // 插件Detector的虚表是否包含detectFaces，v2插件才有
+    bool thread_safe_;
+    YADLandmarkProfile landmark_profile_;
+    std::mutex mutex_;      // 插件不是线程安全时，多个线程同时使用同一个Detector也逐个调用
+};
+
+}; // namespace yad
+
+#endif /* YAD_PLUGIN_MODULE_H */
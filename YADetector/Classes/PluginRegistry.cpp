@@ -0,0 +1,68 @@
+//
+//  PluginRegistry.cpp
+//  YAD
+//
+
+#include "PluginRegistry.h"
+
+#include <mutex>
+
+namespace yad {
+
+// 静态初始化期间使用，不能依赖其它全局对象的构造顺序，用函数内静态变量
+static std::mutex &getRegistryMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static StaticPluginRegistrar *&getRegistryHead()
+{
+    static StaticPluginRegistrar *head = nullptr;
+    return head;
+}
+
+StaticPluginRegistrar::StaticPluginRegistrar(const char *name, CreatePluginV2Func create, int priority) :
+    name_(name),
+    create_(create),
+    priority_(priority),
+    next_(nullptr)
+{
+    // 按priority插入，相同时保持登记顺序
+    std::lock_guard<std::mutex> lock(getRegistryMutex());
+    StaticPluginRegistrar **link = &getRegistryHead();
+    while (*link && (*link)->priority_ <= priority_) {
+        link = &(*link)->next_;
+    }
+    next_ = *link;
+    *link = this;
+}
+
+// static
+const StaticPluginRegistrar *StaticPluginRegistrar::getFirst()
+{
+    std::lock_guard<std::mutex> lock(getRegistryMutex());
+    return getRegistryHead();
+}
+
+const char *StaticPluginRegistrar::getName() const
+{
+    return name_;
+}
+
+CreatePluginV2Func StaticPluginRegistrar::getCreateFunc() const
+{
+    return create_;
+}
+
+int StaticPluginRegistrar::getPriority() const
+{
+    return priority_;
+}
+
+const StaticPluginRegistrar *StaticPluginRegistrar::getNext() const
+{
+    return next_;
+}
+
+}; // namespace yad
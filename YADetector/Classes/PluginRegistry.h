@@ -0,0 +1,46 @@
+//
+//  PluginRegistry.h
+//  YAD
+//
+
+#ifndef YAD_PLUGIN_REGISTRY_H
+#define YAD_PLUGIN_REGISTRY_H
+
+#include "YADetector.h"
+
+namespace yad {
+
+typedef PluginV2 *(*CreatePluginV2Func)();
+
+// 静态链接插件的注册项，通过YAD_REGISTER_STATIC_PLUGIN在静态初始化时登记，不分配内存。
+// PluginManager启动时在内置插件之后按priority升序注册，不扫描目录也不dlopen
+class StaticPluginRegistrar {
+public:
+    StaticPluginRegistrar(const char *name, CreatePluginV2Func create, int priority);
+    
+    // 按priority升序的第一个注册项，没有时返回nullptr
+    static const StaticPluginRegistrar *getFirst();
+    
+    const char *getName() const;
+    CreatePluginV2Func getCreateFunc() const;
+    int getPriority() const;
+    const StaticPluginRegistrar *getNext() const;
+    
+private:
+    StaticPluginRegistrar(const StaticPluginRegistrar &);
+    StaticPluginRegistrar &operator=(const StaticPluginRegistrar &);
+    
+    const char *name_;
+    CreatePluginV2Func create_;
+    int priority_;
+    StaticPluginRegistrar *next_;
+};
+
+}; // namespace yad
+
+// 在插件的一个源文件中使用，name为标识符，create返回插件的PluginV2对象，priority越小优先级越高。
+// 静态库中只有注册项被引用的目标文件才会被链接，链接插件静态库时需要-Wl,--whole-archive(Apple为-force_load)
+#define YAD_REGISTER_STATIC_PLUGIN(name, create, priority) \
+    static yad::StaticPluginRegistrar s_yad_static_plugin_##name(#name, create, priority)
+
+#endif /* YAD_PLUGIN_REGISTRY_H */
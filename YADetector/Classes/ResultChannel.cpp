@@ -0,0 +1,193 @@
+//
+//  ResultChannel.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADChannel"
+#include "LogMacros.h"
+
+#include "ResultChannel.h"
+
+#include <algorithm>
+
+#define YAD_RESULT_SLOT_WRITING     0x80000000u
+
+namespace yad {
+
+#pragma mark ResultSnapshot
+
+ResultSnapshot::ResultSnapshot() :
+    channel_(nullptr),
+    index_(-1)
+{
+}
+
+ResultSnapshot::ResultSnapshot(ResultSnapshot &&other) :
+    channel_(other.channel_),
+    index_(other.index_)
+{
+    other.channel_ = nullptr;
+    other.index_ = -1;
+}
+
+ResultSnapshot &ResultSnapshot::operator=(ResultSnapshot &&other)
+{
+    if (this != &other) {
+        release();
+        channel_ = other.channel_;
+        index_ = other.index_;
+        other.channel_ = nullptr;
+        other.index_ = -1;
+    }
+    return *this;
+}
+
+ResultSnapshot::~ResultSnapshot()
+{
+    release();
+}
+
+const YADFeatureInfo *ResultSnapshot::get() const
+{
+    return channel_ ? &channel_->slots_[index_].info : nullptr;
+}
+
+uint64_t ResultSnapshot::getSequence() const
+{
+    return channel_ ? channel_->slots_[index_].sequence : 0;
+}
+
+void ResultSnapshot::release()
+{
+    if (channel_) {
+        channel_->release(index_);
+        channel_ = nullptr;
+        index_ = -1;
+    }
+}
+
+#pragma mark ResultChannel
+
+ResultChannel::ResultChannel(int maxReaders) :
+    num_slots_(std::max(1, maxReaders) + 2),
+    slots_(new Slot[num_slots_]),
+    writing_(-1),
+    next_sequence_(1),
+    latest_(-1),
+    latest_sequence_(0)
+{
+    YLOGV("ctor, slots: %d", num_slots_);
+    
+    for (int i = 0; i < num_slots_; i++) {
+        slots_[i].state.store(0, std::memory_order_relaxed);
+        slots_[i].sequence = 0;
+        slots_[i].info.num_faces = 0;
+    }
+}
+
+ResultChannel::~ResultChannel()
+{
+    YLOGV("dtor");
+}
+
+YADFeatureInfo *ResultChannel::beginWrite()
+{
+    if (writing_ >= 0) {
+        return &slots_[writing_].info;
+    }
+    
+    // 最新结果所在的槽要留给读者，其余没有读者持有的槽都可以写
+    int latest = latest_.load(std::memory_order_relaxed);
+    for (int i = 0; i < num_slots_; i++) {
+        if (i == latest) {
+            continue;
+        }
+        uint32_t expected = 0;
+        if (slots_[i].state.compare_exchange_strong(expected, YAD_RESULT_SLOT_WRITING, std::memory_order_acquire,
+                                                    std::memory_order_relaxed)) {
+            writing_ = i;
+            return &slots_[i].info;
+        }
+    }
+    YLOGW("no free slot, too many readers");
+    return nullptr;
+}
+
+uint64_t ResultChannel::publish()
+{
+    if (writing_ < 0) {
+        return 0;
+    }
+    
+    Slot &slot = slots_[writing_];
+    slot.sequence = next_sequence_++;
+    latest_.store(writing_, std::memory_order_release);
+    latest_sequence_.store(slot.sequence, std::memory_order_release);
+    // 清除写者标记之后读者才能持有该槽，release保证读者看到完整的结果
+    slot.state.fetch_sub(YAD_RESULT_SLOT_WRITING, std::memory_order_release);
+    writing_ = -1;
+    return slot.sequence;
+}
+
+void ResultChannel::cancelWrite()
+{
+    if (writing_ >= 0) {
+        slots_[writing_].state.fetch_sub(YAD_RESULT_SLOT_WRITING, std::memory_order_release);
+        writing_ = -1;
+    }
+}
+
+int ResultChannel::detect(Detector *detector, YADDetectImage *detectImage, YADDetectInfo *detectInfo)
+{
+    if (!detector) {
+        return YAD_BAD_VALUE;
+    }
+    YADFeatureInfo *info = beginWrite();
+    if (!info) {
+        return YAD_WOULD_BLOCK;
+    }
+    
+    int err = detector->detect(detectImage, detectInfo, info);
+    if (err == YAD_OK) {
+        publish();
+    } else {
+        cancelWrite();
+    }
+    return err;
+}
+
+int ResultChannel::acquire(ResultSnapshot *snapshot)
+{
+    if (!snapshot) {
+        return YAD_BAD_VALUE;
+    }
+    snapshot->release();
+    
+    while (true) {
+        int index = latest_.load(std::memory_order_acquire);
+        if (index < 0) {
+            return YAD_NOT_ENOUGH_DATA;
+        }
+        // 读到下标之后写者可能已经发布了新结果并开始复用这个槽，此时换成新的最新结果
+        uint32_t state = slots_[index].state.fetch_add(1, std::memory_order_acquire);
+        if ((state & YAD_RESULT_SLOT_WRITING) == 0) {
+            snapshot->channel_ = this;
+            snapshot->index_ = index;
+            return YAD_OK;
+        }
+        release(index);
+    }
+}
+
+uint64_t ResultChannel::getSequence() const
+{
+    return latest_sequence_.load(std::memory_order_acquire);
+}
+
+void ResultChannel::release(int index)
+{
+    slots_[index].state.fetch_sub(1, std::memory_order_release);
+}
+
+}; // namespace yad
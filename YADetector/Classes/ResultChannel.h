@@ -0,0 +1,93 @@
+//
+//  ResultChannel.h
+//  YAD
+//
+
+#ifndef YAD_RESULT_CHANNEL_H
+#define YAD_RESULT_CHANNEL_H
+
+#include "YADetector.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+namespace yad {
+
+#define YAD_RESULT_CHANNEL_DEFAULT_READERS  2   // 默认同时持有快照的读者数
+
+class ResultChannel;
+
+// 读者持有的一份结果，持有期间该槽不会被写者覆盖，析构时归还。只能移动，不能拷贝
+class ResultSnapshot {
+public:
+    ResultSnapshot();
+    ResultSnapshot(ResultSnapshot &&other);
+    ResultSnapshot &operator=(ResultSnapshot &&other);
+    ~ResultSnapshot();
+    
+    // 没有持有结果时返回空
+    const YADFeatureInfo *get() const;
+    // 结果的序号，从1开始，每次publish加1
+    uint64_t getSequence() const;
+    void release();
+    
+private:
+    friend class ResultChannel;
+    
+    ResultSnapshot(const ResultSnapshot &) = delete;
+    ResultSnapshot &operator=(const ResultSnapshot &) = delete;
+    
+    ResultChannel *channel_;
+    int index_;
+};
+
+// 单写者多读者的最新结果通道，用于检测线程把结果交给渲染等线程。
+// 结果存放在maxReaders + 2个槽中：一个是最新结果，一个供写者写入，其余留给读者持有。
+// 写者直接在空闲槽中detect，发布时只交换槽的下标；读者引用槽中的结果，双方都不加锁也不拷贝YADFeatureInfo。
+// 读者只在写者恰好复用它读到的槽时重试，写者从不等待读者。
+class ResultChannel {
+public:
+    explicit ResultChannel(int maxReaders = YAD_RESULT_CHANNEL_DEFAULT_READERS);
+    ~ResultChannel();
+    
+    // 写者: 获取一个空闲槽直接写入，之后必须调用publish或cancelWrite。
+    // 同时持有快照的读者超过maxReaders时可能没有空闲槽，返回空
+    YADFeatureInfo *beginWrite();
+    // 发布beginWrite得到的结果，返回其序号
+    uint64_t publish();
+    void cancelWrite();
+    // 写者: 检测一帧并发布，失败时不发布，读者仍读到上一次的结果
+    int detect(Detector *detector, YADDetectImage *detectImage, YADDetectInfo *detectInfo);
+    
+    // 读者: 获取最新的结果，还没有发布过结果时返回YAD_NOT_ENOUGH_DATA
+    int acquire(ResultSnapshot *snapshot);
+    // 读者: 最新结果的序号，没有结果时为0，用于判断是否有新结果而不持有槽
+    uint64_t getSequence() const;
+    
+private:
+    friend class ResultSnapshot;
+    
+    struct Slot {
+        // 高位为写者标记，低位为持有该槽的读者数
+        std::atomic<uint32_t> state;
+        uint64_t sequence;
+        YADFeatureInfo info;
+    };
+    
+    ResultChannel(const ResultChannel &) = delete;
+    ResultChannel &operator=(const ResultChannel &) = delete;
+    
+    void release(int index);
+    
+    int num_slots_;
+    std::unique_ptr<Slot[]> slots_;
+    int writing_;                   // 只由写者访问
+    uint64_t next_sequence_;        // 只由写者访问
+    std::atomic<int> latest_;
+    std::atomic<uint64_t> latest_sequence_;
+};
+
+}; // namespace yad
+
+#endif /* YAD_RESULT_CHANNEL_H */
@@ -0,0 +1,525 @@
+#if defined(__linux__)
+
+//
+//  DetectorService.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADSvc"
+#include "LogMacros.h"
+
+#include "DetectorService.h"
+#include "ImageUtils.h"
+#include "WorkerPool.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <map>
+
+// 唤醒管道中的命令
+#define YAD_SERVICE_WAKE_STOP       0
+#define YAD_SERVICE_WAKE_RELOAD     1
+
+namespace yad {
+
+DetectorService::DetectorService() :
+    listen_fd_(-1),
+    max_threads_(1)
+{
+    wake_fds_[0] = wake_fds_[1] = -1;
+}
+
+DetectorService::~DetectorService()
+{
+    while (!clients_.empty()) {
+        removeClient(clients_.size() - 1);
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        unlink(path_.c_str());
+    }
+    for (int i = 0; i < 2; i++) {
+        if (wake_fds_[i] >= 0) {
+            close(wake_fds_[i]);
+        }
+    }
+}
+
+int DetectorService::start(const std::string &path, int numThreads)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return YAD_BAD_VALUE;
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    
+    if (pipe2(wake_fds_, O_CLOEXEC | O_NONBLOCK) < 0) {
+        return YAD_UNKNOWN_ERROR;
+    }
+    
+    // SEQPACKET保留消息边界，一次recv对应一条完整消息
+    listen_fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        YLOGE("socket() failed, errno: %d", errno);
+        return YAD_UNKNOWN_ERROR;
+    }
+    unlink(path.c_str());
+    if (bind(listen_fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd_, SOMAXCONN) < 0) {
+        YLOGE("bind() or listen() failed, path: %s errno: %d", path.c_str(), errno);
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return YAD_PERMISSION_DENIED;
+    }
+    
+    path_ = path;
+    max_threads_ = std::max(1, numThreads);
+    worker_pool_ = WorkerPool::getShared(numThreads);
+    
+    YLOGI("listening on %s", path.c_str());
+    return YAD_OK;
+}
+
+int DetectorService::run()
+{
+    if (listen_fd_ < 0) {
+        return YAD_NO_INIT;
+    }
+    
+    std::vector<struct pollfd> fds;
+    std::vector<Request> batch;
+    while (true) {
+        fds.clear();
+        fds.push_back({wake_fds_[0], POLLIN, 0});
+        fds.push_back({listen_fd_, POLLIN, 0});
+        for (auto &client : clients_) {
+            fds.push_back({client->fd, POLLIN, 0});
+        }
+        
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            YLOGE("poll() failed, errno: %d", errno);
+            return YAD_UNKNOWN_ERROR;
+        }
+        if (fds[0].revents && !handleWake()) {
+            break;
+        }
+        
+        // 收集本轮所有客户端的请求，断开和发送超时的客户端从后往前删除
+        batch.clear();
+        std::vector<bool> closed(clients_.size(), false);
+        for (size_t i = 0; i < clients_.size(); i++) {
+            if (fds[i + 2].revents && !readClient(clients_[i].get(), batch)) {
+                closed[i] = true;
+            }
+        }
+        processBatch(batch);
+        for (size_t i = clients_.size(); i-- > 0;) {
+            if (closed[i] || clients_[i]->dead) {
+                removeClient(i);
+            }
+        }
+        
+        if (fds[1].revents & POLLIN) {
+            acceptClient();
+        }
+    }
+    
+    YLOGI("stopped");
+    return YAD_OK;
+}
+
+void DetectorService::stop()
+{
+    char c = YAD_SERVICE_WAKE_STOP;
+    if (write(wake_fds_[1], &c, 1) < 0) {
+        // pipe已满说明已经通知过
+    }
+}
+
+void DetectorService::reload()
+{
+    char c = YAD_SERVICE_WAKE_RELOAD;
+    if (write(wake_fds_[1], &c, 1) < 0) {
+        // pipe已满时丢弃，已有的命令会先被处理
+    }
+}
+
+bool DetectorService::handleWake()
+{
+    bool reload = false;
+    char commands[64];
+    ssize_t n;
+    while ((n = read(wake_fds_[0], commands, sizeof(commands))) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (commands[i] == YAD_SERVICE_WAKE_STOP) {
+                return false;
+            }
+            reload = true;
+        }
+    }
+    
+    // 新插件在这里加载，客户端在各自的下一批请求之前切换
+    if (reload) {
+        int count = Detector::RescanPlugins();
+        YLOGI("reload, plugins loaded: %d generation: %llu", count, (unsigned long long)Detector::GetPluginGeneration());
+    }
+    return true;
+}
+
+void DetectorService::acceptClient()
+{
+    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (fd < 0) {
+        YLOGW("accept() failed, errno: %d", errno);
+        return;
+    }
+    
+    std::unique_ptr<Client> client(new Client);
+    client->fd = fd;
+    client->memory = nullptr;
+    client->memory_size = 0;
+    memset(&client->hello, 0, sizeof(YADServiceHello));
+    client->generation = 0;
+    client->dead = false;
+    clients_.push_back(std::move(client));
+    
+    YLOGI("client connected, fd: %d clients: %zu", fd, clients_.size());
+}
+
+bool DetectorService::readClient(Client *client, std::vector<Request> &batch)
+{
+    while (true) {
+        YADServiceMessage message;
+        std::string payload;
+        int memfd = -1;
+        int err = recvServiceMessage(client->fd, &message, &payload, &memfd);
+        if (err == YAD_WOULD_BLOCK) {
+            return true;
+        } else if (err != YAD_OK) {
+            if (memfd >= 0) {
+                close(memfd);
+            }
+            return false;
+        }
+        
+        switch (message.type) {
+            case YAD_SERVICE_MSG_HELLO: {
+                YADServiceMessage ack;
+                memset(&ack, 0, sizeof(ack));
+                ack.magic = YAD_SERVICE_MAGIC;
+                ack.type = YAD_SERVICE_MSG_HELLO_ACK;
+                ack.seq = message.seq;
+                ack.version = YAD_SERVICE_VERSION;
+                if (message.version != YAD_SERVICE_VERSION) {
+                    // slot布局不同，不能共享内存
+                    YLOGW("version mismatch, client: %u", message.version);
+                    if (memfd >= 0) {
+                        close(memfd);
+                    }
+                    ack.status = YAD_BAD_TYPE;
+                } else {
+                    ack.status = handleHello(client, payload, memfd);
+                }
+                if (sendServiceMessage(client->fd, ack, nullptr, -1, YAD_SERVICE_SEND_TIMEOUT_MS) != YAD_OK ||
+                    ack.status != YAD_OK) {
+                    return false;
+                }
+                break;
+            }
+            case YAD_SERVICE_MSG_DETECT:
+                if (!client->detector || message.slot < 0 || (uint32_t)message.slot >= client->hello.slot_count) {
+                    return false;
+                }
+                batch.push_back({client, message});
+                break;
+            default:
+                if (memfd >= 0) {
+                    close(memfd);
+                }
+                YLOGW("unknown message type: %u", message.type);
+                return false;
+        }
+    }
+}
+
+int DetectorService::handleHello(Client *client, const std::string &payload, int memfd)
+{
+    if (memfd < 0 || payload.size() < sizeof(YADServiceHello)) {
+        if (memfd >= 0) {
+            close(memfd);
+        }
+        return YAD_BAD_VALUE;
+    }
+    
+    YADServiceHello hello;
+    memcpy(&hello, payload.data(), sizeof(hello));
+    YADConfig config;
+    parseServiceConfig(payload.substr(sizeof(hello)), config);
+    
+    // 各项数量由客户端指定，先检查上限，再确认memfd实际足够大并且已禁止截断，避免访问不存在的页触发SIGBUS
+    size_t size = 0;
+    if (!checkServiceMemorySize(hello, &size)) {
+        YLOGW("invalid hello, slots: %u faces: %u frame bytes: %llu", hello.slot_count, hello.face_capacity,
+              (unsigned long long)hello.frame_capacity);
+        close(memfd);
+        return YAD_BAD_VALUE;
+    }
+    struct stat st;
+    int seals = fcntl(memfd, F_GET_SEALS);
+    if (fstat(memfd, &st) < 0 || (uint64_t)st.st_size < size || seals < 0 || !(seals & F_SEAL_SHRINK)) {
+        YLOGW("shared memory too small or not sealed, size: %lld expected: %zu seals: %d", (long long)st.st_size,
+              size, seals);
+        close(memfd);
+        return YAD_BAD_VALUE;
+    }
+    
+    // 重复HELLO表示客户端扩容，替换共享内存
+    unmapClient(client);
+    
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    close(memfd);
+    if (memory == MAP_FAILED) {
+        YLOGE("mmap() failed, size: %zu errno: %d", size, errno);
+        return YAD_NO_MEMORY;
+    }
+    client->memory = (uint8_t *)memory;
+    client->memory_size = size;
+    client->hello = hello;
+    
+    if (!client->detector) {
+        client->detector.reset(createDetector(config, &client->plugin, &client->generation));
+        client->config = config;
+        if (!client->detector) {
+            return YAD_NAME_NOT_FOUND;
+        }
+    }
+    return client->detector->initCheck();
+}
+
+Detector *DetectorService::createDetector(YADConfig &config, std::string *pluginName, uint64_t *generation)
+{
+    // 配置来自客户端，只保留与单个流有关的选项：录制、跳帧和耗时预算由客户端的包装处理，
+    // CPU绑定和模型路径属于守护进程，线程数不超过守护进程的-t，避免一个客户端创建大量线程或分配巨大的CPU列表
+    static const char *const kClientKeys[] = {
+        kYADMaxFaceCount, kYADPixFormat, kYADDataType, kYADGrayscale,
+        kYADLandmarkProfile, kYADPluginName, kYADDetectScale, kYADRotateModes,
+    };
+    static const char *const kThreadKeys[] = {kYADThreadCount, kYADWorkerThreads, kYADPreprocessThreads};
+    YADConfig accepted;
+    for (const char *key : kClientKeys) {
+        auto it = config.find(key);
+        if (it != config.end()) {
+            accepted[key] = it->second;
+        }
+    }
+    for (const char *key : kThreadKeys) {
+        auto it = config.find(key);
+        if (it == config.end()) {
+            continue;
+        }
+        char *end = nullptr;
+        long threads = strtol(it->second.c_str(), &end, 10);
+        if (end != it->second.c_str() && *end == '\0') {
+            accepted[key] = std::to_string(std::max(1L, std::min(threads, (long)max_threads_)));
+        }
+    }
+    config.swap(accepted);
+    
+    // 配置来自客户端，缺少或非法的数值会让解析抛出异常，不能让一个客户端拖垮守护进程
+    Detector *detector = nullptr;
+    try {
+        detector = Detector::Create(config, pluginName, generation);
+    } catch (const std::exception &e) {
+        YLOGW("invalid config: %s", e.what());
+    }
+    if (!detector) {
+        YLOGW("create detector failed");
+    }
+    return detector;
+}
+
+void DetectorService::processBatch(std::vector<Request> &batch)
+{
+    if (batch.empty()) {
+        return;
+    }
+    
+    // 分组之前完成切换，并行处理期间不会替换客户端的Detector
+    for (auto &request : batch) {
+        refreshClient(request.client);
+    }
+    
+    // 按客户端分组，不同客户端之间并行，同一客户端的请求按到达顺序串行
+    std::map<Client *, std::vector<Request *>> groups;
+    for (auto &request : batch) {
+        groups[request.client].push_back(&request);
+    }
+    std::vector<std::vector<Request *> *> tasks;
+    for (auto &group : groups) {
+        tasks.push_back(&group.second);
+    }
+    
+    auto processGroup = [&](int i) {
+        for (Request *request : *tasks[i]) {
+            processRequest(*request);
+        }
+    };
+    if (worker_pool_) {
+        worker_pool_->parallelFor((int)tasks.size(), processGroup);
+    } else {
+        for (size_t i = 0; i < tasks.size(); i++) {
+            processGroup((int)i);
+        }
+    }
+}
+
+void DetectorService::refreshClient(Client *client)
+{
+    // 创建完成之前继续用旧的Detector处理请求，不阻塞事件循环和其它客户端
+    if (client->replacement.valid()) {
+        if (client->replacement.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+        Replacement replacement = client->replacement.get();
+        if (!replacement.detector) {
+            YLOGW("refresh detector failed, fd: %d plugin: %s", client->fd, client->plugin.c_str());
+            return;
+        }
+        client->detector = std::move(replacement.detector);
+        client->plugin = replacement.plugin;
+        client->generation = replacement.generation;
+        YLOGI("detector refreshed, fd: %d plugin: %s generation: %llu", client->fd, client->plugin.c_str(),
+              (unsigned long long)client->generation);
+    }
+    
+    // 新版本不可用时继续使用旧的Detector，同样标记为当前版本，避免每批请求都重试
+    uint64_t generation = Detector::GetPluginGeneration(client->plugin);
+    if (generation == client->generation) {
+        return;
+    }
+    client->generation = generation;
+    
+    YADConfig config = client->config;
+    client->replacement = std::async(std::launch::async, [this, config]() mutable {
+        Replacement replacement;
+        replacement.detector.reset(createDetector(config, &replacement.plugin, &replacement.generation));
+        if (replacement.detector && replacement.detector->initCheck() != YAD_OK) {
+            replacement.detector.reset();
+        }
+        return replacement;
+    });
+}
+
+void DetectorService::processRequest(const Request &request)
+{
+    Client *client = request.client;
+    if (client->dead) {
+        return;
+    }
+    // 同一轮中排在请求之后的HELLO可能已经换成更小的共享内存或映射失败，slot按当前的共享内存重新检查
+    if (!client->memory || request.message.slot < 0 || (uint32_t)request.message.slot >= client->hello.slot_count) {
+        YLOGW("slot out of range after hello, fd: %d slot: %d", client->fd, request.message.slot);
+        client->dead = true;
+        return;
+    }
+    const YADServiceHello &hello = client->hello;
+    uint8_t *base = client->memory + serviceSlotSize(hello) * request.message.slot;
+    YADServiceSlot *slot = (YADServiceSlot *)base;
+    
+    // 客户端可以随时改写共享内存，只使用检查过的本地拷贝
+    YADServiceSlot header;
+    memcpy(&header, slot, sizeof(header));
+    
+    YADServiceMessage result;
+    memset(&result, 0, sizeof(result));
+    result.magic = YAD_SERVICE_MAGIC;
+    result.type = YAD_SERVICE_MSG_RESULT;
+    result.slot = request.message.slot;
+    result.seq = request.message.seq;
+    
+    YADDetectImage detectImage;
+    detectImage.format = (YADPixelFormat)header.format;
+    detectImage.type = YAD_DATA_TYPE_RAW;
+    detectImage.data = base + serviceFrameOffset(hello);
+    detectImage.width = header.width;
+    detectImage.height = header.height;
+    detectImage.stride = header.stride;
+    
+    YADDetectInfo detectInfo;
+    memset(&detectInfo, 0, sizeof(detectInfo));
+    detectInfo.rotate_mode = (YADRotateMode)header.rotate_mode;
+    
+    // 结果直接写入共享内存
+    YADFaceResults faceResults;
+    faceResults.num_faces = 0;
+    faceResults.capacity = (int)hello.face_capacity;
+    faceResults.faces = (YADFaceInfo *)(base + serviceResultOffset());
+    
+    // 每行都要放得下有效像素，整帧不能超出slot；先用64位检查亮度平面，保证getImageSize不会溢出
+    bool valid = checkImageStride(detectImage.format, detectImage.width, detectImage.height, detectImage.stride) &&
+        (uint64_t)detectImage.stride * detectImage.height <= hello.frame_capacity &&
+        getImageSize(detectImage.format, detectImage.height, detectImage.stride) <= hello.frame_capacity;
+    if (!valid) {
+        YLOGW("invalid frame, fd: %d size: %dx%d stride: %d", client->fd, header.width, header.height, header.stride);
+        result.status = YAD_BAD_VALUE;
+    } else {
+        result.status = client->detector->detectFaces(&detectImage, &detectInfo, &faceResults);
+    }
+    slot->num_faces = faceResults.num_faces;
+    
+    // 客户端长时间不读取结果时断开，不让一个客户端拖住整批处理
+    if (sendServiceMessage(client->fd, result, nullptr, -1, YAD_SERVICE_SEND_TIMEOUT_MS) != YAD_OK) {
+        client->dead = true;
+    }
+}
+
+void DetectorService::unmapClient(Client *client)
+{
+    if (client->memory) {
+        munmap(client->memory, client->memory_size);
+        client->memory = nullptr;
+        client->memory_size = 0;
+    }
+}
+
+void DetectorService::removeClient(size_t index)
+{
+    Client *client = clients_[index].get();
+    YLOGI("client disconnected, fd: %d", client->fd);
+    
+    unmapClient(client);
+    close(client->fd);
+    // 正在后台创建的Detector不能在这里等待，交给事件循环之后回收
+    if (client->replacement.valid()) {
+        retired_.push_back(std::move(client->replacement));
+    }
+    clients_.erase(clients_.begin() + index);
+    
+    for (auto it = retired_.begin(); it != retired_.end();) {
+        if (it->wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            it = retired_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+}; // namespace yad
+
+#endif // __linux__
@@ -0,0 +1,98 @@
+#if defined(__linux__)
+
+//
+//  DetectorService.h
+//  YAD
+//
+
+#ifndef YAD_DETECTOR_SERVICE_H
+#define YAD_DETECTOR_SERVICE_H
+
+#include "YADetector.h"
+#include "ServiceProtocol.h"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace yad {
+
+class WorkerPool;
+
+// yad-detectd的服务端。插件通过PluginManager加载一次，每个客户端独占一个Detector，跟踪等单个流的状态不会互相干扰。
+// 每轮poll收集所有客户端已到达的请求作为一批，按客户端分组后在线程池中并行处理，同一客户端内串行。
+// 客户端所用的插件被替换后，新的Detector在后台创建，完成后客户端在下一批请求之前切换，事件循环和连接都不中断。
+// 共享内存、帧参数和配置都来自客户端，使用前检查上限和实际大小，配置只接受与单个流有关的选项；客户端不读取结果导致发送超时时断开。
+class DetectorService {
+public:
+    DetectorService();
+    ~DetectorService();
+    
+    // numThreads为并行处理不同客户端的线程数
+    int start(const std::string &path, int numThreads);
+    // 事件循环，直到stop()后返回
+    int run();
+    // 可以在其它线程或信号处理函数中调用
+    void stop();
+    // 重新扫描插件目录，在事件循环中执行，可以在其它线程或信号处理函数中调用
+    void reload();
+    
+private:
+    // 后台创建的Detector，plugin和generation含义同Client
+    struct Replacement {
+        std::unique_ptr<Detector> detector;
+        std::string plugin;
+        uint64_t generation;
+    };
+    
+    struct Client {
+        int fd;
+        uint8_t *memory;
+        size_t memory_size;
+        YADServiceHello hello;
+        YADConfig config;
+        std::unique_ptr<Detector> detector;
+        std::string plugin;         // detector所用插件的名称
+        uint64_t generation;        // 创建detector时该插件的版本
+        std::future<Replacement> replacement; // 后台创建中的Detector
+        std::atomic<bool> dead;     // 发送失败或超时，本批处理完后断开
+    };
+    
+    struct Request {
+        Client *client;
+        YADServiceMessage message;
+    };
+    
+    DetectorService(const DetectorService &);
+    DetectorService &operator=(const DetectorService &);
+    
+    void acceptClient();
+    // 读取客户端所有已到达的消息，返回false表示需要断开
+    bool readClient(Client *client, std::vector<Request> &batch);
+    int handleHello(Client *client, const std::string &payload, int memfd);
+    // 处理唤醒管道中的命令，返回false表示需要停止
+    bool handleWake();
+    // 所用插件的版本变化后在后台创建新的Detector，创建完成后切换
+    void refreshClient(Client *client);
+    void processBatch(std::vector<Request> &batch);
+    void processRequest(const Request &request);
+    void removeClient(size_t index);
+    void unmapClient(Client *client);
+    Detector *createDetector(YADConfig &config, std::string *pluginName, uint64_t *generation);
+    
+    int listen_fd_;
+    int wake_fds_[2];
+    int max_threads_;   // start()的numThreads，客户端配置的各项线程数不超过该值
+    std::string path_;
+    std::vector<std::unique_ptr<Client>> clients_;
+    std::vector<std::future<Replacement>> retired_; // 已断开的客户端还在创建的Detector，完成后丢弃
+    std::shared_ptr<WorkerPool> worker_pool_;
+};
+
+}; // namespace yad
+
+#endif /* YAD_DETECTOR_SERVICE_H */
+
+#endif // __linux__
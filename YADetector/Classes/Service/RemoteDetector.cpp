@@ -0,0 +1,335 @@
+#if defined(__linux__)
+
+//
+//  RemoteDetector.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADRemote"
+#include "LogMacros.h"
+
+#include "RemoteDetector.h"
+#include "ImageUtils.h"
+#include "LandmarkProfile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <algorithm>
+
+#define YAD_REMOTE_DEFAULT_FRAME_BYTES  (1920 * 1080 * 4)
+
+namespace yad {
+
+RemoteDetector::RemoteDetector(YADConfig &config) :
+    init_check_(YAD_NO_INIT),
+    fd_(-1),
+    config_(config),
+    landmark_profile_(YAD_LANDMARK_PROFILE_106),
+    memory_(nullptr),
+    memory_size_(0),
+    in_flight_(0),
+    next_seq_(1),
+    receiving_(false)
+{
+    YLOGV("ctor");
+    
+    getConfigLandmarkProfile(config, &landmark_profile_);
+    memset(&hello_, 0, sizeof(hello_));
+    hello_.slot_count = YAD_SERVICE_SLOT_COUNT;
+    hello_.face_capacity = YAD_MAX_FACE_NUM;
+    if (!config[kYADMaxFaceCount].empty()) {
+        hello_.face_capacity = std::max(1, std::min(std::stoi(config[kYADMaxFaceCount]), YAD_SERVICE_MAX_FACES));
+    }
+    size_t frameCapacity = YAD_REMOTE_DEFAULT_FRAME_BYTES;
+    if (!config[kYADServiceBytes].empty()) {
+        frameCapacity = std::stoul(config[kYADServiceBytes]);
+    }
+    
+    int err = connectService(config[kYADServicePath]);
+    if (err != YAD_OK) {
+        init_check_ = err;
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    init_check_ = setupMemory(frameCapacity);
+}
+
+RemoteDetector::~RemoteDetector()
+{
+    YLOGV("dtor");
+    
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    releaseMemory();
+}
+
+int RemoteDetector::connectService(const std::string &path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return YAD_BAD_VALUE;
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    
+    fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        return YAD_UNKNOWN_ERROR;
+    }
+    if (connect(fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        YLOGE("connect() failed, path: %s errno: %d", path.c_str(), errno);
+        close(fd_);
+        fd_ = -1;
+        return YAD_DEAD_OBJECT;
+    }
+    return YAD_OK;
+}
+
+int RemoteDetector::setupMemory(size_t frameCapacity)
+{
+    releaseMemory();
+    
+    YADServiceHello hello = hello_;
+    hello.frame_capacity = frameCapacity;
+    size_t size = 0;
+    if (!checkServiceMemorySize(hello, &size)) {
+        YLOGE("frame too large for service, bytes: %zu", frameCapacity);
+        return YAD_BAD_VALUE;
+    }
+    
+    int memfd = memfd_create("yad-frames", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd < 0) {
+        YLOGE("memfd_create() failed, errno: %d", errno);
+        return YAD_NO_MEMORY;
+    }
+    // 禁止截断，守护进程检查过大小之后映射的内存一直有效
+    if (ftruncate(memfd, size) < 0 || fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK) < 0) {
+        close(memfd);
+        return YAD_NO_MEMORY;
+    }
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (memory == MAP_FAILED) {
+        close(memfd);
+        return YAD_NO_MEMORY;
+    }
+    
+    std::string payload((const char *)&hello, sizeof(hello));
+    payload += serializeServiceConfig(config_);
+    
+    YADServiceMessage message;
+    memset(&message, 0, sizeof(message));
+    message.magic = YAD_SERVICE_MAGIC;
+    message.type = YAD_SERVICE_MSG_HELLO;
+    message.seq = next_seq_++;
+    message.version = YAD_SERVICE_VERSION;
+    message.payload_size = (uint32_t)payload.size();
+    int err = sendServiceMessage(fd_, message, payload.data(), memfd);
+    close(memfd);
+    if (err != YAD_OK) {
+        munmap(memory, size);
+        return err;
+    }
+    
+    // 没有进行中的请求，下一条消息一定是HELLO_ACK
+    YADServiceMessage ack;
+    err = recvServiceMessage(fd_, &ack, nullptr, nullptr);
+    if (err != YAD_OK || ack.type != YAD_SERVICE_MSG_HELLO_ACK) {
+        munmap(memory, size);
+        return err != YAD_OK ? err : YAD_FAILED_TRANSACTION;
+    }
+    if (ack.status != YAD_OK) {
+        YLOGE("service refused, status: %d", ack.status);
+        munmap(memory, size);
+        return ack.status;
+    }
+    
+    hello_ = hello;
+    memory_ = (uint8_t *)memory;
+    memory_size_ = size;
+    free_slots_.clear();
+    for (uint32_t i = 0; i < hello_.slot_count; i++) {
+        free_slots_.push_back(i);
+    }
+    return YAD_OK;
+}
+
+void RemoteDetector::releaseMemory()
+{
+    if (memory_) {
+        munmap(memory_, memory_size_);
+        memory_ = nullptr;
+        memory_size_ = 0;
+    }
+    free_slots_.clear();
+}
+
+int RemoteDetector::waitResult(std::unique_lock<std::mutex> &lock, uint64_t seq, YADServiceMessage *result)
+{
+    while (true) {
+        auto it = results_.find(seq);
+        if (it != results_.end()) {
+            *result = it->second;
+            results_.erase(it);
+            return YAD_OK;
+        }
+        
+        if (receiving_) {
+            cond_.wait(lock);
+            continue;
+        }
+        
+        receiving_ = true;
+        lock.unlock();
+        YADServiceMessage message;
+        int err = recvServiceMessage(fd_, &message, nullptr, nullptr);
+        lock.lock();
+        receiving_ = false;
+        // 只保留仍有线程等待的结果，等待者已经出错返回的结果直接丢弃
+        if (err == YAD_OK && message.type == YAD_SERVICE_MSG_RESULT && pending_.count(message.seq)) {
+            results_[message.seq] = message;
+        }
+        cond_.notify_all();
+        if (err != YAD_OK) {
+            YLOGE("receive result failed, err: %d", err);
+            return err;
+        }
+    }
+}
+
+int RemoteDetector::initCheck() const
+{
+    return init_check_;
+}
+
+YADLandmarkProfile RemoteDetector::getLandmarkProfile() const
+{
+    return landmark_profile_;
+}
+
+int RemoteDetector::detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo)
+{
+    if (!featureInfo) {
+        return YAD_BAD_VALUE;
+    }
+    
+    YADFaceResults faceResults = makeFaceResults(featureInfo);
+    int ret = detectFaces(detectImage, detectInfo, &faceResults);
+    featureInfo->num_faces = faceResults.num_faces;
+    return ret;
+}
+
+int RemoteDetector::detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults)
+{
+    if (!detectImage || !detectInfo || !faceResults || !detectImage->data) {
+        YLOGE("params is null");
+        return YAD_BAD_VALUE;
+    }
+    ImagePlanes planes;
+    int err = getImagePlanes(detectImage, &planes);
+    if (err != YAD_OK) {
+        return err;
+    }
+    if (init_check_ != YAD_OK) {
+        return YAD_NO_INIT;
+    }
+    
+    // 共享内存中的帧总是连续存放，多平面或裁剪后的图像按紧凑的stride拼接，
+    // 横向裁剪时整行拷贝会越过缓冲区末尾，同样需要拼接
+    bool contiguous = planes.crop_x == 0 && isContiguous(planes);
+    int frameStride = contiguous ? planes.strides[0] : getCompactStride(planes.format, planes.width);
+    size_t frameSize = getImageSize(planes.format, planes.height, frameStride);
+    if (frameSize == 0 || frameSize > YAD_SERVICE_MAX_FRAME_BYTES) {
+        return YAD_BAD_VALUE;
+    }
+    
+    std::unique_lock<std::mutex> lock(mutex_);
+    
+    // 帧超过容量时，等进行中的请求结束后扩容。扩容或连接失败后slot不再可用，等待中的线程都要被唤醒并返回
+    if (frameSize > hello_.frame_capacity) {
+        cond_.wait(lock, [this] {
+            return in_flight_ == 0 || init_check_ != YAD_OK;
+        });
+        if (init_check_ != YAD_OK) {
+            return YAD_NO_INIT;
+        }
+        if (frameSize > hello_.frame_capacity) {
+            err = setupMemory(frameSize);
+            if (err != YAD_OK) {
+                init_check_ = err;
+                cond_.notify_all();
+                return err;
+            }
+        }
+    }
+    
+    cond_.wait(lock, [this] {
+        return !free_slots_.empty() || init_check_ != YAD_OK;
+    });
+    if (init_check_ != YAD_OK) {
+        return YAD_NO_INIT;
+    }
+    int slotIndex = free_slots_.back();
+    free_slots_.pop_back();
+    in_flight_++;
+    uint64_t seq = next_seq_++;
+    pending_.insert(seq);
+    uint8_t *base = memory_ + serviceSlotSize(hello_) * slotIndex;
+    lock.unlock();
+    
+    YADServiceSlot *slot = (YADServiceSlot *)base;
+    slot->format = planes.format;
+    slot->width = planes.width;
+    slot->height = planes.height;
+    slot->stride = frameStride;
+    slot->rotate_mode = detectInfo->rotate_mode;
+    slot->num_faces = 0;
+    if (contiguous) {
+        memcpy(base + serviceFrameOffset(hello_), planes.planes[0], frameSize);
+    } else {
+        copyToContiguous(planes, base + serviceFrameOffset(hello_), frameStride);
+    }
+    
+    YADServiceMessage message;
+    memset(&message, 0, sizeof(message));
+    message.magic = YAD_SERVICE_MAGIC;
+    message.type = YAD_SERVICE_MSG_DETECT;
+    message.slot = slotIndex;
+    message.seq = seq;
+    err = sendServiceMessage(fd_, message, nullptr, -1);
+    
+    lock.lock();
+    YADServiceMessage result;
+    if (err == YAD_OK) {
+        err = waitResult(lock, seq, &result);
+    }
+    if (err == YAD_OK) {
+        err = result.status;
+        // 结果由守护进程写在共享内存中，只拷贝有效的人脸
+        faceResults->num_faces = std::min(std::min(slot->num_faces, (int)hello_.face_capacity), faceResults->capacity);
+        memcpy(faceResults->faces, base + serviceResultOffset(), sizeof(YADFaceInfo) * faceResults->num_faces);
+        offsetFaceResults(faceResults, planes.crop_x, planes.crop_y);
+    } else {
+        // 连接出错后结果可能永远不会到达，守护进程也可能仍在使用这个slot，之后的调用直接失败
+        results_.erase(seq);
+        init_check_ = err;
+    }
+    pending_.erase(seq);
+    free_slots_.push_back(slotIndex);
+    in_flight_--;
+    cond_.notify_all();
+    return err;
+}
+
+}; // namespace yad
+
+#endif // __linux__
@@ -0,0 +1,69 @@
+#if defined(__linux__)
+
+//
+//  RemoteDetector.h
+//  YAD
+//
+
+#ifndef YAD_REMOTE_DETECTOR_H
+#define YAD_REMOTE_DETECTOR_H
+
+#include "YADetector.h"
+#include "ServiceProtocol.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace yad {
+
+// yad-detectd的客户端，配置 kYADServicePath 后由 Detector::Create 创建，对调用者透明。
+// 帧写入memfd共享内存的slot，守护进程把结果写回同一个slot。支持多线程同时调用，每个调用占用一个slot。
+class RemoteDetector : public Detector {
+public:
+    RemoteDetector(YADConfig &config);
+    virtual ~RemoteDetector();
+    
+    int initCheck() const override;
+    int detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo) override;
+    int detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults) override;
+    YADLandmarkProfile getLandmarkProfile() const override;
+    
+private:
+    RemoteDetector(const RemoteDetector &);
+    RemoteDetector &operator=(const RemoteDetector &);
+    
+    int connectService(const std::string &path);
+    // 创建共享内存并发送给守护进程，调用时需持有mutex_且没有进行中的请求
+    int setupMemory(size_t frameCapacity);
+    void releaseMemory();
+    // 等待seq对应的结果，同一时刻只有一个线程在socket上接收，收到的结果分发给对应的线程
+    int waitResult(std::unique_lock<std::mutex> &lock, uint64_t seq, YADServiceMessage *result);
+    
+    std::atomic<int> init_check_;  // 在mutex_中修改，detectFaces开始时不加锁读取
+    int fd_;
+    YADConfig config_;
+    YADLandmarkProfile landmark_profile_;
+    YADServiceHello hello_;
+    uint8_t *memory_;
+    size_t memory_size_;
+    
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<int> free_slots_;
+    int in_flight_;
+    uint64_t next_seq_;
+    bool receiving_;
+    std::set<uint64_t> pending_;                    // 已发送、仍有线程等待结果的seq
+    std::map<uint64_t, YADServiceMessage> results_; // 已收到、等待对应线程取走的结果
+};
+
+}; // namespace yad
+
+#endif /* YAD_REMOTE_DETECTOR_H */
+
+#endif // __linux__
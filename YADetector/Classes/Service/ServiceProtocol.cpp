@@ -0,0 +1,171 @@
+#if defined(__linux__)
+
+//
+//  ServiceProtocol.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADSvc"
+#include "LogMacros.h"
+
+#include "ServiceProtocol.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+
+#define YAD_SERVICE_MAX_PACKET  (64 * 1024)
+
+namespace yad {
+
+int sendServiceMessage(int fd, const YADServiceMessage &message, const void *payload, int passFd, int timeoutMs)
+{
+    struct iovec iov[2];
+    iov[0].iov_base = (void *)&message;
+    iov[0].iov_len = sizeof(message);
+    iov[1].iov_base = (void *)payload;
+    iov[1].iov_len = payload ? message.payload_size : 0;
+    
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    
+    char control[CMSG_SPACE(sizeof(int))];
+    if (passFd >= 0) {
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &passFd, sizeof(int));
+    }
+    
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    ssize_t ret;
+    while (true) {
+        ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        // 非阻塞socket缓冲满时等待可写，对端一直不读取时超时返回
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            int waitMs = -1;
+            if (timeoutMs >= 0) {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                waitMs = (int)std::max<int64_t>(0, remaining.count());
+            }
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            if (poll(&pfd, 1, waitMs) == 0) {
+                YLOGW("sendmsg() timed out, fd: %d", fd);
+                return YAD_TIMED_OUT;
+            }
+            continue;
+        }
+        break;
+    }
+    if (ret < 0) {
+        YLOGE("sendmsg() failed, errno: %d", errno);
+        return errno == EPIPE ? YAD_DEAD_OBJECT : YAD_FAILED_TRANSACTION;
+    }
+    return YAD_OK;
+}
+
+int recvServiceMessage(int fd, YADServiceMessage *message, std::string *payload, int *passFd)
+{
+    // 消息头直接接收到message，只有调用者需要时才接收负载；DETECT/RESULT没有负载，每条消息都不分配堆内存
+    char buffer[YAD_SERVICE_MAX_PACKET - sizeof(YADServiceMessage)];
+    struct iovec iov[2];
+    iov[0].iov_base = message;
+    iov[0].iov_len = sizeof(YADServiceMessage);
+    iov[1].iov_base = buffer;
+    iov[1].iov_len = sizeof(buffer);
+    
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = payload ? 2 : 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    
+    if (passFd) {
+        *passFd = -1;
+    }
+    
+    ssize_t ret;
+    do {
+        ret = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    } while (ret < 0 && errno == EINTR);
+    if (ret == 0) {
+        return YAD_DEAD_OBJECT;
+    } else if (ret < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? YAD_WOULD_BLOCK : YAD_FAILED_TRANSACTION;
+    }
+    
+    // 取出传递的fd，调用者不需要时直接关闭，避免泄漏
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            int receivedFd;
+            memcpy(&receivedFd, CMSG_DATA(cmsg), sizeof(int));
+            if (passFd) {
+                *passFd = receivedFd;
+            } else {
+                close(receivedFd);
+            }
+        }
+    }
+    
+    // 超出接收缓冲区的消息被截断，不是合法的消息
+    if ((size_t)ret < sizeof(YADServiceMessage) || (msg.msg_flags & MSG_TRUNC)) {
+        return YAD_BAD_VALUE;
+    }
+    if (message->magic != YAD_SERVICE_MAGIC || sizeof(YADServiceMessage) + message->payload_size != (size_t)ret) {
+        return YAD_BAD_VALUE;
+    }
+    if (payload) {
+        payload->assign(buffer, message->payload_size);
+    }
+    return YAD_OK;
+}
+
+std::string serializeServiceConfig(const YADConfig &config)
+{
+    std::string payload;
+    for (auto it = config.begin(); it != config.end(); ++it) {
+        payload.append(it->first);
+        payload.push_back('\0');
+        payload.append(it->second);
+        payload.push_back('\0');
+    }
+    return payload;
+}
+
+void parseServiceConfig(const std::string &payload, YADConfig &config)
+{
+    size_t pos = 0;
+    while (pos < payload.size()) {
+        size_t keyEnd = payload.find('\0', pos);
+        if (keyEnd == std::string::npos) {
+            break;
+        }
+        size_t valueEnd = payload.find('\0', keyEnd + 1);
+        if (valueEnd == std::string::npos) {
+            break;
+        }
+        config[payload.substr(pos, keyEnd - pos)] = payload.substr(keyEnd + 1, valueEnd - keyEnd - 1);
+        pos = valueEnd + 1;
+    }
+}
+
+}; // namespace yad
+
+#endif // __linux__
@@ -0,0 +1,118 @@
+#if defined(__linux__)
+
+//
+//  ServiceProtocol.h
+//  YAD
+//
+
+#ifndef YAD_SERVICE_PROTOCOL_H
+#define YAD_SERVICE_PROTOCOL_H
+
+#include "YADetector.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// yad-detectd与客户端之间的协议。
+// 客户端创建memfd共享内存环形缓冲，连接时通过Unix socket(SCM_RIGHTS)把fd发给守护进程。
+// 之后每帧只在socket上传递slot序号，帧数据和检测结果都在共享内存中，不经过socket拷贝。
+//
+// 共享内存布局: slot_count个slot依次存放，每个slot:
+//   [YADServiceSlot][人脸结果: face_capacity * YADFaceInfo][帧数据: frame_capacity]
+// memfd需要加上F_SEAL_SHRINK，守护进程映射之后客户端不能再截断，否则访问越界的页会触发SIGBUS。
+
+#define YAD_SERVICE_MAGIC           0x53444159  // "YADS"
+#define YAD_SERVICE_VERSION         4
+#define YAD_SERVICE_DEFAULT_PATH    "/tmp/yad-detectd.sock"
+#define YAD_SERVICE_SLOT_COUNT      4
+#define YAD_SERVICE_ALIGNMENT       64
+#define YAD_SERVICE_MAX_SLOTS       64                  // HELLO中各项的上限，超出时守护进程拒绝
+#define YAD_SERVICE_MAX_FACES       1024
+#define YAD_SERVICE_MAX_FRAME_BYTES (256ull << 20)
+#define YAD_SERVICE_SEND_TIMEOUT_MS 200                 // 守护进程发送的超时，客户端不读取时断开
+
+enum {
+    YAD_SERVICE_MSG_HELLO = 1,  // 客户端->守护进程，携带memfd和配置，重新发送表示扩容
+    YAD_SERVICE_MSG_HELLO_ACK,  // 守护进程->客户端，status为创建Detector的结果
+    YAD_SERVICE_MSG_DETECT,     // 客户端->守护进程，slot中的帧已写好
+    YAD_SERVICE_MSG_RESULT,     // 守护进程->客户端，slot中的结果已写好，status为detect返回值
+};
+
+typedef struct YADServiceMessage {
+    uint32_t magic;
+    uint32_t type;
+    int32_t slot;
+    int32_t status;
+    uint64_t seq;
+    uint32_t payload_size;  // 消息后紧跟的负载字节数
+    uint32_t version;       // HELLO时为YAD_SERVICE_VERSION，slot布局变化时递增
+} YADServiceMessage;
+
+// HELLO的负载，后面紧跟配置，格式为 key\0value\0 ...
+typedef struct YADServiceHello {
+    uint32_t slot_count;
+    uint32_t face_capacity;
+    uint64_t frame_capacity;
+} YADServiceHello;
+
+// slot头部，描述帧数据和结果
+typedef struct YADServiceSlot {
+    int32_t format;         // YADPixelFormat
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    int32_t rotate_mode;    // YADRotateMode
+    int32_t num_faces;      // 守护进程写入
+} YADServiceSlot;
+
+namespace yad {
+
+inline size_t serviceAlign(size_t size)
+{
+    return (size + YAD_SERVICE_ALIGNMENT - 1) / YAD_SERVICE_ALIGNMENT * YAD_SERVICE_ALIGNMENT;
+}
+
+inline size_t serviceResultOffset()
+{
+    return serviceAlign(sizeof(YADServiceSlot));
+}
+
+inline size_t serviceFrameOffset(const YADServiceHello &hello)
+{
+    return serviceResultOffset() + serviceAlign(sizeof(YADFaceInfo) * hello.face_capacity);
+}
+
+inline size_t serviceSlotSize(const YADServiceHello &hello)
+{
+    return serviceFrameOffset(hello) + serviceAlign(hello.frame_capacity);
+}
+
+inline size_t serviceMemorySize(const YADServiceHello &hello)
+{
+    return serviceSlotSize(hello) * hello.slot_count;
+}
+
+// 检查HELLO中的各项都在上限之内，并计算共享内存的总字节数，超限或溢出时返回false
+inline bool checkServiceMemorySize(const YADServiceHello &hello, size_t *size)
+{
+    if (hello.slot_count == 0 || hello.slot_count > YAD_SERVICE_MAX_SLOTS ||
+        hello.face_capacity == 0 || hello.face_capacity > YAD_SERVICE_MAX_FACES ||
+        hello.frame_capacity == 0 || hello.frame_capacity > YAD_SERVICE_MAX_FRAME_BYTES) {
+        return false;
+    }
+    return !__builtin_mul_overflow(serviceSlotSize(hello), (size_t)hello.slot_count, size);
+}
+
+// 发送一条消息，passFd >= 0 时同时传递该fd。非阻塞socket缓冲满时最多等待timeoutMs，超时返回YAD_TIMED_OUT，-1表示一直等待
+int sendServiceMessage(int fd, const YADServiceMessage &message, const void *payload, int passFd, int timeoutMs = -1);
+// 接收一条消息，passFd非空时接收传递过来的fd，没有则为-1。payload为空时只接收没有负载的消息，有负载返回YAD_BAD_VALUE。对端关闭返回YAD_DEAD_OBJECT
+int recvServiceMessage(int fd, YADServiceMessage *message, std::string *payload, int *passFd);
+// 配置序列化，格式为 key\0value\0 ...
+std::string serializeServiceConfig(const YADConfig &config);
+void parseServiceConfig(const std::string &payload, YADConfig &config);
+
+}; // namespace yad
+
+#endif /* YAD_SERVICE_PROTOCOL_H */
+
+#endif // __linux__
@@ -0,0 +1,18 @@
+//
+//  Simd.h
+//  YAD
+//
+
+#ifndef YAD_SIMD_H
+#define YAD_SIMD_H
+
+// 按编译目标选择SIMD实现，都不支持时使用标量代码
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define YAD_SIMD_NEON   1
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define YAD_SIMD_SSE2   1
+#include <emmintrin.h>
+#endif
+
+#endif /* YAD_SIMD_H */
@@ -0,0 +1,527 @@
+//
+//  StreamScheduler.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADSched"
+#include "LogMacros.h"
+
+#include "StreamScheduler.h"
+#include "CpuAffinity.h"
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#define YAD_SCHEDULER_EWMA_SHIFT    3   // 检测耗时滑动平均的权重为1/8
+
+namespace yad {
+
+StreamScheduler::StreamScheduler(YADConfig &config, int numWorkers, int maxQueued) :
+    init_check_(YAD_NO_INIT),
+    max_queued_(std::max(1, maxQueued)),
+    stopped_(false),
+    next_seq_(0),
+    min_virtual_time_us_(0),
+    config_(config)
+{
+    YLOGV("ctor, workers: %d", numWorkers);
+    
+    int err = getConfigCpus(config, kYADCpuAffinity, &cpus_);
+    if (err != YAD_OK) {
+        init_check_ = err;
+        return;
+    }
+    
+    numWorkers = std::max(1, numWorkers);
+    for (int i = 0; i < numWorkers; i++) {
+        std::unique_ptr<Worker> worker(new Worker);
+        worker->seen_generation = Detector::GetPluginGeneration();
+        worker->detector.reset(Detector::Create(config, &worker->plugin, &worker->generation));
+        if (!worker->detector) {
+            YLOGE("create detector failed");
+            init_check_ = YAD_NAME_NOT_FOUND;
+            return;
+        }
+        err = worker->detector->initCheck();
+        if (err != YAD_OK) {
+            YLOGE("detector init failed, err: %d", err);
+            init_check_ = err;
+            return;
+        }
+        worker->arena.reset(new FaceArena(config));
+        worker->num_streams = 0;
+        workers_.push_back(std::move(worker));
+    }
+    
+    for (int i = 0; i < numWorkers; i++) {
+        workers_[i]->thread = std::thread(&StreamScheduler::threadLoop, this, i);
+    }
+    init_check_ = YAD_OK;
+}
+
+StreamScheduler::~StreamScheduler()
+{
+    YLOGV("dtor");
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    cond_.notify_all();
+    for (auto &worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    
+    for (auto &worker : workers_) {
+        for (const Task &task : worker->queue) {
+            task.callback(task.frame, YAD_DEAD_OBJECT, nullptr);
+        }
+        worker->queue.clear();
+    }
+}
+
+// static
+int64_t StreamScheduler::nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int StreamScheduler::initCheck() const
+{
+    return init_check_;
+}
+
+int StreamScheduler::getWorkerCount() const
+{
+    return (int)workers_.size();
+}
+
+int StreamScheduler::submit(const StreamFrame &frame, const StreamCallback &callback)
+{
+    if (init_check_ != YAD_OK) {
+        return init_check_;
+    }
+    if (!callback) {
+        return YAD_BAD_VALUE;
+    }
+    
+    Task dropped;
+    bool overflow = false;
+    bool expired = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_) {
+            return YAD_DEAD_OBJECT;
+        }
+        
+        int64_t now = nowUs();
+        Stream &stream = getStream(frame.stream_id);
+        stream.stats.submitted++;
+        // 空闲后重新开始的流不能累积之前没用的计算时间
+        if (stream.queued == 0) {
+            stream.virtual_time_us = std::max(stream.virtual_time_us, min_virtual_time_us_);
+        }
+        if (frame.deadline_us > 0 && now + stream.stats.detect_avg_us > frame.deadline_us) {
+            stream.stats.dropped_deadline++;
+            expired = true;
+        }
+        
+        // 排队满时丢弃该路流最旧的帧，实时流的新帧更有价值
+        Worker &worker = *workers_[stream.worker];
+        if (!expired && stream.queued >= max_queued_) {
+            auto oldest = worker.queue.end();
+            for (auto it = worker.queue.begin(); it != worker.queue.end(); ++it) {
+                if (it->frame.stream_id == frame.stream_id && (oldest == worker.queue.end() || it->seq < oldest->seq)) {
+                    oldest = it;
+                }
+            }
+            if (oldest != worker.queue.end()) {
+                dropped = std::move(*oldest);
+                worker.queue.erase(oldest);
+                stream.queued--;
+                stream.stats.dropped_overflow++;
+                overflow = true;
+            }
+        }
+        
+        if (!expired) {
+            worker.queue.push_back({frame, callback, now, next_seq_++});
+            stream.queued++;
+        }
+    }
+    
+    // 提交时就赶不上截止时间的帧同样回调，调用者只需要在回调中处理结果和释放帧
+    if (expired) {
+        callback(frame, YAD_TIMED_OUT, nullptr);
+        return YAD_OK;
+    }
+    cond_.notify_one();
+    
+    if (overflow) {
+        dropped.callback(dropped.frame, YAD_WOULD_BLOCK, nullptr);
+    }
+    return YAD_OK;
+}
+
+void StreamScheduler::setStreamWeight(int streamId, int weight)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    getStream(streamId).weight = std::max(1, weight);
+}
+
+void StreamScheduler::removeStream(int streamId)
+{
+    std::vector<Task> removed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = streams_.find(streamId);
+        if (it == streams_.end()) {
+            return;
+        }
+        Worker &worker = *workers_[it->second.worker];
+        for (auto task = worker.queue.begin(); task != worker.queue.end();) {
+            if (task->frame.stream_id == streamId) {
+                removed.push_back(std::move(*task));
+                task = worker.queue.erase(task);
+            } else {
+                ++task;
+            }
+        }
+        worker.num_streams--;
+        streams_.erase(it);
+    }
+    
+    for (const Task &task : removed) {
+        task.callback(task.frame, YAD_DEAD_OBJECT, nullptr);
+    }
+}
+
+int StreamScheduler::getStreamStats(int streamId, StreamStats *stats)
+{
+    if (!stats) {
+        return YAD_BAD_VALUE;
+    }
+    
+    std::vector<int64_t> latencies;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = streams_.find(streamId);
+        if (it == streams_.end()) {
+            return YAD_NAME_NOT_FOUND;
+        }
+        *stats = it->second.stats;
+        latencies = it->second.latencies_us;
+    }
+    
+    stats->latency_avg_us = 0;
+    stats->latency_p50_us = 0;
+    stats->latency_p99_us = 0;
+    stats->latency_max_us = 0;
+    if (latencies.empty()) {
+        return YAD_OK;
+    }
+    
+    int64_t sum = 0;
+    for (int64_t latency : latencies) {
+        sum += latency;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    stats->latency_avg_us = sum / (int64_t)latencies.size();
+    stats->latency_p50_us = latencies[latencies.size() / 2];
+    stats->latency_p99_us = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+    stats->latency_max_us = latencies.back();
+    return YAD_OK;
+}
+
+#pragma mark Private
+
+StreamScheduler::Stream &StreamScheduler::getStream(int streamId)
+{
+    auto it = streams_.find(streamId);
+    if (it != streams_.end()) {
+        return it->second;
+    }
+    
+    // 新的流分配给流最少的工作线程
+    int worker = 0;
+    for (int i = 1; i < (int)workers_.size(); i++) {
+        if (workers_[i]->num_streams < workers_[worker]->num_streams) {
+            worker = i;
+        }
+    }
+    workers_[worker]->num_streams++;
+    
+    Stream &stream = streams_[streamId];
+    stream.worker = worker;
+    stream.weight = 1;
+    stream.queued = 0;
+    stream.in_flight = 0;
+    stream.virtual_time_us = min_virtual_time_us_;
+    memset(&stream.stats, 0, sizeof(stream.stats));
+    stream.latency_index = 0;
+    return stream;
+}
+
+StreamScheduler::Stream *StreamScheduler::findStream(int streamId)
+{
+    auto it = streams_.find(streamId);
+    return it != streams_.end() ? &it->second : nullptr;
+}
+
+void StreamScheduler::migrateStream(int streamId, int index)
+{
+    Stream *stream = findStream(streamId);
+    if (!stream || stream->worker == index) {
+        return;
+    }
+    
+    // 保持排队顺序，整路流一起移动
+    std::deque<Task> &from = workers_[stream->worker]->queue;
+    std::deque<Task> &to = workers_[index]->queue;
+    for (auto it = from.begin(); it != from.end();) {
+        if (it->frame.stream_id == streamId) {
+            to.push_back(std::move(*it));
+            it = from.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    workers_[stream->worker]->num_streams--;
+    workers_[index]->num_streams++;
+    YLOGV("stream %d migrated, worker: %d -> %d", streamId, stream->worker, index);
+    stream->worker = index;
+}
+
+bool StreamScheduler::isBefore(const Task &a, const Task &b)
+{
+    if (a.frame.priority != b.frame.priority) {
+        return a.frame.priority > b.frame.priority;
+    }
+    const Stream *aStream = findStream(a.frame.stream_id);
+    const Stream *bStream = findStream(b.frame.stream_id);
+    int64_t aTime = aStream ? aStream->virtual_time_us : 0;
+    int64_t bTime = bStream ? bStream->virtual_time_us : 0;
+    if (aTime != bTime) {
+        return aTime < bTime;
+    }
+    int64_t aDeadline = a.frame.deadline_us > 0 ? a.frame.deadline_us : INT64_MAX;
+    int64_t bDeadline = b.frame.deadline_us > 0 ? b.frame.deadline_us : INT64_MAX;
+    if (aDeadline != bDeadline) {
+        return aDeadline < bDeadline;
+    }
+    return a.seq < b.seq;
+}
+
+void StreamScheduler::dropExpired(int64_t now, std::vector<Task> &dropped)
+{
+    for (auto &worker : workers_) {
+        std::deque<Task> &queue = worker->queue;
+        for (auto it = queue.begin(); it != queue.end();) {
+            Stream *stream = findStream(it->frame.stream_id);
+            int64_t detectAvgUs = stream ? stream->stats.detect_avg_us : 0;
+            if (it->frame.deadline_us > 0 && now + detectAvgUs > it->frame.deadline_us) {
+                if (stream) {
+                    stream->queued--;
+                    stream->stats.dropped_deadline++;
+                }
+                dropped.push_back(std::move(*it));
+                it = queue.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+std::deque<StreamScheduler::Task>::iterator StreamScheduler::findBest(std::deque<Task> &queue)
+{
+    auto best = queue.end();
+    for (auto it = queue.begin(); it != queue.end(); ++it) {
+        if (best == queue.end() || isBefore(*it, *best)) {
+            best = it;
+        }
+    }
+    return best;
+}
+
+bool StreamScheduler::takeTask(int index, int64_t now, Task *task, std::vector<Task> &dropped)
+{
+    dropExpired(now, dropped);
+    
+    std::deque<Task> &queue = workers_[index]->queue;
+    auto best = findBest(queue);
+    
+    // 其它线程有明显更该执行的帧(优先级更高，或者所属的流少占用了超过一帧的计算时间)时，把那一路流整体迁移过来，
+    // 否则优先执行自己的帧。正在检测的流不迁移，同一路流的帧始终只在一个Detector上按顺序检测
+    const Task *candidate = best != queue.end() ? &*best : nullptr;
+    bool migrate = false;
+    int stolen = 0;
+    for (int i = 0; i < (int)workers_.size(); i++) {
+        if (i == index) {
+            continue;
+        }
+        auto other = findBest(workers_[i]->queue);
+        if (other == workers_[i]->queue.end()) {
+            continue;
+        }
+        const Stream *otherStream = findStream(other->frame.stream_id);
+        if (!otherStream || otherStream->in_flight > 0) {
+            continue;
+        }
+        bool steal = !candidate;
+        if (!steal && other->frame.priority != candidate->frame.priority) {
+            steal = other->frame.priority > candidate->frame.priority;
+        } else if (!steal) {
+            const Stream *own = findStream(candidate->frame.stream_id);
+            steal = own && otherStream->virtual_time_us + own->stats.detect_avg_us / own->weight < own->virtual_time_us;
+        }
+        if (steal) {
+            candidate = &*other;
+            stolen = other->frame.stream_id;
+            migrate = true;
+        }
+    }
+    if (migrate) {
+        migrateStream(stolen, index);
+        best = findBest(queue);
+    }
+    if (best == queue.end()) {
+        return false;
+    }
+    
+    // 系统虚拟时间取有帧排队的流中最小的虚拟时间，空闲后重新提交的流从这里开始
+    int64_t minTime = INT64_MAX;
+    for (auto it = streams_.begin(); it != streams_.end(); ++it) {
+        if (it->second.queued > 0) {
+            minTime = std::min(minTime, it->second.virtual_time_us);
+        }
+    }
+    min_virtual_time_us_ = std::max(min_virtual_time_us_, minTime);
+    
+    Stream *stream = findStream(best->frame.stream_id);
+    if (stream) {
+        stream->queued--;
+        stream->in_flight++;
+    }
+    *task = std::move(*best);
+    queue.erase(best);
+    return true;
+}
+
+void StreamScheduler::finishTask(const Task &task, int64_t detectUs, int err)
+{
+    auto it = streams_.find(task.frame.stream_id);
+    if (it == streams_.end()) {
+        // 检测过程中流被删除
+        return;
+    }
+    
+    Stream &stream = it->second;
+    // 检测过程中流被删除后又用同一个id重新提交时，新流没有这一帧的计数
+    if (stream.in_flight > 0) {
+        stream.in_flight--;
+    }
+    stream.stats.completed++;
+    if (err != YAD_OK) {
+        stream.stats.failed++;
+    }
+    if (stream.stats.completed == 1) {
+        stream.stats.detect_avg_us = detectUs;
+    } else {
+        stream.stats.detect_avg_us += (detectUs - stream.stats.detect_avg_us) >> YAD_SCHEDULER_EWMA_SHIFT;
+    }
+    stream.virtual_time_us += detectUs / stream.weight;
+    
+    int64_t latency = nowUs() - task.submit_us;
+    if (stream.latencies_us.size() < YAD_SCHEDULER_LATENCY_SAMPLES) {
+        stream.latencies_us.push_back(latency);
+    } else {
+        stream.latencies_us[stream.latency_index] = latency;
+        stream.latency_index = (stream.latency_index + 1) % YAD_SCHEDULER_LATENCY_SAMPLES;
+    }
+}
+
+void StreamScheduler::threadLoop(int index)
+{
+    Worker &worker = *workers_[index];
+    setThreadAffinity(cpus_);
+    
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopped_) {
+        Task task;
+        std::vector<Task> dropped;
+        int64_t now = nowUs();
+        bool found = takeTask(index, now, &task, dropped);
+        if (!found && dropped.empty()) {
+            cond_.wait(lock);
+            continue;
+        }
+        
+        lock.unlock();
+        for (const Task &drop : dropped) {
+            drop.callback(drop.frame, YAD_TIMED_OUT, nullptr);
+        }
+        if (found) {
+            refreshDetector(worker);
+            YADFaceResults *results = worker.arena->get();
+            int64_t start = nowUs();
+            int err = worker.detector->detectFaces(&task.frame.image, &task.frame.info, results);
+            int64_t detectUs = nowUs() - start;
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                finishTask(task, detectUs, err);
+            }
+            task.callback(task.frame, err, err == YAD_OK ? results : nullptr);
+        }
+        lock.lock();
+    }
+}
+
+void StreamScheduler::refreshDetector(Worker &worker)
+{
+    // 加载模型可能需要几百毫秒，在后台创建，创建完成之前继续用旧的Detector检测
+    if (worker.replacement.valid()) {
+        if (worker.replacement.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+        Replacement replacement = worker.replacement.get();
+        if (!replacement.detector) {
+            YLOGW("recreate detector failed, plugin: %s", worker.plugin.c_str());
+            return;
+        }
+        worker.detector = std::move(replacement.detector);
+        worker.plugin = replacement.plugin;
+        worker.generation = replacement.generation;
+        YLOGI("detector recreated, plugin: %s generation: %llu", worker.plugin.c_str(),
+              (unsigned long long)worker.generation);
+    }
+    
+    // 其它插件的变化不影响这个工作线程
+    uint64_t seen = Detector::GetPluginGeneration();
+    if (seen == worker.seen_generation) {
+        return;
+    }
+    worker.seen_generation = seen;
+    uint64_t generation = Detector::GetPluginGeneration(worker.plugin);
+    if (generation == worker.generation) {
+        return;
+    }
+    // 先记录版本，创建失败时不会每帧重试，等下一次替换
+    worker.generation = generation;
+    
+    YADConfig config = config_;
+    worker.replacement = std::async(std::launch::async, [config]() mutable {
+        Replacement replacement;
+        replacement.detector.reset(Detector::Create(config, &replacement.plugin, &replacement.generation));
+        if (replacement.detector && replacement.detector->initCheck() != YAD_OK) {
+            replacement.detector.reset();
+        }
+        return replacement;
+    });
+}
+
+}; // namespace yad
@@ -0,0 +1,155 @@
+//
+//  StreamScheduler.h
+//  YAD
+//
+
+#ifndef YAD_STREAM_SCHEDULER_H
+#define YAD_STREAM_SCHEDULER_H
+
+#include "YADetector.h"
+#include "FaceArena.h"
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace yad {
+
+#define YAD_SCHEDULER_DEFAULT_MAX_QUEUED    2   // 每路流默认最多排队的帧数
+#define YAD_SCHEDULER_LATENCY_SAMPLES       256 // 每路流保留的最近延时样本数，用于计算分位数
+
+// 送入调度器的一帧
+typedef struct StreamFrame {
+    int stream_id;
+    YADDetectImage image;   // 图像数据在回调返回前必须有效
+    YADDetectInfo info;
+    int64_t deadline_us;    // 截止时间，StreamScheduler::nowUs()的绝对时间，0表示不限
+    int priority;           // 越大越优先，高优先级的帧总是先于低优先级的帧执行
+} StreamFrame;
+
+// 每路流的统计
+typedef struct StreamStats {
+    uint64_t submitted;         // 提交帧数
+    uint64_t completed;         // 检测完成帧数(包括检测失败)
+    uint64_t failed;            // 检测失败帧数
+    uint64_t dropped_deadline;  // 预计无法在截止时间前完成而丢弃的帧数
+    uint64_t dropped_overflow;  // 排队超过上限，被同一路流的新帧替换的帧数
+    int64_t detect_avg_us;      // 检测耗时的滑动平均
+    int64_t latency_avg_us;     // 提交到完成的延时，按最近的样本统计
+    int64_t latency_p50_us;
+    int64_t latency_p99_us;
+    int64_t latency_max_us;
+} StreamStats;
+
+// 帧处理完成或被丢弃时回调，每个成功提交的帧恰好回调一次。丢弃时err为YAD_TIMED_OUT(截止时间)、
+// YAD_WOULD_BLOCK(排队溢出)或YAD_DEAD_OBJECT(调度器析构)，results为空。results只在回调内有效。
+// 通常在工作线程中执行，提交时就被丢弃的帧在submit的调用线程中回调
+typedef std::function<void(const StreamFrame &frame, int err, const YADFaceResults *results)> StreamCallback;
+
+// 多路流调度器。持有若干Detector，每个工作线程独占一个，多路流共享这些Detector:
+//   - 每路流有一个所属的工作线程，帧进入该线程的队列，连续的帧由同一个Detector处理以保持跟踪；
+//     工作线程空闲或其它线程有更该执行的帧时，把没有帧正在检测的整路流迁移过来，同一路流不会同时在两个线程上检测。
+//   - 选帧顺序：优先级 > 各路流已占用的计算时间(按权重归一化，少者优先) > 截止时间。
+//   - 开始检测前按该路流的平均检测耗时预估完成时间，赶不上截止时间的帧直接丢弃，不占用计算。
+// 队列和统计由同一把锁保护，检测在锁外执行。配置了kYADCpuAffinity时工作线程绑定到对应的CPU。
+// 工作线程所用的插件或模型被替换后，新的Detector在后台创建，完成后工作线程在两帧之间切换，期间继续使用旧的。
+class StreamScheduler {
+public:
+    // 按配置创建numWorkers个Detector，maxQueued为每路流最多排队的帧数，超过时丢弃最旧的帧
+    StreamScheduler(YADConfig &config, int numWorkers, int maxQueued = YAD_SCHEDULER_DEFAULT_MAX_QUEUED);
+    // 停止工作线程，未处理的帧以YAD_DEAD_OBJECT回调
+    ~StreamScheduler();
+    
+    static int64_t nowUs();
+    
+    int initCheck() const;
+    int getWorkerCount() const;
+    // 提交一帧，立即返回，结果通过callback异步给出。已经赶不上截止时间的帧直接以YAD_TIMED_OUT回调，返回错误时不回调
+    int submit(const StreamFrame &frame, const StreamCallback &callback);
+    // 设置流的权重，默认1，权重越大分到的计算时间越多
+    void setStreamWeight(int streamId, int weight);
+    // 删除流，排队中的帧以YAD_DEAD_OBJECT回调
+    void removeStream(int streamId);
+    int getStreamStats(int streamId, StreamStats *stats);
+    
+private:
+    struct Task {
+        StreamFrame frame;
+        StreamCallback callback;
+        int64_t submit_us;
+        uint64_t seq;
+    };
+    
+    // 后台创建的Detector，plugin和generation含义同Worker
+    struct Replacement {
+        std::unique_ptr<Detector> detector;
+        std::string plugin;
+        uint64_t generation;
+    };
+    
+    struct Worker {
+        std::unique_ptr<Detector> detector;
+        std::string plugin;         // detector所用插件的名称
+        uint64_t generation;        // 创建detector时该插件的版本
+        uint64_t seen_generation;   // 上次检查时所有插件的总版本，没有变化时不按名称查找
+        std::future<Replacement> replacement; // 后台创建中的Detector
+        std::unique_ptr<FaceArena> arena;
+        std::deque<Task> queue;
+        int num_streams;
+        std::thread thread;
+    };
+    
+    struct Stream {
+        int worker;                 // 所属工作线程
+        int weight;
+        int queued;
+        int in_flight;              // 正在检测的帧数，为0时整路流才能迁移到其它线程
+        int64_t virtual_time_us;    // 已占用的计算时间/权重
+        StreamStats stats;
+        std::vector<int64_t> latencies_us;
+        size_t latency_index;
+    };
+    
+    StreamScheduler(const StreamScheduler &) = delete;
+    StreamScheduler &operator=(const StreamScheduler &) = delete;
+    
+    void threadLoop(int index);
+    // 所用插件的版本变化时在后台创建新的Detector，创建完成后替换，失败时继续使用旧的
+    void refreshDetector(Worker &worker);
+    Stream &getStream(int streamId);
+    // 查找已有的流，不存在时返回nullptr，不会创建
+    Stream *findStream(int streamId);
+    // 把流和它排队中的帧整体移到另一个工作线程
+    void migrateStream(int streamId, int index);
+    // 移除所有队列中赶不上截止时间的帧
+    void dropExpired(int64_t now, std::vector<Task> &dropped);
+    std::deque<Task>::iterator findBest(std::deque<Task> &queue);
+    // 为指定线程取出最应该执行的帧，优先取自己队列的帧，必要时从其它线程迁移整路流
+    bool takeTask(int index, int64_t now, Task *task, std::vector<Task> &dropped);
+    bool isBefore(const Task &a, const Task &b);
+    void finishTask(const Task &task, int64_t detectUs, int err);
+    
+    int init_check_;
+    int max_queued_;
+    bool stopped_;
+    uint64_t next_seq_;
+    int64_t min_virtual_time_us_;
+    std::vector<int> cpus_;
+    YADConfig config_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::map<int, Stream> streams_;
+};
+
+}; // namespace yad
+
+#endif /* YAD_STREAM_SCHEDULER_H */
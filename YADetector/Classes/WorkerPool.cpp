@@ -0,0 +1,175 @@
+//
+//  WorkerPool.cpp
+//  YAD
+//
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "YADPool"
+#include "LogMacros.h"
+
+#include "WorkerPool.h"
+#include "CpuAffinity.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+namespace yad {
+
+WorkerPool::WorkerPool(int numThreads, const std::vector<int> &cpus) :
+    num_threads_(std::max(1, numThreads)),
+    cpus_(cpus),
+    stopped_(false)
+{
+    YLOGV("ctor, threads: %d cpus: %s", num_threads_, formatCpuList(cpus_).c_str());
+    
+    for (int i = 1; i < num_threads_; i++) {
+        threads_.emplace_back(&WorkerPool::threadLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    YLOGV("dtor");
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    cond_.notify_all();
+    for (auto &thread : threads_) {
+        thread.join();
+    }
+}
+
+// static
+std::shared_ptr<WorkerPool> WorkerPool::getShared(int numThreads, const std::vector<int> &cpus)
+{
+    static std::mutex mutex;
+    static std::map<std::pair<int, std::string>, std::weak_ptr<WorkerPool>> pools;
+    
+    if (numThreads <= 1) {
+        return nullptr;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    std::pair<int, std::string> key(numThreads, formatCpuList(cpus));
+    std::shared_ptr<WorkerPool> pool = pools[key].lock();
+    if (!pool) {
+        pool = std::make_shared<WorkerPool>(numThreads, cpus);
+        pools[key] = pool;
+    }
+    return pool;
+}
+
+// static
+int WorkerPool::getShared(YADConfig &config, std::shared_ptr<WorkerPool> *pool)
+{
+    return getShared(config, kYADWorkerThreads, pool);
+}
+
+// static
+int WorkerPool::getShared(YADConfig &config, const char *threadsKey, std::shared_ptr<WorkerPool> *pool)
+{
+    if (!pool) {
+        return YAD_BAD_VALUE;
+    }
+    
+    pool->reset();
+    std::vector<int> cpus;
+    int err = getConfigCpus(config, kYADCpuAffinity, &cpus);
+    if (err != YAD_OK) {
+        return err;
+    }
+    auto it = config.find(threadsKey);
+    if (it != config.end() && !it->second.empty()) {
+        *pool = getShared(std::stoi(it->second), cpus);
+    }
+    return YAD_OK;
+}
+
+int WorkerPool::getThreadCount() const
+{
+    return num_threads_;
+}
+
+void WorkerPool::parallelFor(int count, const std::function<void(int)> &fn)
+{
+    if (count <= 0) {
+        return;
+    }
+    // 单个任务或者没有后台线程时直接在调用线程执行，避免唤醒开销
+    if (count == 1 || threads_.empty()) {
+        for (int i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+    
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->fn = &fn;
+    job->count = count;
+    job->next = 0;
+    job->done = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(job);
+    }
+    cond_.notify_all();
+    
+    // 调用线程也参与执行
+    runJob(job.get());
+    removeJob(job);
+    
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->cond.wait(lock, [&] {
+        return job->done.load() == job->count;
+    });
+}
+
+void WorkerPool::threadLoop()
+{
+    setThreadAffinity(cpus_);
+    
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] {
+                return stopped_ || !jobs_.empty();
+            });
+            if (stopped_) {
+                break;
+            }
+            job = jobs_.front();
+        }
+        
+        runJob(job.get());
+        removeJob(job);
+    }
+}
+
+// static
+void WorkerPool::runJob(Job *job)
+{
+    int index;
+    while ((index = job->next.fetch_add(1)) < job->count) {
+        (*job->fn)(index);
+        if (job->done.fetch_add(1) + 1 == job->count) {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->cond.notify_all();
+        }
+    }
+}
+
+// 任务已经全部分发完，从队列中移除
+void WorkerPool::removeJob(const std::shared_ptr<Job> &job)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find(jobs_.begin(), jobs_.end(), job);
+    if (it != jobs_.end()) {
+        jobs_.erase(it);
+    }
+}
+
+}; // namespace yad
@@ -0,0 +1,71 @@
+//
+//  WorkerPool.h
+//  YAD
+//
+
+#ifndef YAD_WORKER_POOL_H
+#define YAD_WORKER_POOL_H
+
+#include "YADetector.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace yad {
+
+// 工作线程池，用于把一帧内相互独立的任务(如每个人脸的关键点和姿态)分发到多个线程。
+// 并行度包含调用线程：并行度为N时创建N-1个后台线程，调用线程也参与执行。
+// 多个Detector可以同时使用同一个线程池，任务按提交顺序执行。
+// 指定cpus时后台线程绑定到这些CPU上，调用线程的绑定由调用者决定。
+class WorkerPool {
+public:
+    explicit WorkerPool(int numThreads, const std::vector<int> &cpus = std::vector<int>());
+    ~WorkerPool();
+    
+    // 获取共享线程池，并行度和CPU绑定都相同的调用者共享同一个实例，并行度小于等于1时返回空
+    static std::shared_ptr<WorkerPool> getShared(int numThreads, const std::vector<int> &cpus = std::vector<int>());
+    // 根据配置 kYADWorkerThreads 和 kYADCpuAffinity 获取共享线程池，没有配置并行度时pool为空。
+    // kYADCpuAffinity非法时返回YAD_BAD_VALUE，与StreamScheduler一样拒绝，不会静默地不绑定
+    static int getShared(YADConfig &config, std::shared_ptr<WorkerPool> *pool);
+    // 并行度取配置threadsKey，CPU绑定取kYADCpuAffinity
+    static int getShared(YADConfig &config, const char *threadsKey, std::shared_ptr<WorkerPool> *pool);
+    
+    int getThreadCount() const;
+    // 并行执行fn(0) ~ fn(count - 1)，所有任务完成后返回
+    void parallelFor(int count, const std::function<void(int)> &fn);
+    
+private:
+    struct Job {
+        const std::function<void(int)> *fn;
+        int count;
+        std::atomic<int> next;
+        std::atomic<int> done;
+        std::mutex mutex;
+        std::condition_variable cond;
+    };
+    
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+    
+    void threadLoop();
+    static void runJob(Job *job);
+    void removeJob(const std::shared_ptr<Job> &job);
+    
+    int num_threads_;
+    std::vector<int> cpus_;
+    bool stopped_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::shared_ptr<Job>> jobs_;
+    std::vector<std::thread> threads_;
+};
+
+}; // namespace yad
+
+#endif /* YAD_WORKER_POOL_H */
@@ -5,6 +5,11 @@
 
 #include "YADetector.h"
 #include "PluginManager.h"
+#include "FaceArena.h"
+#include "LandmarkProfile.h"
+
+#include <string.h>
+#include <algorithm>
 
 namespace yad {
 
@@ -20,4 +25,94 @@ Detector *Detector::Create(YADConfig &config)
     return PluginManager::getInstance().createDetector(config);
 }
 
+// static
+Detector *Detector::Create(YADConfig &config, std::string *pluginName, uint64_t *pluginGeneration)
+{
+    return PluginManager::getInstance().createDetector(config, pluginName, pluginGeneration);
+}
+
+// static
+int Detector::LoadPlugin(const std::string &libPath)
+{
+    return PluginManager::getInstance().loadPlugin(libPath);
+}
+
+// static
+int Detector::RescanPlugins()
+{
+    return PluginManager::getInstance().rescanPlugins();
+}
+
+// static
+int Detector::ReloadPlugin(const std::string &name, YADConfig &config)
+{
+    return PluginManager::getInstance().reloadPlugin(name, config);
+}
+
+// static
+uint64_t Detector::GetPluginGeneration()
+{
+    return PluginManager::getInstance().getGeneration();
+}
+
+// static
+uint64_t Detector::GetPluginGeneration(const std::string &name)
+{
+    return PluginManager::getInstance().getGeneration(name);
+}
+
+// static
+void Detector::SetMemoryBudget(int64_t bytes)
+{
+    PluginManager::getInstance().setMemoryBudget(bytes);
+}
+
+// static
+void Detector::GetMemoryStats(std::vector<std::pair<std::string, PluginMemoryStats>> &stats)
+{
+    PluginManager::getInstance().getMemoryStats(stats);
+}
+
+int Detector::detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults)
+{
+    if (!faceResults || (!faceResults->faces && faceResults->capacity > 0)) {
+        return YAD_BAD_VALUE;
+    }
+    
+    YADFeatureInfo featureInfo;
+    featureInfo.num_faces = 0;
+    int err = detect(detectImage, detectInfo, &featureInfo);
+    if (err != YAD_OK) {
+        return err;
+    }
+    
+    faceResults->num_faces = std::min(featureInfo.num_faces, faceResults->capacity);
+    memcpy(faceResults->faces, featureInfo.faces, sizeof(YADFaceInfo) * faceResults->num_faces);
+    return YAD_OK;
+}
+
+YADLandmarkProfile Detector::getLandmarkProfile() const
+{
+    return YAD_LANDMARK_PROFILE_106;
+}
+
+int Detector::detectLandmarks(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADLandmarkResults *landmarkResults)
+{
+    if (!landmarkResults || !isValidLandmarkProfile(landmarkResults->profile)) {
+        return YAD_BAD_VALUE;
+    }
+    // 子集之外的点插件没有计算，值不确定。5点在任何子集下都会输出
+    if (landmarkResults->profile > getLandmarkProfile()) {
+        return YAD_BAD_VALUE;
+    }
+    
+    // 完整结果只是中转，使用共享池的内存
+    FaceArena arena(std::max(1, landmarkResults->capacity));
+    int err = detectFaces(detectImage, detectInfo, arena.get());
+    if (err != YAD_OK) {
+        return err;
+    }
+    return extractLandmarks(arena.get(), landmarkResults);
+}
+
 }; // namespace yad
@@ -8,8 +8,11 @@
 
 #include <stdarg.h>
 #include <errno.h>
+#include <stdint.h>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 // 人脸关键点Landmark使用106点，同商汤科技，face++
 
@@ -106,6 +109,7 @@ typedef enum YADPixelFormat {
     YAD_PIX_FMT_RGBA8888,
     YAD_PIX_FMT_BGR565,
     YAD_PIX_FMT_RGB565,
+    YAD_PIX_FMT_I420,       // YUV420三平面，U平面在前
     YAD_PIX_FMT_MAX,
 } YADPixelFormat;
 
@@ -122,9 +126,22 @@ typedef enum YADDataType {
     YAD_DATA_TYPE_RAW ,             // 裸数据，数据为 char *
     YAD_DATA_TYPE_IOS_UIIMAGE,      // iOS UIImage, 实际类型：UIImage
     YAD_DATA_TYPE_IOS_PIXEL_BUFFER, // iOS PixelBuffer, 实际类型：CVPixelBufferRef
+    YAD_DATA_TYPE_RAW_PLANES,       // 多平面裸数据，实际类型：YADRawPlanes，平面可以不连续，免去拼接拷贝
     YAD_DATA_TYPE_MAX
 } YADImageType;
 
+#define YAD_MAX_PLANE_NUM   4   // 最大平面个数
+
+// 多平面裸数据，平面顺序同格式名，如NV12为Y、UV，I420为Y、U、V。
+// YADDetectImage的width、height为整幅图像的宽高，stride不使用
+typedef struct YADRawPlanes {
+    int num_planes;
+    void *planes[YAD_MAX_PLANE_NUM];    // 平面所在内存的基地址
+    int offsets[YAD_MAX_PLANE_NUM];     // 平面数据相对基地址的偏移，单位为字节
+    int strides[YAD_MAX_PLANE_NUM];     // 平面步长，单位为字节
+    YADRecti crop;                      // 检测区域，w或h为0时检测整幅图像，YUV格式要求x、y为偶数。结果坐标仍相对整幅图像
+} YADRawPlanes;
+
 // 检测图像
 typedef struct YADDetectImage {
     YADPixelFormat format;  // 数据格式
@@ -140,6 +157,12 @@ typedef struct YADDetectInfo {
     YADRotateMode rotate_mode;
 } YADDetectInfo;
 
+// 检测质量，设置了kYADFrameBudgetUs时框架根据最近的耗时调整，通过PluginV2::setQuality(ABI v3)通知插件
+typedef struct YADDetectQuality {
+    float detect_scale;     // 检测分辨率缩放(0~1]，0表示插件默认分辨率
+    int max_faces;          // 最多输出的人脸数，0表示只受kYADMaxFaceCount限制
+} YADDetectQuality;
+
 typedef struct YADFaceInfo {
     int track_id;   // 跟踪id
     YADRectf rect;  // 人脸区域，注意不是归一化到0-1的值
@@ -150,7 +173,7 @@ typedef struct YADFaceInfo {
     float roll;     // 绕x轴角度
 } YADFaceInfo;
 
-// feature信息组合
+// feature信息组合，固定容量，兼容旧接口
 typedef struct YADFeatureInfo {
     int num_faces;
     YADFaceInfo faces[YAD_MAX_FACE_NUM];
@@ -158,11 +181,60 @@ typedef struct YADFeatureInfo {
     // ...预留，可能还有手势识别等feature
 } YADFeatureInfo;
 
+// 可变容量的人脸结果，faces由调用者或者FaceArena提供，人脸个数不受 YAD_MAX_FACE_NUM 限制
+typedef struct YADFaceResults {
+    int num_faces;
+    int capacity;       // faces最多可容纳的人脸个数
+    YADFaceInfo *faces;
+} YADFaceResults;
+
+// 关键点输出子集，取值为点数
+typedef enum YADLandmarkProfile {
+    YAD_LANDMARK_PROFILE_5      = 5,    // 左右瞳孔、鼻尖、左右嘴角，顺序同FaceAligner的对齐模板
+    YAD_LANDMARK_PROFILE_68     = 68,   // iBUG 68点
+    YAD_LANDMARK_PROFILE_106    = 106,  // 全部106点
+} YADLandmarkProfile;
+
+// 不含关键点的人脸信息
+typedef struct YADFaceBox {
+    int track_id;
+    YADRectf rect;
+    float yaw;
+    float pitch;
+    float roll;
+} YADFaceBox;
+
+// 紧凑的关键点结果，只包含profile指定的子集，不含visibilites。
+// 第i个人脸的关键点为landmarks[i * profile]起的profile个点，faces和landmarks由调用者提供
+typedef struct YADLandmarkResults {
+    int num_faces;
+    int capacity;                   // faces最多可容纳的人脸个数，landmarks至少可容纳capacity * profile个点
+    YADLandmarkProfile profile;
+    YADFaceBox *faces;
+    YADPoint2f *landmarks;
+} YADLandmarkResults;
+
 typedef std::unordered_map<std::string, std::string> YADConfig;
 
 #define kYADMaxFaceCount    "max_face_count"    // value: int
 #define kYADPixFormat       "pix_format"        // value: YADPixelFormat
 #define kYADDataType        "data_type"         // value: YADDataType
+#define kYADRecordPath      "record_path"       // value: string，录制文件路径，非空时录制输入帧，用于离线回放
+#define kYADThreadCount     "thread_count"      // value: int，推理后端线程数，默认由插件决定
+#define kYADWorkerThreads   "worker_threads"    // value: int，共享工作线程池的并行度(包含调用线程)，用于多人脸并行处理，默认1
+#define kYADServicePath     "service_path"      // value: string，yad-detectd的socket路径，非空时通过守护进程检测(仅Linux)
+#define kYADServiceBytes    "service_bytes"     // value: int，共享内存中每帧的初始容量(字节)，帧更大时自动扩容
+#define kYADMotionThreshold "motion_threshold"  // value: float，静止画面跳帧阈值(缩略图平均亮度差，0~255)，大于0时启用
+#define kYADMotionMaxSkip   "motion_max_skip"   // value: int，最多连续跳过的帧数，之后强制检测一次，默认30
+#define kYADGrayscale       "grayscale"         // value: int，非0时只用亮度检测，YUV输入直接使用Y平面，不支持的插件sniff时不参与选择
+#define kYADCpuAffinity     "cpu_affinity"      // value: string，工作线程绑定的CPU，"big"自动选择性能核，或CPU列表如"4-7"(仅Linux)
+#define kYADBackendAffinity "backend_affinity"  // value: string，推理后端内部线程绑定的CPU，格式同上，默认与kYADCpuAffinity相同
+#define kYADPluginName      "plugin_name"       // value: string，只在指定名称(Plugin::getName)的插件中选择，用于评测和对比插件
+#define kYADLandmarkProfile "landmark_profile"  // value: YADLandmarkProfile，需要的关键点子集，默认106。插件可以只计算该子集和5点子集(对齐用)，其它点的值不确定
+#define kYADPreprocessThreads "preprocess_threads" // value: int，框架格式转换和旋转的并行度(包含调用线程)，默认与kYADWorkerThreads相同
+#define kYADFrameBudgetUs   "frame_budget_us"   // value: int，单帧耗时预算(微秒)，大于0时根据最近的耗时自动降低检测质量
+#define kYADDetectScale     "detect_scale"      // value: float，检测分辨率缩放(0~1]，默认1，插件不支持时忽略
+#define kYADRotateModes     "rotate_modes"      // value: string，帧可能使用的YADRotateMode列表，如"0,90"，默认全部。用于选择能处理这些旋转的预处理
 
 #if defined(__cplusplus)
 }
@@ -170,6 +242,18 @@ typedef std::unordered_map<std::string, std::string> YADConfig;
 
 namespace yad {
 
+// 插件的内存统计，单位字节。增量按进程整体的变化测量，没有声明PluginCaps::concurrent_create的插件逐个创建和测量，
+// 但其它插件或线程同时分配的内存也会计入，只是近似值。延迟到首次检测才分配的内存不计入创建时的增量
+typedef struct PluginMemoryStats {
+    int64_t load_rss_bytes;         // load()的增量
+    int64_t load_heap_bytes;
+    int detectors;                  // 存活的detector数
+    int64_t detector_rss_bytes;     // 存活detector创建时的增量之和
+    int64_t detector_heap_bytes;
+    uint64_t created;               // 累计创建的detector数
+    uint64_t refused;               // 超出内存预算被拒绝的次数
+} PluginMemoryStats;
+
 // 检测类
 class Detector {
 public:
@@ -177,6 +261,23 @@ public:
     static bool Exists();
     // 创建Detector
     static Detector *Create(YADConfig &config);
+    // 创建Detector并返回选中插件的名称(Plugin::getName)和创建时该插件的版本，通过守护进程检测时分别为空和0
+    static Detector *Create(YADConfig &config, std::string *pluginName, uint64_t *pluginGeneration);
+    // 运行时加载插件动态库，与已有插件同名时替换，已创建的Detector继续使用旧版本直到释放。
+    // 新版本必须使用不同的文件路径，同一路径的dlopen会返回已加载的库
+    static int LoadPlugin(const std::string &libPath);
+    // 扫描插件目录，加载之前没有扫描到的插件动态库，返回加载的个数
+    static int RescanPlugins();
+    // 以新配置重新加载指定插件的模型，之后创建的Detector使用新模型
+    static int ReloadPlugin(const std::string &name, YADConfig &config);
+    // 任一插件或模型每替换一次加一，长期持有Detector的调用者据此判断是否需要进一步检查
+    static uint64_t GetPluginGeneration();
+    // 指定插件的版本，该插件或它的模型被替换时加一，其它插件的变化不影响，插件不存在时为0
+    static uint64_t GetPluginGeneration(const std::string &name);
+    // 进程常驻内存预算(字节)，0表示不限，默认取环境变量YAD_MEMORY_BUDGET_MB。预计超出时Create返回空
+    static void SetMemoryBudget(int64_t bytes);
+    // 各插件的内存统计，按注册顺序，用于容量规划
+    static void GetMemoryStats(std::vector<std::pair<std::string, PluginMemoryStats>> &stats);
     
     Detector() {}
     Detector(YADConfig &config) {}
@@ -185,12 +286,29 @@ public:
     virtual int initCheck() const = 0;
     // 检测函数
     virtual int detect(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFeatureInfo *featureInfo) = 0;
+    // 可变容量检测函数，最多输出min(kYADMaxFaceCount, faceResults->capacity)个人脸。
+    // 默认实现调用detect()再拷贝，插件可以重载直接写入faceResults，以支持超过 YAD_MAX_FACE_NUM 的人脸。
+    // 该虚函数追加在虚表末尾，只有ABI v2插件的重载会被调用，框架对v1插件的Detector只调用默认实现
+    virtual int detectFaces(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADFaceResults *faceResults);
+    // 创建时kYADLandmarkProfile指定的关键点子集。追加在detectFaces之后，只对Detector::Create返回的对象调用，
+    // 框架不会调用插件Detector的该函数
+    virtual YADLandmarkProfile getLandmarkProfile() const;
+    // 紧凑输出函数，通过detectFaces()检测后只拷贝landmarkResults->profile指定的关键点。
+    // profile多于创建时kYADLandmarkProfile指定的子集时返回YAD_BAD_VALUE
+    int detectLandmarks(YADDetectImage *detectImage, YADDetectInfo *detectInfo, YADLandmarkResults *landmarkResults);
 
 private:
     Detector(const Detector &);
     Detector &operator=(const Detector &);
 };
 
+// 把固定容量的YADFeatureInfo作为YADFaceResults的视图，两者共享faces内存
+inline YADFaceResults makeFaceResults(YADFeatureInfo *featureInfo)
+{
+    YADFaceResults faceResults = {0, YAD_MAX_FACE_NUM, featureInfo->faces};
+    return faceResults;
+}
+
 typedef enum {
     YAD_LOG_LEVEL_VERBOSE,
     YAD_LOG_LEVEL_DEBUG,
@@ -206,14 +324,38 @@ typedef void (*Log)(int level, const char *tag, const char *file, int line, cons
 typedef const char *(*GetNameFunc)();
 // 设置日志回调
 typedef void (*SetLogFunc)(Log log);
-// 检查和加载资源
+// 检查和加载资源。插件第一次被选中时才调用，只调用一次，发现插件时只使用getName、sniff和getCaps
 typedef int (*LoadFunc)(YADConfig &config);
-// 根据配置嗅探。插件根据参数返回confidence。
+// 根据配置嗅探，不能依赖load()加载的资源。插件根据参数返回confidence。
 // confidence范围：0~1.0，该值越高，插件优先级就越高。主要用于在多个都能实现功能的插件中，选取优化最好的插件。
 typedef bool (*SniffFunc)(YADConfig &config, float *confidence);
-// 创建Detector实例
+// 创建Detector实例。框架对同一插件逐个调用，PluginCaps::concurrent_create非0时才可能被多个线程同时调用
 typedef Detector *(*CreateDetectorFunc)(YADConfig &config);
 
+#define YAD_PLUGIN_ABI_VERSION  3   // 当前插件ABI版本，v1只有Plugin，v2增加能力描述，v3增加检测质量设置
+
+#define YAD_PLUGIN_CAP_FORMAT(format)   (1u << (format))            // PluginCaps::pix_formats
+#define YAD_PLUGIN_CAP_TYPE(type)       (1u << (type))              // PluginCaps::data_types
+#define YAD_PLUGIN_CAP_ROTATE(mode)     (1u << ((mode) / 90))       // PluginCaps::rotations
+#define YAD_PLUGIN_CAP_ROTATE_ALL       0xfu
+
+// 插件能力描述(ABI v2)。框架根据它选择插件和预处理：插件不支持的格式、数据类型和旋转由框架转换后再送入插件，
+// 多个插件都可用时选择检测耗时加上转换耗时最小的一个。框架无法旋转YUV，kYADRotateModes中有插件不支持的旋转时优先转换为RGB888
+typedef struct PluginCaps {
+    uint32_t pix_formats;   // 原生支持的像素格式，YAD_PLUGIN_CAP_FORMAT的组合
+    uint32_t data_types;    // 原生支持的数据类型，YAD_PLUGIN_CAP_TYPE的组合
+    uint32_t rotations;     // 原生支持的旋转，YAD_PLUGIN_CAP_ROTATE的组合，不支持的旋转由框架旋转为正向
+    int reserved;           // 原max_batch，Detector没有批处理接口，保留以保持布局，插件不需要设置
+    int thread_safe;        // 非0时同一个Detector可以被多个线程同时调用，为0时框架串行调用插件的Detector
+    float detect_cost_ms;   // 估计的单帧检测耗时(毫秒，640x480)，0表示未知
+    int concurrent_create;  // 非0时createDetector可以被多个线程同时调用，为0时框架对同一插件逐个创建。sniff和getCaps总是逐个调用
+} PluginCaps;
+
+// 根据配置获取能力，config与sniff相同，返回0成功
+typedef int (*GetCapsFunc)(YADConfig &config, PluginCaps *caps);
+// 设置之后每帧的检测质量，detector为本插件createDetector创建的实例，框架在两帧之间调用，返回0成功
+typedef int (*SetQualityFunc)(Detector *detector, const YADDetectQuality *quality);
+
 // 插件类，框架支持第三方插件，用户可以扩展自定义。
 // 用户需要以Detector为基类，派生一个自己的XXXDetector。并实现和导出"createYADetectorPlugin"函数。
 // 插件管理器会搜索通用的动态库目录，查找符合库命名规则的动态库，加载库内符号"createYADetectorPlugin"(该函数返回Plugin对象)。
@@ -226,6 +368,15 @@ struct Plugin {
     CreateDetectorFunc createDetector;
 };
 
+// 插件ABI v2，动态库导出"createYADetectorPluginV2"(该函数返回PluginV2对象)，优先于v1的"createYADetectorPlugin"。
+// base中的函数含义与v1相同，sniff会以框架转换后的格式调用。以后的版本只在末尾追加字段，框架按abi_version读取
+struct PluginV2 {
+    int abi_version;        // YAD_PLUGIN_ABI_VERSION
+    Plugin base;
+    GetCapsFunc getCaps;
+    SetQualityFunc setQuality;  // v3，可以为空，为空时框架只裁剪输出的人脸数
+};
+
 }; // namespace yad
 
 #endif /* YAD_DETECTOR_H */